@@ -0,0 +1,339 @@
+// *************Benchmark.c**************
+// Kernel measurements and benchmarks the interpreter prints
+// Kept apart from Interpreter.c so the host port can build and run them too,
+// see RTOS_Labs_common/host/tests/BenchmarkReport.c
+// Output goes to the interpreter's terminal, the UART or a telnet client
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#ifdef HOST_SIM
+#include "../RTOS_Labs_common/host/HostPort.h"
+#else
+#include "../inc/CortexM.h"
+#endif
+#include "../RTOS_Labs_common/OS.h"
+#include "../RTOS_Labs_common/UART0int.h"
+#include "../RTOS_Labs_common/Interpreter.h"
+#include "../RTOS_Labs_common/Benchmark.h"
+#include "../RTOS_Labs_common/eFile.h"
+#include "../inc/LPF.h"
+
+
+extern int threadId;                  // next thread ID to hand out
+
+
+// Print worst case sleep tick ISR time per number of sleeping threads
+void SleepISRTime(uint32_t const SleeperSize, uint32_t SleepISRMaxTime[]){
+	Interpreter_OutString("\n");
+	Interpreter_OutString("sleepers : max ISR time (12.5ns)");
+	UART_OutChar('\n');
+	
+	for(int i = 1; i <= SleeperSize; i++){
+		if(SleepISRMaxTime[i]){
+			UART_OutUDec(i);
+			Interpreter_OutString(" : ");
+			UART_OutUDec(SleepISRMaxTime[i]);
+			UART_OutChar('\n');
+		}
+	}
+}
+
+
+#define FIFOBENCHSIZE	64
+uint32_t FifoBenchBuffer[FIFOBENCHSIZE];
+uint32_t FifoBenchData[FIFOBENCHSIZE];
+FifoType* FifoBench = NULL;
+uint32_t RingBenchBuffer[FIFOBENCHSIZE];
+RingType RingBench;
+
+// the Lab 2 OS_Fifo_Put/OS_Fifo_Get that OS_FifoCreate replaced, kept as the baseline:
+// % indexing, an element count, and a counting semaphore signalled for every element
+uint32_t LegacyFifo[FIFOBENCHSIZE];
+uint32_t LegacyPutIndex;
+uint32_t LegacyGetIndex;
+uint32_t LegacyCount;
+Sema4Type LegacyDataAvailable;
+
+static int legacyFifoPut(uint32_t data){
+	if(LegacyCount == FIFOBENCHSIZE){
+		return 0;
+	}
+	
+	LegacyFifo[LegacyPutIndex] = data;
+	LegacyPutIndex = (LegacyPutIndex+1)%FIFOBENCHSIZE;
+	LegacyCount++;
+	
+	OS_Signal(&LegacyDataAvailable);
+	
+	return 1;
+}
+
+static uint32_t legacyFifoGet(void){
+	OS_Wait(&LegacyDataAvailable);
+	
+	long sr = StartCritical();
+	uint32_t data = LegacyFifo[LegacyGetIndex];
+	LegacyCount--;
+	LegacyGetIndex = (LegacyGetIndex+1)%FIFOBENCHSIZE;
+	EndCritical(sr);
+	
+	return data;
+}
+
+// Print per element cost of the legacy FIFO, of the FIFO one element at a time and in bulk,
+// and of the single producer, single consumer ring
+void FifoBenchmark(void){
+	if(FifoBench == NULL){
+		FifoBench = OS_FifoCreate(FifoBenchBuffer, FIFOBENCHSIZE, sizeof(uint32_t));
+		if(FifoBench == NULL){
+			Interpreter_OutString("\nno FIFO left\n");
+			return;
+		}
+	}
+	
+	OS_InitSemaphore(&LegacyDataAvailable, 0);
+	LegacyPutIndex = 0;
+	LegacyGetIndex = 0;
+	LegacyCount = 0;
+	uint32_t start = OS_Time();
+	for(int i = 0; i < FIFOBENCHSIZE; i++){
+		legacyFifoPut(FifoBenchData[i]);
+	}
+	for(int i = 0; i < FIFOBENCHSIZE; i++){
+		FifoBenchData[i] = legacyFifoGet();
+	}
+	uint32_t legacyTime = OS_TimeDifference(start, OS_Time());
+	
+	start = OS_Time();
+	for(int i = 0; i < FIFOBENCHSIZE; i++){
+		OS_FifoPut(FifoBench, &FifoBenchData[i]);
+	}
+	for(int i = 0; i < FIFOBENCHSIZE; i++){
+		OS_FifoGet(FifoBench, &FifoBenchData[i]);
+	}
+	uint32_t singleTime = OS_TimeDifference(start, OS_Time());
+	
+	start = OS_Time();
+	OS_FifoPutBulk(FifoBench, FifoBenchData, FIFOBENCHSIZE);
+	uint32_t received = 0;
+	while(received < FIFOBENCHSIZE){
+		received += OS_FifoGetBulk(FifoBench, &FifoBenchData[received], FIFOBENCHSIZE - received);
+	}
+	uint32_t bulkTime = OS_TimeDifference(start, OS_Time());
+	
+	// watermark past the puts, so the ring never wakes anyone while being measured
+	OS_RingInit(&RingBench, RingBenchBuffer, FIFOBENCHSIZE, FIFOBENCHSIZE);
+	start = OS_Time();
+	for(int i = 0; i < FIFOBENCHSIZE-1; i++){
+		OS_RingPut(&RingBench, FifoBenchData[i]);
+	}
+	for(int i = 0; i < FIFOBENCHSIZE-1; i++){
+		FifoBenchData[i] = OS_RingGet(&RingBench);
+	}
+	uint32_t ringTime = OS_TimeDifference(start, OS_Time());
+	
+	Interpreter_OutString("\nput+get per element (12.5ns)");
+	Interpreter_OutString("\nlegacy : ");
+	UART_OutUDec(legacyTime/FIFOBENCHSIZE);
+	Interpreter_OutString("\nsingle : ");
+	UART_OutUDec(singleTime/FIFOBENCHSIZE);
+	Interpreter_OutString("\nbulk   : ");
+	UART_OutUDec(bulkTime/FIFOBENCHSIZE);
+	Interpreter_OutString("\nring   : ");
+	UART_OutUDec(ringTime/(FIFOBENCHSIZE-1));
+	Interpreter_OutString("\n");
+}
+
+#define FILTERBENCHSIZE	256
+#define FILTERBENCHTAPS	16
+float FloatFilterData[FILTERBENCHTAPS];
+float FloatFilterSum;
+uint32_t FloatFilterIndex;
+
+// the moving average of LPF_Calc in single precision
+static float floatFilterCalc(float newData){
+	FloatFilterIndex = (FloatFilterIndex + 1)%FILTERBENCHTAPS;
+	FloatFilterSum += newData - FloatFilterData[FloatFilterIndex];
+	FloatFilterData[FloatFilterIndex] = newData;
+	return FloatFilterSum*(1.0f/FILTERBENCHTAPS);
+}
+
+// Print per sample cost of a 16 point moving average, fixed point with LPF_Calc and in float
+// The float loop runs with an FP context, so a switch away from it saves the FP registers too
+void FilterBenchmark(void){
+	int32_t fixedOut = 0;
+	LPF_Init(0, FILTERBENCHTAPS);
+	uint32_t start = OS_Time();
+	for(int i = 0; i < FILTERBENCHSIZE; i++){
+		fixedOut = LPF_Calc(i);
+	}
+	uint32_t fixedTime = OS_TimeDifference(start, OS_Time());
+	
+	float floatOut = 0;
+	for(int i = 0; i < FILTERBENCHTAPS; i++){
+		FloatFilterData[i] = 0;
+	}
+	FloatFilterSum = 0;
+	FloatFilterIndex = 0;
+	start = OS_Time();
+	for(int i = 0; i < FILTERBENCHSIZE; i++){
+		floatOut = floatFilterCalc((float)i);
+	}
+	uint32_t floatTime = OS_TimeDifference(start, OS_Time());
+	
+	Interpreter_OutString("\nfilter per sample (12.5ns)");
+	Interpreter_OutString("\nfixed : ");
+	UART_OutUDec(fixedTime/FILTERBENCHSIZE);
+	Interpreter_OutString("\nfloat : ");
+	UART_OutUDec(floatTime/FILTERBENCHSIZE);
+	// both should end on the average of the last 16 inputs
+	Interpreter_OutString("\noutput: ");
+	UART_OutSDec(fixedOut);
+	Interpreter_OutString(" ");
+	UART_OutSDec((int32_t)floatOut);
+	Interpreter_OutString("\n");
+}
+
+// Print stack size and peak usage of every thread
+void StackUsage(void){
+	StackStatsType stats;
+	Interpreter_OutString("\n");
+	Interpreter_OutString("id : peak/size (bytes)");
+	UART_OutChar('\n');
+	
+	for(int id = 0; id < threadId; id++){
+		if(OS_StackStats(id, &stats)){
+			UART_OutUDec(id);
+			Interpreter_OutString(" : ");
+			UART_OutUDec(stats.peakUsed);
+			Interpreter_OutString("/");
+			UART_OutUDec(stats.size);
+			if(stats.overflowed){
+				Interpreter_OutString(" OVERFLOW");
+			}
+			UART_OutChar('\n');
+		}
+	}
+}
+
+// Print CPU share and switch counts of every thread, like top
+void ThreadTop(void){
+	ThreadStatsType stats;
+	Interpreter_OutString("\n");
+	Interpreter_OutString("id pri cpu(0.1%) in preempted voluntary jobs missed");
+	UART_OutChar('\n');
+	
+	for(int id = 0; id < threadId; id++){
+		if(OS_ThreadStats(id, &stats)){
+			UART_OutUDec(id);
+			Interpreter_OutString(" ");
+			UART_OutUDec(stats.priority);
+			Interpreter_OutString(" ");
+			UART_OutUDec(stats.share);
+			Interpreter_OutString(" ");
+			UART_OutUDec(stats.switchesIn);
+			Interpreter_OutString(" ");
+			UART_OutUDec(stats.preemptions);
+			Interpreter_OutString(" ");
+			UART_OutUDec(stats.voluntarySwitches);
+			Interpreter_OutString(" ");
+			UART_OutUDec(stats.jobs);
+			Interpreter_OutString(" ");
+			UART_OutUDec(stats.deadlineMisses);
+			UART_OutChar('\n');
+		}
+	}
+}
+
+// Print release counts and worst case release jitter of every periodic task
+void PeriodicTimes(void){
+	PeriodicStatsType stats;
+	Interpreter_OutString("\n");
+	Interpreter_OutString("task pri period releases overruns maxjitter (12.5ns)");
+	UART_OutChar('\n');
+	
+	for(uint32_t i = 0; OS_PeriodicStats(i, &stats); i++){
+		UART_OutUDec(i);
+		Interpreter_OutString(" ");
+		UART_OutUDec(stats.priority);
+		Interpreter_OutString(" ");
+		UART_OutUDec(stats.period);
+		Interpreter_OutString(" ");
+		UART_OutUDec(stats.releases);
+		Interpreter_OutString(" ");
+		UART_OutUDec(stats.overruns);
+		Interpreter_OutString(" ");
+		UART_OutUDec(stats.maxJitter);
+		UART_OutChar('\n');
+	}
+}
+
+// Print the last faults with their stacked registers, and what MPU switching has cost
+void FaultLog(void){
+	FaultRecordType record;
+	MpuStatsType mpu;
+	Interpreter_OutString("\n");
+	Interpreter_OutString("ms id exception cfsr hfsr address : r0 r1 r2 r3 r12 lr pc xpsr");
+	UART_OutChar('\n');
+	
+	for(uint32_t i = 0; OS_FaultRecord(i, &record); i++){
+		UART_OutUDec(record.time);
+		Interpreter_OutString(" ");
+		UART_OutSDec(record.id);
+		Interpreter_OutString(" ");
+		UART_OutUDec(record.exception);
+		Interpreter_OutString(" ");
+		UART_OutUHex(record.cfsr);
+		Interpreter_OutString(" ");
+		UART_OutUHex(record.hfsr);
+		Interpreter_OutString(" ");
+		UART_OutUHex(record.address);
+		Interpreter_OutString(" :");
+		for(int r = 0; r < 8; r++){
+			Interpreter_OutString(" ");
+			UART_OutUHex(record.registers[r]);
+		}
+		UART_OutChar('\n');
+	}
+	
+	OS_MpuStats(&mpu);
+	Interpreter_OutString("mpu switches ");
+	UART_OutUDec(mpu.switches);
+	Interpreter_OutString(" updates ");
+	UART_OutUDec(mpu.updates);
+	Interpreter_OutString(" avg ");
+	UART_OutUDec(mpu.updates ? (uint32_t)(mpu.cycles/mpu.updates) : 0);
+	Interpreter_OutString(" max ");
+	UART_OutUDec(mpu.maxCycles);
+	Interpreter_OutString(" (12.5ns)");
+	UART_OutChar('\n');
+}
+
+// Print disk throughput for transfers of 1, 8 and 32 sectors
+void DiskBenchmark(void){
+	static const unsigned long runs[] = {1, 8, 32};
+	unsigned long writeKBps, readKBps;
+	Interpreter_OutString("\n\r");
+	Interpreter_OutString("sectors write read (KB/s)");
+	Interpreter_OutString("\n\r");
+	
+	for(int i = 0; i < sizeof(runs)/sizeof(runs[0]); i++){
+		if(eFile_Throughput(runs[i], &writeKBps, &readKBps)){
+			Interpreter_OutString("trouble with the disk");
+			Interpreter_OutString("\n\r");
+			return;
+		}
+		UART_OutUDec(runs[i]);
+		Interpreter_OutString(" ");
+		UART_OutUDec(writeKBps);
+		Interpreter_OutString(" ");
+		if(readKBps){
+			UART_OutUDec(readKBps);
+		}else{
+			// too fast to time
+			Interpreter_OutString("-");
+		}
+		Interpreter_OutString("\n\r");
+	}
+}
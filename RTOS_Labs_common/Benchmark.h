@@ -0,0 +1,59 @@
+// *************Benchmark.h**************
+// Kernel measurements and benchmarks the interpreter prints
+// Each one writes a small table to the interpreter's terminal,
+// times are in 12.5ns bus cycles unless the heading says otherwise
+
+#ifndef __BENCHMARK_H
+#define __BENCHMARK_H  1
+#include <stdint.h>
+
+// ******** SleepISRTime ************
+// print the worst case sleep tick ISR time per number of sleeping threads
+// input:  size of the table and the table, SleeperSize and SleepISRMaxTime of the OS
+// output: none
+void SleepISRTime(uint32_t const SleeperSize, uint32_t SleepISRMaxTime[]);
+
+// ******** FifoBenchmark ************
+// print the put+get cost per element of the legacy Lab 2 FIFO, of OS_FifoPut/OS_FifoGet,
+// of OS_FifoPutBulk/OS_FifoGetBulk and of the single producer, single consumer ring
+// input:  none
+// output: none
+void FifoBenchmark(void);
+
+// ******** FilterBenchmark ************
+// print the per sample cost of a 16 point moving average, fixed point with LPF_Calc and in float
+// input:  none
+// output: none
+void FilterBenchmark(void);
+
+// ******** StackUsage ************
+// print the stack size and peak usage of every thread
+// input:  none
+// output: none
+void StackUsage(void);
+
+// ******** ThreadTop ************
+// print the CPU share and switch counts of every thread, like top
+// input:  none
+// output: none
+void ThreadTop(void);
+
+// ******** PeriodicTimes ************
+// print the release counts and worst case release jitter of every periodic task
+// input:  none
+// output: none
+void PeriodicTimes(void);
+
+// ******** FaultLog ************
+// print the last faults with their stacked registers, and what MPU switching has cost
+// input:  none
+// output: none
+void FaultLog(void);
+
+// ******** DiskBenchmark ************
+// print the eDisk write and read throughput for transfers of 1, 8 and 32 sectors, see eFile_Throughput
+// input:  none
+// output: none
+void DiskBenchmark(void);
+
+#endif
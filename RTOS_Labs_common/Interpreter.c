@@ -16,12 +16,17 @@
 #include "../RTOS_Labs_common/eDisk.h"
 #include "../RTOS_Labs_common/eFile.h"
 #include "../RTOS_Labs_common/ADC.h"
+#include "../RTOS_Labs_common/Trace.h"
+#include "../RTOS_Labs_common/Syscall.h"
+#include "../RTOS_Labs_common/Benchmark.h"
 #include "../RTOS_Lab5_ProcessLoader\loader.h"
 
 
-extern int32_t MaxJitter;             // largest time jitter between interrupts in usec
+extern int32_t MaxJitter;             // largest periodic release jitter in 0.1 usec
 extern uint32_t const JitterSize;
 extern uint32_t JitterHistogram[];
+extern uint32_t const SleeperSize;
+extern uint32_t SleepISRMaxTime[];
 
 extern int serverClientStatus;
 
@@ -57,7 +62,7 @@ void Interpreter_InString(char *bufPt, uint16_t max){
 // Print jitter histogram
 void Jitter(int32_t MaxJitter, uint32_t const JitterSize, uint32_t JitterHistogram[]){
   // write this for Lab 3 (the latest)
-	Interpreter_OutString("MaxJitter: ");
+	Interpreter_OutString("MaxJitter (0.1us): ");
 	UART_OutSDec(MaxJitter);
 	UART_OutChar('\n');
 	
@@ -73,6 +78,30 @@ void Jitter(int32_t MaxJitter, uint32_t const JitterSize, uint32_t JitterHistogr
 }
 
 
+// Dump the kernel trace over the UART, tools/trace2chrome.py finds it in a capture of the terminal
+void TraceDumpUART(void){
+	Interpreter_OutString("\n");
+	Trace_Dump(UART_OutChar);
+	Interpreter_OutString("\n");
+}
+
+static void traceFileOutChar(char data){
+	eFile_Write(data);
+}
+
+// Save the kernel trace to an eFile file
+void TraceDumpFile(char* fileName){
+	Interpreter_OutString("\n\r");
+	if(eFile_Create(fileName) || eFile_WOpen(fileName)){
+		Interpreter_OutString("can't open file");
+	}else{
+		UART_OutUDec(Trace_Dump(traceFileOutChar));
+		eFile_WClose();
+		Interpreter_OutString(" records saved");
+	}
+	Interpreter_OutString("\n\r");
+}
+
 // Format the disk
 void FormatDisk(){
 	// from lab 4
@@ -143,8 +172,17 @@ void MountFs(void){
 	Interpreter_OutString("\n\r");
 }
 
+// loaded programs run unprivileged, so the ST7735_Message they link against goes through the system call
+static void processST7735_Message(uint32_t d, uint32_t l, char *pt, int32_t value){
+#ifdef __CC_ARM
+	SVC_ST7735_Message(d, l, pt, value);
+#else
+	ST7735_Message(d, l, pt, value);
+#endif
+}
+
 static const ELFSymbol_t symtab[] = {
- { "ST7735_Message", ST7735_Message } // address of ST7735_Message
+ { "ST7735_Message", processST7735_Message } // address of the system call wrapper
 }; 
 
 // Load User Program
@@ -234,6 +272,24 @@ char* helpStringResult = "\n"
 												 "\n"
 												 "jit_his\tprints out jitter histogram and max jitter"
 												 "\n"
+												 "per_jit\tprints out release counts and max jitter of every periodic task"
+												 "\n"
+												 "slp_isr\tprints out worst case sleep tick ISR time per number of sleepers"
+												 "\n"
+												 "stk_use\tprints out peak stack usage of every thread"
+												 "\n"
+												 "cpu_top\tprints out CPU share and switch counts of every thread"
+												 "\n"
+												 "fif_bch\tprints out FIFO put+get cost per element, single, bulk and SPSC ring"
+												 "\n"
+												 "flt_bch\tprints out moving average cost per sample, fixed point and float"
+												 "\n"
+												 "fau_log\tprints out the last faults and the MPU context switch cost"
+												 "\n"
+												 "trc_uar\tdumps the kernel event trace over the UART in binary"
+												 "\n"
+												 "trc_fil\tsaves the kernel event trace to an eFile file"
+												 "\n"
 												 "prt_dir\tprints out eFile directory"
 												 "\n"
 												 "prt_fil\tprints out eFile file"
@@ -242,6 +298,8 @@ char* helpStringResult = "\n"
 												 "\n"
 												 "fmt_dsk\tformat eDisk"
 												 "\n"
+												 "dsk_bch\tprints out eDisk throughput for 1, 8 and 32 sector transfers"
+												 "\n"
 												 "crt_fil\tcreate file with specified name eDisk"
 												 "\n"
 												 "wrt_fil\tcreate file with specified name eDisk and string of 8 characters"
@@ -489,17 +547,17 @@ void Interpreter(void){
 			
 		}else if(strcmp(commandBuffer, "get_tme") == 0){
 			uint32_t time = OS_MsTime();
-			//7 digits can support > 1 hour + 'm' + 's' + '\0' = 10 chars needed
-			char timeString[10];
-			for(int i = 0; i < 10; i++){
+			//10 digits hold any 32-bit ms count, 49.7 days + 'm' + 's' + '\0' = 13 chars needed
+			char timeString[13];
+			for(int i = 0; i < 13; i++){
 				timeString[i] = '0';
 			}
 			
-			timeString[9] = '\0';
-			timeString[8] = 's';
-			timeString[7] = 'm';
+			timeString[12] = '\0';
+			timeString[11] = 's';
+			timeString[10] = 'm';
 			
-			for(int i = 6; i > 0 && time > 0; i--, time /=10){
+			for(int i = 9; i >= 0 && time > 0; i--, time /=10){
 				timeString[i] = '0' +(time % 10);
 			}
 			Interpreter_OutString("\n");
@@ -511,6 +569,27 @@ void Interpreter(void){
 			Interpreter_OutString("\n");
 		}else if(strcmp(commandBuffer, "jit_his") == 0){
 			Jitter(MaxJitter, JitterSize, JitterHistogram);
+		}else if(strcmp(commandBuffer, "per_jit") == 0){
+			PeriodicTimes();
+		}else if(strcmp(commandBuffer, "slp_isr") == 0){
+			SleepISRTime(SleeperSize, SleepISRMaxTime);
+		}else if(strcmp(commandBuffer, "stk_use") == 0){
+			StackUsage();
+		}else if(strcmp(commandBuffer, "cpu_top") == 0){
+			ThreadTop();
+		}else if(strcmp(commandBuffer, "fif_bch") == 0){
+			FifoBenchmark();
+		}else if(strcmp(commandBuffer, "flt_bch") == 0){
+			FilterBenchmark();
+		}else if(strcmp(commandBuffer, "fau_log") == 0){
+			FaultLog();
+		}else if(strcmp(commandBuffer, "trc_uar") == 0){
+			TraceDumpUART();
+		}else if(strcmp(commandBuffer, "trc_fil") == 0){
+			Interpreter_OutString("\n\r");
+			Interpreter_OutString("type in name of file to save the trace to, 0-7 characters : ");
+			UART_InString(eFileNameBuffer, eFileNameLength-1);
+			TraceDumpFile(eFileNameBuffer);
 		}else if(strcmp(commandBuffer, "prt_dir") == 0){
 			PrintDirectory();
 		}else if(strcmp(commandBuffer, "prt_fil") == 0){
@@ -525,6 +604,8 @@ void Interpreter(void){
 			DeleteFile(eFileNameBuffer);
 		}else if(strcmp(commandBuffer, "fmt_dsk") == 0){
 			FormatDisk();
+		}else if(strcmp(commandBuffer, "dsk_bch") == 0){
+			DiskBenchmark();
 		}else if(strcmp(commandBuffer, "crt_fil") == 0){
 			Interpreter_OutString("\n\r");
 			Interpreter_OutString("type in name of file to create, 0-7 characters : ");
@@ -23,3 +23,11 @@
  */
 void Interpreter(void);
 
+/**
+ * @details  Output a string to the terminal the interpreter is serving,
+ * the telnet client while the telnet server thread runs it, the UART otherwise.
+ * @param  s null-terminated string
+ * @return none
+ * @brief  Interpreter output
+ */
+void Interpreter_OutString(char *s);
@@ -10,24 +10,72 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include <string.h>
+#ifdef HOST_SIM
+#include "../RTOS_Labs_common/host/HostPort.h"
+#else
 #include "../inc/tm4c123gh6pm.h"
 #include "../inc/CortexM.h"
+#endif
 #include "../inc/PLL.h"
 #include "../inc/LaunchPad.h"
 #include "../inc/Timer4A.h"
-#include "../inc/WTimer0A.h"
-#include "../inc/WTimer1A.h"
 #include "../RTOS_Labs_common/OS.h"
 #include "../RTOS_Labs_common/ST7735.h"
 #include "../inc/ADCT0ATrigger.h"
 #include "../RTOS_Labs_common/UART0int.h"
 #include "../RTOS_Labs_common/heap.h"
+#include "../RTOS_Labs_common/Trace.h"
 
 //#define TIMEPERIOD		TIME_500US
 #define TIMEPERIOD		TIME_1MS
-#define STACKSIZE			128
-#define FIFOSIZE			64
-#define THREAD_NUM		7
+// 1 stops the Timer5A and SysTick ticks while only the idle thread can run,
+// Timer5A is stretched to time out when the first sleeping thread is due
+#define TICKLESS_IDLE	1
+// longest tickless stretch, keeps TICKLESS_MAX_TICKS*TIMEPERIOD inside 32 bits
+#define TICKLESS_MAX_TICKS	50000
+#define STACKARENASIZE	3584	// bytes of thread stack, the same memory as the old 7 fixed 512 byte stacks
+#define STACKMINSIZE	128		// bytes, room for the initial register frame plus a little working space
+#define STACKCANARY		0xC0DEDBAD	// lowest word of every stack, overwritten only by an overflow
+#define STACKPAINT		0xA5A5A5A5	// rest of a new stack, the lowest overwritten word marks the peak usage
+#define EXC_RETURN_THREAD	0xFFFFFFF9	// back to thread mode on the main stack with a basic frame, no FP context
+#define FIFOSIZE			64		// largest legacy OS_Fifo, a power of 2
+#define FIFO_NUM			4			// number of FIFOs OS_FifoCreate can hand out
+// kernel objects the Create calls can hand out, processes use these instead of their own
+#define SEMA4_NUM			8
+#define MUTEX_NUM			4
+#define EVENTGROUP_NUM	4
+#define RING_NUM			4
+#define MSGQUEUE_NUM	4
+#define THREAD_NUM		16		// number of TCBs, stack memory comes from the stack arena
+#define PERIODIC_NUM	8			// number of tasks OS_AddPeriodicThread can take
+#define TIMERWHEELSIZE	32		// software timer wheel slots, one bit each in TimerWheelSlots
+#define TIMERDAEMONSTACK	256	// bytes of stack for the software timer callbacks
+// MPU regions, a higher number wins where regions overlap
+#define MPU_FLASH			0			// all of flash, read only and executable for every thread
+#define MPU_TEXT			1			// text segment of the running process
+#define MPU_DATA			2			// data segment of the running process
+#define MPU_STACK			3			// stack of the running process thread
+#define MPU_FLASH_ATTR	(0x06000000|NVIC_MPU_ATTR_CACHEABLE|(17 << 1)|NVIC_MPU_ATTR_ENABLE)	// read only, 256KB
+#define MPU_FLASH_SIZE	0x00040000		// bytes MPU_FLASH_ATTR covers from address 0
+#define MPU_SRAM_ATTR		(0x03000000|NVIC_MPU_ATTR_SHAREABLE|NVIC_MPU_ATTR_CACHEABLE)	// full access
+
+// priority bitmaps keep priority 0 in bit 31, so count leading zeros
+// returns the highest priority level that has a thread in it
+#define PRIORITY_BIT(priority)		(0x80000000UL >> (priority))
+#ifdef __CC_ARM
+#define HIGHEST_PRIORITY(bitmap)	__clz(bitmap)
+#else
+#define HIGHEST_PRIORITY(bitmap)	__builtin_clz(bitmap)
+#endif
+
+// orders the ring's element access against its index update, the only
+// synchronization between a ring's producer and consumer
+#ifdef __CC_ARM
+#define RING_BARRIER()	__dmb(0xF)
+#else
+#define RING_BARRIER()	__sync_synchronize()
+#endif
 
 /*
 struct TCB{
@@ -47,13 +95,47 @@ struct TCB{
 
 struct TCB* SleepPt = NULL;
 struct TCB ActiveThreads[PRIORITY_NUM];
+// bit (31-priority) is set while ActiveThreads[priority] is non-empty
+uint32_t ReadyPriorities = 0;
+// delta queue chained through the sleep links, each sleepTime is relative to the thread in front of it
 struct TCB SleepingThreads;
+int32_t SleepingThreadCount = 0;
 
 struct TCB threadPool[THREAD_NUM];
-int32_t stackPool[THREAD_NUM][STACKSIZE];
+
+// free thread stack memory, chained in address order through the start of each free block
+struct StackBlock{
+	uint32_t size;						// bytes, multiple of 8
+	struct StackBlock* next;
+};
+// 64-bit elements keep every stack double word aligned
+uint64_t stackArena[STACKARENASIZE/8];
+struct StackBlock* FreeStacks = NULL;
 
 struct PCB Processes;
 
+// killed threads and finished processes, their memory goes back from OS_Idle so OS_Kill stays short
+struct TCB* ReapThreads = NULL;				// chained through nextReap
+struct PCB* ReapProcesses = NULL;			// chained through nextPCB
+MutexType HeapMutex;
+// threads that ended on a fault, waiting for the timer daemon to start them over
+struct TCB* RestartThreads = NULL;		// chained through nextReap
+
+// threads in OS_Join, each waiting for the thread whose ID is in its joinId
+WaitQueueType Joiners;
+
+// the process and the thread whose regions are in the MPU, switches between them and kernel threads leave the MPU alone
+struct PCB* MpuPCB = NULL;
+struct TCB* MpuThread = NULL;
+MpuStatsType MpuStats;
+// what timing an empty stretch of code the way mpuLoad times itself costs, taken off each of its times
+#define MPUCALIBRATIONS	8
+uint32_t MpuTimeOverhead = 0;
+
+// the last FAULTRECORD_NUM faults, FaultCount%FAULTRECORD_NUM is the next one to overwrite
+FaultRecordType FaultRecords[FAULTRECORD_NUM];
+uint32_t FaultCount = 0;
+
 //dynamic global variables
 struct TCB* RunPt = NULL;
 int32_t** StackPt = NULL;
@@ -63,12 +145,42 @@ struct PCB* PcbPt = NULL;
 void* dataPt = NULL;
 
 
+//FIFOs handed out by OS_FifoCreate
+FifoType fifoPool[FIFO_NUM];
+
+// a pool of kernel objects a Create call hands out, with the process each one belongs to
+// a process can't write them, so the kernel trusts the links and buffer pointers inside
+struct ObjectPool{
+	void* objects;
+	uint32_t objectSize;
+	uint32_t count;
+	bool* used;
+	struct PCB** owners;				// NULL for an object a kernel thread created
+};
+Sema4Type sema4Pool[SEMA4_NUM];
+bool sema4Used[SEMA4_NUM];
+struct PCB* sema4Owners[SEMA4_NUM];
+MutexType mutexPool[MUTEX_NUM];
+bool mutexUsed[MUTEX_NUM];
+struct PCB* mutexOwners[MUTEX_NUM];
+EventGroupType eventGroupPool[EVENTGROUP_NUM];
+bool eventGroupUsed[EVENTGROUP_NUM];
+struct PCB* eventGroupOwners[EVENTGROUP_NUM];
+RingType ringPool[RING_NUM];
+bool ringUsed[RING_NUM];
+struct PCB* ringOwners[RING_NUM];
+MsgQueueType msgQueuePool[MSGQUEUE_NUM];
+bool msgQueueUsed[MSGQUEUE_NUM];
+struct PCB* msgQueueOwners[MSGQUEUE_NUM];
+static const struct ObjectPool Sema4Pool = {sema4Pool, sizeof(Sema4Type), SEMA4_NUM, sema4Used, sema4Owners};
+static const struct ObjectPool MutexPool = {mutexPool, sizeof(MutexType), MUTEX_NUM, mutexUsed, mutexOwners};
+static const struct ObjectPool EventGroupPool = {eventGroupPool, sizeof(EventGroupType), EVENTGROUP_NUM, eventGroupUsed, eventGroupOwners};
+static const struct ObjectPool RingPool = {ringPool, sizeof(RingType), RING_NUM, ringUsed, ringOwners};
+static const struct ObjectPool MsgQueuePool = {msgQueuePool, sizeof(MsgQueueType), MSGQUEUE_NUM, msgQueueUsed, msgQueueOwners};
+
 //Producer ISR -> Consumer Foreground FIFO
-int isrToForegroundFIFO[FIFOSIZE];
-Sema4Type dataAvailable;
-int putIFFIndex;
-int getIFFIndex;
-int isrToForegroundFIFOCount;
+RingType isrToForegroundFIFO;
+uint32_t isrToForegroundFIFOBuffer[FIFOSIZE];
 
 // Foreground -> Foreground Mailbox
 uint32_t Mailbox;
@@ -79,25 +191,144 @@ Sema4Type DataValid;
 //time keeping structures
 bool timeStarted = false;
 
-struct Time {
-	uint32_t ms;
-	uint32_t s;
-	uint32_t min;
-};
+// the clock is the free-running 64-bit WTIMER5, started in OS_Init
+uint64_t MsTimeStart = 0;							// clock when OS_ClearMsTime last ran
+
+// Timer5A cycles between the last tick counted and the start of the current Timer5A period,
+// non-zero once a tickless stretch ends part way through a tick
+uint32_t TickOffset = 0;
 
-struct Time time = {
-	.ms = 0,
-	.s = 0,
-	.min = 0
-};
 
+// CPU accounting, in bus cycles counted by the free-running WTIMER5
+uint64_t SwitchStamp;									// clock when RunPt was switched in, a thread can run for longer than the low word lasts
+uint64_t TotalRunTime = 0;						// cycles charged to threads since OS_Launch
+bool SwitchPreempted = false;					// the pending switch was forced on RunPt
 
 // Performance Measurements 
-int32_t MaxJitter;             // largest time jitter between interrupts in usec
+int32_t MaxJitter;             // largest periodic release jitter in 0.1 usec
 #define JITTERSIZE 64
 uint32_t const JitterSize=JITTERSIZE;
-uint32_t JitterHistogram[JITTERSIZE]={0,};
+uint32_t JitterHistogram[JITTERSIZE]={0,};	// periodic releases per 0.1 usec of jitter, the last bin takes the rest
+// worst case OS_TimerIncrement duration in 12.5ns units, indexed by number of sleeping threads
+#define SLEEPERSIZE 64
+uint32_t const SleeperSize=SLEEPERSIZE;
+uint32_t SleepISRMaxTime[SLEEPERSIZE+1]={0,};
+
+
+// real-time threads, see OS_AddRealTimeThread
+uint32_t SchedulingMode = SCHED_PRIORITY;
+int32_t RealTimeCount = 0;
+uint32_t RealTimeDensity = 0;					// sum of wcet/deadline of the real-time threads, parts per million
+uint32_t Ticks = 0;										// TIMEPERIOD ticks since the first OS_ClearMsTime, never cleared
+// n(2^(1/n)-1) in parts per million, the Liu and Layland bound for n threads, summed over
+// wcet/deadline it holds for deadline monotonic order
+static const uint32_t DMBound[8] = {1000000, 828427, 779763, 756828, 743491, 734772, 728626, 724061};
+#define DMBOUND_LIMIT	693147			// ln(2), the bound for any number of threads
+
+
+// software timers, see OS_SoftTimerStart
+// slot tick%TIMERWHEELSIZE chains every timer due at that tick or a whole number of laps later
+#define TIMERSLOT(tick)	((tick)&(TIMERWHEELSIZE-1))
+SoftTimerType* TimerWheel[TIMERWHEELSIZE];
+// bit (31-slot) is set while TimerWheel[slot] is not NULL
+uint32_t TimerWheelSlots = 0;
+uint32_t TimerWheelChecked = 0;				// last tick whose slot was looked at for the daemon
+uint32_t TimerDaemonTick = 0;					// last tick whose callbacks the daemon has run
+Sema4Type TimerDaemonReady;
+
+
+// chain tcb to the end of its priority list and mark that priority as occupied
+static void priorityListAppend(struct TCB* lists, uint32_t* bitmap, struct TCB* tcb){
+	struct TCB* listHead = &(lists[tcb->priority]);
+	tcb->nextTCB = listHead;
+	tcb->previousTCB = listHead->previousTCB;
+	listHead->previousTCB->nextTCB = tcb;
+	listHead->previousTCB = tcb;
+	*bitmap |= PRIORITY_BIT(tcb->priority);
+}
+
+// unchain tcb from its priority list and clear that priority once the list is empty
+static void priorityListRemove(struct TCB* lists, uint32_t* bitmap, struct TCB* tcb){
+	struct TCB* listHead = &(lists[tcb->priority]);
+	tcb->previousTCB->nextTCB = tcb->nextTCB;
+	tcb->nextTCB->previousTCB = tcb->previousTCB;
+	if(listHead->nextTCB == listHead){
+		*bitmap &= ~PRIORITY_BIT(tcb->priority);
+	}
+}
+
+// real-time threads are ordered by deadline, relative in SCHED_DM and absolute in SCHED_EDF
+static bool realTimeBefore(struct TCB* a, struct TCB* b){
+	if(SchedulingMode == SCHED_EDF){
+		return (int32_t)(a->absoluteDeadline - b->absoluteDeadline) < 0;
+	}
+	return a->deadline < b->deadline;
+}
+
+// real-time threads go in front of the first thread at their priority that they come before,
+// behind the ones with the same deadline, and ahead of every thread that is not real-time
+static void readyListAppend(struct TCB* tcb){
+	if(!tcb->realTime){
+		priorityListAppend(ActiveThreads, &ReadyPriorities, tcb);
+		return;
+	}
+	struct TCB* listHead = &(ActiveThreads[tcb->priority]);
+	struct TCB* next = listHead->nextTCB;
+	while(next != listHead && next->realTime && !realTimeBefore(tcb, next)){
+		next = next->nextTCB;
+	}
+	tcb->nextTCB = next;
+	tcb->previousTCB = next->previousTCB;
+	next->previousTCB->nextTCB = tcb;
+	next->previousTCB = tcb;
+	ReadyPriorities |= PRIORITY_BIT(tcb->priority);
+}
+
+static void readyListRemove(struct TCB* tcb){
+	priorityListRemove(ActiveThreads, &ReadyPriorities, tcb);
+}
+
+static void waitQueueInit(WaitQueueType* queue){
+	for(int i = 0; i < PRIORITY_NUM; i++){
+		queue->head[i] = NULL;
+	}
+	queue->waitingPriorities = 0;
+}
+
+// chain tcb to the end of the queue for its priority
+static void waitQueueAppend(WaitQueueType* queue, struct TCB* tcb){
+	struct TCB* head = queue->head[tcb->priority];
+	if(head == NULL){
+		tcb->nextTCB = tcb;
+		tcb->previousTCB = tcb;
+		queue->head[tcb->priority] = tcb;
+		queue->waitingPriorities |= PRIORITY_BIT(tcb->priority);
+	}else{
+		tcb->nextTCB = head;
+		tcb->previousTCB = head->previousTCB;
+		head->previousTCB->nextTCB = tcb;
+		head->previousTCB = tcb;
+	}
+}
+
+// unchain tcb from the queue for its priority
+static void waitQueueRemove(WaitQueueType* queue, struct TCB* tcb){
+	if(tcb->nextTCB == tcb){
+		queue->head[tcb->priority] = NULL;
+		queue->waitingPriorities &= ~PRIORITY_BIT(tcb->priority);
+	}else{
+		tcb->previousTCB->nextTCB = tcb->nextTCB;
+		tcb->nextTCB->previousTCB = tcb->previousTCB;
+		if(queue->head[tcb->priority] == tcb){
+			queue->head[tcb->priority] = tcb->nextTCB;
+		}
+	}
+}
 
+// first thread of the highest priority in the queue, queue can't be empty
+static struct TCB* waitQueueFirst(WaitQueueType* queue){
+	return queue->head[HIGHEST_PRIORITY(queue->waitingPriorities)];
+}
 
 /*------------------------------------------------------------------------------
   Systick Interrupt Handler
@@ -107,16 +338,21 @@ uint32_t JitterHistogram[JITTERSIZE]={0,};
 void SysTick_Handler(void) {
 	
 	long sr = StartCritical();
+	// RunPt changes with the switch, the exit record names the thread that was interrupted
+	int32_t interruptedId = RunPt->id;
+	TRACE(TRACE_ISR_ENTER, interruptedId, TRACE_SYSTICK);
 	int curRunPtPriority = RunPt->priority;
+	SwitchPreempted = true;
   OS_Suspend();
 	// this line is corrective measure for the scheduler
 	// if there is a task 1 at priority 5 and task 2 at priority 6
 	// scheduler would make RunPt task 2, because sequence is:
 	// cache nextTCB -> remove runPt from active threads -> find next thread to run -> rechain RunPt
 	// two threads with different priorities is corner case, similar to corner case of only one thread trying to context switch into itself
-	if(RunPt->priority > curRunPtPriority && (ActiveThreads[curRunPtPriority].nextTCB != &ActiveThreads[curRunPtPriority])){
+	if(RunPt->priority > curRunPtPriority && (ReadyPriorities & PRIORITY_BIT(curRunPtPriority))){
 		RunPt = ActiveThreads[curRunPtPriority].nextTCB;
 	}
+	TRACE(TRACE_ISR_EXIT, interruptedId, TRACE_SYSTICK);
 	EndCritical(sr);
 	
 } // end SysTick_Handler
@@ -132,24 +368,28 @@ static void scheduler(){
 		runPtNextTCB = runPtNextTCB->nextTCB;
 	}
 	
+	// catch an overflow before the thread being switched out runs again
+	if(RunPt->stackBase[0] != (int32_t)STACKCANARY){
+		RunPt->stackOverflowed = true;
+	}
+	
 	// first unchain RunPt
-	RunPt->nextTCB->previousTCB = RunPt->previousTCB;
-	RunPt->previousTCB->nextTCB = RunPt->nextTCB;
+	readyListRemove(RunPt);
 	
 	// pick the first, highest priority active thread to run next
-	for(int i = 0; i < PRIORITY_NUM; i++){
-		if(ActiveThreads[i].nextTCB != &(ActiveThreads[i])){
-			runPtNextTCB = ActiveThreads[i].nextTCB;
-			break;
-		}
+	if(ReadyPriorities){
+		runPtNextTCB = ActiveThreads[HIGHEST_PRIORITY(ReadyPriorities)].nextTCB;
 	}
 	
 	// chain RunPt to end of it's priority linkedlist
 	// placed here because if only one highest priority, then sequence of unchain -> chain -> find runPtNextTCB will result in itself
-	RunPt->previousTCB = ActiveThreads[RunPt->priority].previousTCB;
-	RunPt->nextTCB = &(ActiveThreads[RunPt->priority]);
-	ActiveThreads[RunPt->priority].previousTCB->nextTCB = RunPt;
-	ActiveThreads[RunPt->priority].previousTCB = RunPt;
+	readyListAppend(RunPt);
+	
+	// a preempted real-time thread keeps running while its job is still the most urgent
+	if(SwitchPreempted && RunPt->realTime && HIGHEST_PRIORITY(ReadyPriorities) == RunPt->priority &&
+		ActiveThreads[RunPt->priority].nextTCB == RunPt){
+		runPtNextTCB = RunPt;
+	}
 
 	RunPt = runPtNextTCB;
 }
@@ -181,6 +421,132 @@ void SysTick_Init(unsigned long period){
   NVIC_ST_CTRL_R = 0x07;
 }
 
+// free-running 64-bit up counter at the bus clock, no interrupts
+void WideTimer5_Init(void){
+  SYSCTL_RCGCWTIMER_R |= 0x20;  // 0) activate WTIMER5
+  while((SYSCTL_PRWTIMER_R&0x20) == 0){};
+  WTIMER5_CTL_R = 0x00000000;   // 1) disable WTIMER5A during setup
+  WTIMER5_CFG_R = 0x00000000;   // 2) configure for 64-bit mode
+  WTIMER5_TAMR_R = 0x00000012;  // 3) configure for periodic mode, up-count
+  WTIMER5_TAILR_R = 0xFFFFFFFF; // 4) reload value, low word
+  WTIMER5_TBILR_R = 0xFFFFFFFF; //    and high word
+  WTIMER5_CTL_R = 0x00000001;   // 5) enable WTIMER5A
+}
+
+// chain a timer into the wheel slot of its expiry, must be called with interrupts disabled
+static void timerWheelInsert(SoftTimerType* timer){
+	uint32_t slot = TIMERSLOT(timer->expiry);
+	SoftTimerType* head = TimerWheel[slot];
+	if(head){
+		timer->next = head;
+		timer->previous = head->previous;
+		head->previous->next = timer;
+		head->previous = timer;
+	}else{
+		timer->next = timer;
+		timer->previous = timer;
+		TimerWheel[slot] = timer;
+		TimerWheelSlots |= PRIORITY_BIT(slot);
+	}
+}
+
+// unchain a timer from its wheel slot, must be called with interrupts disabled
+static void timerWheelRemove(SoftTimerType* timer){
+	uint32_t slot = TIMERSLOT(timer->expiry);
+	if(timer->next == timer){
+		TimerWheel[slot] = NULL;
+		TimerWheelSlots &= ~PRIORITY_BIT(slot);
+	}else{
+		timer->previous->next = timer->next;
+		timer->next->previous = timer->previous;
+		if(TimerWheel[slot] == timer){
+			TimerWheel[slot] = timer->next;
+		}
+	}
+	timer->next = NULL;
+	timer->previous = NULL;
+}
+
+// first timer in the slot of tick that is due by tick, NULL if none
+// must be called with interrupts disabled
+static SoftTimerType* timerWheelDue(uint32_t tick){
+	SoftTimerType* head = TimerWheel[TIMERSLOT(tick)];
+	SoftTimerType* timer = head;
+	if(timer){
+		do{
+			if((int32_t)(timer->expiry - tick) <= 0){
+				return timer;
+			}
+			timer = timer->next;
+		}while(timer != head);
+	}
+	return NULL;
+}
+
+// wake the timer daemon if a slot of the ticks counted since the last check holds a timer
+// a timer a lap or more away wakes it for nothing, which only costs the daemon a look
+// must be called with interrupts disabled
+static void timerWheelCheck(void){
+	uint32_t ticks = Ticks - TimerWheelChecked;
+	TimerWheelChecked = Ticks;
+	for(uint32_t i = 0; i < ticks && i < TIMERWHEELSIZE; i++){
+		if(TimerWheelSlots&PRIORITY_BIT(TIMERSLOT(Ticks - i))){
+			OS_bSignal(&TimerDaemonReady);
+			return;
+		}
+	}
+}
+
+// ticks until the next wheel slot holding a timer comes round, 0xFFFFFFFF if the wheel is empty
+// must be called with interrupts disabled
+static uint32_t timerWheelNext(void){
+	if(TimerWheelSlots == 0){
+		return 0xFFFFFFFF;
+	}
+	// rotate the slot of the next tick into bit 31, then count leading zeros
+	uint32_t start = TIMERSLOT(Ticks + 1);
+	uint32_t slots = start ? (TimerWheelSlots << start)|(TimerWheelSlots >> (32 - start)) : TimerWheelSlots;
+	return HIGHEST_PRIORITY(slots) + 1;
+}
+
+// defined with OS_Exit further down
+static void threadsRestart(void);
+
+// kernel thread that runs the callbacks of the software timers as they expire,
+// and starts over the threads that ended on a fault, see OS_Exit
+static void timerDaemon(void){
+	while(1){
+		OS_bWait(&TimerDaemonReady);
+		long sr = StartCritical();
+		threadsRestart();
+		// every slot is visited once a lap, a daemon further behind only needs the last lap
+		if(Ticks - TimerDaemonTick > TIMERWHEELSIZE){
+			TimerDaemonTick = Ticks - TIMERWHEELSIZE;
+		}
+		while(TimerDaemonTick != Ticks){
+			TimerDaemonTick++;
+			SoftTimerType* timer;
+			while((timer = timerWheelDue(TimerDaemonTick)) != NULL){
+				timerWheelRemove(timer);
+				if(timer->period){
+					// a periodic timer that fell behind drops the expiries it missed
+					do{
+						timer->expiry += timer->period;
+					}while((int32_t)(timer->expiry - Ticks) <= 0);
+					timerWheelInsert(timer);
+				}
+				void (*callback)(void*) = timer->callback;
+				void* arg = timer->arg;
+				// the callback may start or stop any timer, this one included
+				EndCritical(sr);
+				callback(arg);
+				sr = StartCritical();
+			}
+		}
+		EndCritical(sr);
+	}
+}
+
 /**
  * @details  Initialize operating system, disable interrupts until OS_Launch.
  * Initialize OS controlled I/O: serial, ADC, systick, LaunchPad I/O and timers.
@@ -197,6 +563,10 @@ void OS_Init(void){
 	
 	DisableInterrupts();
 	
+	// the clock runs from here on, OS_Time and the trace timestamps count from OS_Init
+	WideTimer5_Init();
+	Trace_Init();
+	
 	//initializing static pointers
 	
 	for(int i = 0; i < PRIORITY_NUM; i++){
@@ -205,14 +575,61 @@ void OS_Init(void){
 		ActiveThreads[i].listHead = true;
 	}
 	
-	SleepingThreads.nextTCB = &SleepingThreads;
-	SleepingThreads.previousTCB = &SleepingThreads;
+	// all of the arena starts out as one free block
+	FreeStacks = (struct StackBlock*)stackArena;
+	FreeStacks->size = STACKARENASIZE;
+	FreeStacks->next = NULL;
+	
+	SleepingThreads.nextSleepTCB = &SleepingThreads;
+	SleepingThreads.previousSleepTCB = &SleepingThreads;
 	SleepingThreads.listHead = true;
 	
 	// added for Lab 5
 	Processes.nextPCB = &Processes;
 	Processes.prevPCB = &Processes;
 	Processes.listHead = true;
+	ReapThreads = NULL;
+	ReapProcesses = NULL;
+	RestartThreads = NULL;
+	OS_InitMutex(&HeapMutex);
+	waitQueueInit(&Joiners);
+	// no TCB has been handed out yet, so OS_Join must not match one
+	for(int i = 0; i < THREAD_NUM; i++){
+		threadPool[i].id = -1;
+	}
+	
+	OS_InitSemaphore(&TimerDaemonReady, 0);
+	TimerWheelChecked = Ticks;
+	TimerDaemonTick = Ticks;
+	
+	// threads of a process run unprivileged, the MPU gives them flash plus the regions of their
+	// own segments and stack, loaded as they are switched in, see mpuLoad
+	// privileged code keeps the default memory map wherever no region says otherwise
+	MpuPCB = NULL;
+	MpuThread = NULL;
+	memset(&MpuStats, 0, sizeof(MpuStats));
+	// the fastest of a few, the first reads can be slowed by the flash prefetch
+	MpuTimeOverhead = 0xFFFFFFFF;
+	for(int i = 0; i < MPUCALIBRATIONS; i++){
+		uint32_t start = OS_Time();
+		uint32_t overhead = OS_TimeDifference(start, OS_Time());
+		if(overhead < MpuTimeOverhead){
+			MpuTimeOverhead = overhead;
+		}
+	}
+	NVIC_MPU_BASE_R = 0x00000000|NVIC_MPU_BASE_VALID|MPU_FLASH;
+	NVIC_MPU_ATTR_R = MPU_FLASH_ATTR;
+	for(uint32_t region = MPU_TEXT; region <= MPU_STACK; region++){
+		NVIC_MPU_BASE_R = NVIC_MPU_BASE_VALID|region;
+		NVIC_MPU_ATTR_R = 0;
+	}
+	NVIC_MPU_CTRL_R = NVIC_MPU_CTRL_PRIVDEFEN|NVIC_MPU_CTRL_ENABLE;
+	// give each fault its own handler rather than escalating, so the records tell them apart
+	NVIC_SYS_HND_CTRL_R |= NVIC_SYS_HND_CTRL_USAGE|NVIC_SYS_HND_CTRL_BUS|NVIC_SYS_HND_CTRL_MEM;
+	
+	// the FPU is enabled in startup.s, an exception only reserves frame space for the FP registers
+	// of a thread that has used them and only fills it in if the handler uses the FPU too
+	NVIC_FPCC_R |= NVIC_FPCC_ASPEN|NVIC_FPCC_LSPEN;
 	
 	//Systick_Init belongs in OS_Launch
 	//set PendSV priority to 7
@@ -228,13 +645,207 @@ void OS_Init(void){
 void OS_InitSemaphore(Sema4Type *semaPt, int32_t value){
   // put Lab 2 (and beyond) solution here
 	semaPt->Value = value;
-	for(int i = 0; i < PRIORITY_NUM; i++){
-		semaPt->blockedThreads[i].nextTCB = &(semaPt->blockedThreads[i]);
-		semaPt->blockedThreads[i].previousTCB = &(semaPt->blockedThreads[i]);
-		semaPt->blockedThreads[i].listHead = true;
-	}
+	waitQueueInit(&(semaPt->blockedThreads));
 }; 
 
+// the process of the thread running now, NULL for a kernel thread
+// StackPt rather than RunPt, which already points at the next thread while a switch is pending
+static struct PCB* callerPCB(void){
+	struct TCB* caller = (struct TCB*)StackPt;
+	return caller ? caller->currentPCB : NULL;
+}
+
+// hand out a free object of pool to the process of the running thread
+// returns the object, NULL if none is left, must be called with interrupts disabled
+static void* poolTake(const struct ObjectPool* pool){
+	for(uint32_t i = 0; i < pool->count; i++){
+		if(!pool->used[i]){
+			pool->used[i] = true;
+			pool->owners[i] = callerPCB();
+			return (uint8_t*)pool->objects + i*pool->objectSize;
+		}
+	}
+	return NULL;
+}
+
+// give back an object poolTake handed out, must be called with interrupts disabled
+static void poolGive(const struct ObjectPool* pool, void* object){
+	pool->used[((uint8_t*)object - (uint8_t*)pool->objects)/pool->objectSize] = false;
+}
+
+// is object one that pool handed out, and for a process thread, one its own process took
+static bool poolValid(const struct ObjectPool* pool, const void* object){
+	uintptr_t offset = (uintptr_t)object - (uintptr_t)pool->objects;
+	if(offset >= pool->count*pool->objectSize || offset%pool->objectSize){
+		return false;
+	}
+	uint32_t i = offset/pool->objectSize;
+	struct PCB* caller = callerPCB();
+	return pool->used[i] && (caller == NULL || pool->owners[i] == caller);
+}
+
+// give back every object of a process whose threads are all gone, so nothing waits on them
+// must be called with interrupts disabled
+static void poolsRelease(struct PCB* pcb){
+	const struct ObjectPool* pools[] = {&Sema4Pool, &MutexPool, &EventGroupPool, &RingPool, &MsgQueuePool};
+	for(int p = 0; p < sizeof(pools)/sizeof(pools[0]); p++){
+		for(uint32_t i = 0; i < pools[p]->count; i++){
+			if(pools[p]->owners[i] == pcb){
+				pools[p]->used[i] = false;
+				pools[p]->owners[i] = NULL;
+			}
+		}
+	}
+}
+
+// ******** OS_Sema4Create ************
+// initialize a semaphore the kernel keeps, for a process, which can't be trusted with the
+// wait queue links inside one in its own memory
+// input:  initial value
+// output: the semaphore, NULL if none is left
+Sema4Type* OS_Sema4Create(int32_t value){
+	long sr = StartCritical();
+	Sema4Type* semaPt = poolTake(&Sema4Pool);
+	if(semaPt){
+		OS_InitSemaphore(semaPt, value);
+	}
+	EndCritical(sr);
+	return semaPt;
+}
+
+// ******** OS_Sema4Valid ************
+// check a semaphore handle
+// input:  semaphore
+// output: 1 if OS_Sema4Create handed it out, to the calling process for a process thread, 0 otherwise
+int OS_Sema4Valid(Sema4Type *semaPt){
+	return poolValid(&Sema4Pool, semaPt);
+}
+
+// move RunPt from the active threads onto a wait queue
+// must be called with interrupts disabled
+static void blockRunPt(WaitQueueType *queue){
+	struct TCB* blockedThread = RunPt;		
+	OS_Suspend();
+	// blockedThread aka cached RunPt is now the last thread of its priority
+	
+	// unchain blockedThread from ActiveThreads priority list
+	readyListRemove(blockedThread);
+	
+	// chain blockedThread to blocked threads for this semaphore
+	waitQueueAppend(queue, blockedThread);
+	blockedThread->waitQueue = queue;
+	TRACE(TRACE_BLOCK, blockedThread->id, (uintptr_t)queue);
+}
+
+// if priority is higher than RunPt priority, OS_Suspend and reset Systick timer
+// must be called with interrupts disabled
+static void preemptForPriority(int32_t priority){
+	if(priority < RunPt->priority){
+		SwitchPreempted = true;
+		// since OS_Suspend is lowest priority, should be safe to perform this operation
+		OS_Suspend();
+		// writing to NVIC_ST_CURRENT_R clears the current counter of Systick, effectively reseting the Systick counter
+		NVIC_ST_CURRENT_R = 0;
+	}
+}
+
+// like preemptForPriority, for a thread that just became ready
+// at RunPt's priority a real-time thread with an earlier deadline comes first as well
+// must be called with interrupts disabled
+static void preemptForThread(struct TCB* tcb){
+	if(tcb->priority == RunPt->priority && tcb->realTime && (!RunPt->realTime || realTimeBefore(tcb, RunPt))){
+		SwitchPreempted = true;
+		OS_Suspend();
+		NVIC_ST_CURRENT_R = 0;
+		return;
+	}
+	preemptForPriority(tcb->priority);
+}
+
+// chain tcb into the sleeping threads delta queue to wake after ticks
+// threads waking at the same time stay in FIFO order, must be called with interrupts disabled
+static void sleepQueueInsert(struct TCB* tcb, uint32_t ticks){
+	// find where tcb belongs in the delta queue
+	struct TCB* sleepingThreadsPt = SleepingThreads.nextSleepTCB;
+	while(sleepingThreadsPt != &SleepingThreads && sleepingThreadsPt->sleepTime <= ticks){
+		ticks -= sleepingThreadsPt->sleepTime;
+		sleepingThreadsPt = sleepingThreadsPt->nextSleepTCB;
+	}
+	
+	// chain tcb in front of sleepingThreadsPt, which now wakes relative to tcb
+	tcb->sleepTime = ticks;
+	tcb->sleeping = true;
+	tcb->nextSleepTCB = sleepingThreadsPt;
+	tcb->previousSleepTCB = sleepingThreadsPt->previousSleepTCB;
+	sleepingThreadsPt->previousSleepTCB->nextSleepTCB = tcb;
+	sleepingThreadsPt->previousSleepTCB = tcb;
+	if(sleepingThreadsPt != &SleepingThreads){
+		sleepingThreadsPt->sleepTime -= ticks;
+	}
+	SleepingThreadCount++;
+}
+
+// unchain tcb from the sleeping threads, the thread behind it inherits what was left of its delta
+// must be called with interrupts disabled
+static void sleepQueueRemove(struct TCB* tcb){
+	if(tcb->nextSleepTCB != &SleepingThreads){
+		tcb->nextSleepTCB->sleepTime += tcb->sleepTime;
+	}
+	tcb->nextSleepTCB->previousSleepTCB = tcb->previousSleepTCB;
+	tcb->previousSleepTCB->nextSleepTCB = tcb->nextSleepTCB;
+	tcb->sleeping = false;
+	SleepingThreadCount--;
+}
+
+// move unblockedThread from queue back to the ready lists, and off the sleeping threads
+// if it was waiting with a timeout, must be called with interrupts disabled
+// the caller decides whether to preempt
+static void wakeThread(WaitQueueType *queue, struct TCB* unblockedThread){
+	// unchained blocked thread
+	waitQueueRemove(queue, unblockedThread);
+	unblockedThread->waitQueue = NULL;
+	
+	// woken before its timeout ran out
+	if(unblockedThread->sleeping){
+		sleepQueueRemove(unblockedThread);
+		unblockedThread->timedSema4 = NULL;
+	}
+	
+	// chain unblocked thread where it belongs
+	readyListAppend(unblockedThread);
+	TRACE(TRACE_WAKE, unblockedThread->id, (uintptr_t)queue);
+}
+
+// put the highest priority blocked thread, the first to block among equals, back into active threads
+// queue must have at least one blocked thread, must be called with interrupts disabled
+// returns the unblocked thread, the caller decides whether to preempt
+static struct TCB* wakeBlockedThread(WaitQueueType *queue){
+	// find the first highest priority blocked thread
+	struct TCB* unblockedThread = waitQueueFirst(queue);
+	wakeThread(queue, unblockedThread);
+	return unblockedThread;
+}
+
+// move tcb to the lists of a new priority, wherever it currently waits
+// must be called with interrupts disabled
+static void setPriority(struct TCB* tcb, int32_t priority){
+	if(tcb->priority == priority){
+		return;
+	}
+	if(tcb->waitQueue){
+		waitQueueRemove(tcb->waitQueue, tcb);
+		tcb->priority = priority;
+		waitQueueAppend(tcb->waitQueue, tcb);
+	}else if(tcb->sleeping){
+		// the sleeping threads are not ordered by priority
+		tcb->priority = priority;
+	}else{
+		readyListRemove(tcb);
+		tcb->priority = priority;
+		readyListAppend(tcb);
+	}
+}
+
 // ******** OS_Wait ************
 // decrement semaphore 
 // Lab2 spinlock
@@ -247,26 +858,7 @@ void OS_Wait(Sema4Type *semaPt){
 	long sr = StartCritical();
 	semaPt->Value--;
 	if(semaPt->Value < 0){
-		//EnableInterrupts();
-		//long sr2 = StartCritical();
-		
-		struct TCB* blockedThread = RunPt;		
-		OS_Suspend();
-		// blockedThread aka cached RunPt is now the last thread of its priority
-		
-		// unchain blockedThread from ActiveThreads priority list
-		blockedThread->previousTCB->nextTCB = blockedThread->nextTCB;
-		blockedThread->nextTCB->previousTCB = blockedThread->previousTCB;
-		
-		// chain blockedThread to blocked threads for this semaphore
-		blockedThread->nextTCB = &(semaPt->blockedThreads[blockedThread->priority]);
-		blockedThread->previousTCB = semaPt->blockedThreads[blockedThread->priority].previousTCB;
-		semaPt->blockedThreads[blockedThread->priority].previousTCB->nextTCB = blockedThread;
-		semaPt->blockedThreads[blockedThread->priority].previousTCB = blockedThread;
-		
-		//EndCritical(sr2);
-		// OS_Suspend needs to execute here
-		//DisableInterrupts();
+		blockRunPt(&(semaPt->blockedThreads));
 	}
 	//semaPt->Value--;
 	EndCritical(sr);
@@ -286,40 +878,54 @@ void OS_Signal(Sema4Type *semaPt){
 	semaPt->Value++;
 	
 	if(semaPt->Value <= 0){
-		// put highest priority blocked thread back into active threads and reset Systick timer
-		
-		// find the first highest priority blocked thread
-		struct TCB* unblockedThread = NULL;
-		for(int i = 0; i < PRIORITY_NUM; i++){
-			if(semaPt->blockedThreads[i].nextTCB != &(semaPt->blockedThreads[i])){
-				unblockedThread = semaPt->blockedThreads[i].nextTCB;
-				break;
-			}
-		}
-		
-		// unchained blocked thread
-		unblockedThread->nextTCB->previousTCB = unblockedThread->previousTCB;
-		unblockedThread->previousTCB->nextTCB = unblockedThread->nextTCB;
-		
-		// chain unblocked thread where it belongs
-		unblockedThread->nextTCB = &(ActiveThreads[unblockedThread->priority]);
-		unblockedThread->previousTCB = ActiveThreads[unblockedThread->priority].previousTCB;
-		ActiveThreads[unblockedThread->priority].previousTCB->nextTCB = unblockedThread;
-		ActiveThreads[unblockedThread->priority].previousTCB = unblockedThread;
-		
-		// if unblocked thread priority < RunPt priority, OS_Suspend and reset Systick timer
-		if(unblockedThread->priority < RunPt->priority){
-			// since OS_Suspend is lowest priority, should be safe to perform this operation
-			OS_Suspend();
-			// writing to NVIC_ST_CURRENT_R clears the current counter of Systick, effectively reseting the Systick counter
-			NVIC_ST_CURRENT_R = 0;
-		}
+		preemptForThread(wakeBlockedThread(&(semaPt->blockedThreads)));
 	}
 
 	EndCritical(sr);
 
 }; 
 
+// block RunPt on queue until it is woken or timeout ms run out, whichever comes first unchains it from the other
+// countedSema4 is the counting semaphore whose Value counts RunPt while it waits, NULL if there is none
+// timeout must be at least 1, must be called inside the critical section sr, which it ends
+// returns 1 if RunPt was woken, 0 if the wait timed out
+static int blockRunPtTimeout(WaitQueueType *queue, Sema4Type *countedSema4, uint32_t timeout, long sr){
+	struct TCB* waitingThread = RunPt;
+	blockRunPt(queue);
+	waitingThread->timedSema4 = countedSema4;
+	sleepQueueInsert(waitingThread, timeout);
+	// switches away here until woken
+	EndCritical(sr);
+	
+	sr = StartCritical();
+	int woken = !waitingThread->timedOut;
+	waitingThread->timedOut = false;
+	EndCritical(sr);
+	
+	return woken;
+}
+
+// ******** OS_Wait_Timeout ************
+// decrement semaphore, block if less than zero for at most timeout ms
+// input:  pointer to a counting semaphore
+//         timeout in ms, 0 never blocks
+// output: 1 if the semaphore was taken, 0 if the wait timed out
+int OS_Wait_Timeout(Sema4Type *semaPt, uint32_t timeout){
+	long sr = StartCritical();
+	if(semaPt->Value > 0){
+		semaPt->Value--;
+		EndCritical(sr);
+		return 1;
+	}
+	if(timeout == 0){
+		EndCritical(sr);
+		return 0;
+	}
+	
+	semaPt->Value--;
+	return blockRunPtTimeout(&(semaPt->blockedThreads), semaPt, timeout, sr);
+}
+
 // ******** OS_bWait ************
 // Lab2 spinlock, set to 0
 // Lab3 block if less than zero
@@ -329,27 +935,34 @@ void OS_bWait(Sema4Type *semaPt){
   // put Lab 2 (and beyond) solution here
 	long sr = StartCritical();
 	if(semaPt->Value == 0){
-		
-		struct TCB* blockedThread = RunPt;		
-		OS_Suspend();
-		// blockedThread aka cached RunPt is now the last thread of its priority
-		
-		// unchain blockedThread from ActiveThreads priority list
-		blockedThread->previousTCB->nextTCB = blockedThread->nextTCB;
-		blockedThread->nextTCB->previousTCB = blockedThread->previousTCB;
-		
-		// chain blockedThread to blocked threads for this semaphore
-		blockedThread->nextTCB = &(semaPt->blockedThreads[blockedThread->priority]);
-		blockedThread->previousTCB = semaPt->blockedThreads[blockedThread->priority].previousTCB;
-		semaPt->blockedThreads[blockedThread->priority].previousTCB->nextTCB = blockedThread;
-		semaPt->blockedThreads[blockedThread->priority].previousTCB = blockedThread;
-	
+		blockRunPt(&(semaPt->blockedThreads));
 	}
 	semaPt->Value = 0;
 	EndCritical(sr);
 
 }; 
 
+// ******** OS_bWait_Timeout ************
+// set binary semaphore to 0, block while it is 0 for at most timeout ms
+// input:  pointer to a binary semaphore
+//         timeout in ms, 0 never blocks
+// output: 1 if the semaphore was taken, 0 if the wait timed out
+int OS_bWait_Timeout(Sema4Type *semaPt, uint32_t timeout){
+	long sr = StartCritical();
+	if(semaPt->Value != 0){
+		semaPt->Value = 0;
+		EndCritical(sr);
+		return 1;
+	}
+	if(timeout == 0){
+		EndCritical(sr);
+		return 0;
+	}
+	
+	// OS_bSignal hands the semaphore over without setting Value
+	return blockRunPtTimeout(&(semaPt->blockedThreads), NULL, timeout, sr);
+}
+
 // ******** OS_bSignal ************
 // Lab2 spinlock, set to 1
 // Lab3 wakeup blocked thread if appropriate 
@@ -360,35 +973,8 @@ void OS_bSignal(Sema4Type *semaPt){
 
 	long sr = StartCritical();
 	
-	// put highest priority blocked thread back into active threads and reset Systick timer
-	
-	// find the first highest priority blocked thread
-	struct TCB* unblockedThread = NULL;
-	for(int i = 0; i < PRIORITY_NUM; i++){
-		if(semaPt->blockedThreads[i].nextTCB != &(semaPt->blockedThreads[i])){
-			unblockedThread = semaPt->blockedThreads[i].nextTCB;
-			break;
-		}
-	}
-	
-	if(unblockedThread != NULL){
-		// unchained blocked thread
-		unblockedThread->nextTCB->previousTCB = unblockedThread->previousTCB;
-		unblockedThread->previousTCB->nextTCB = unblockedThread->nextTCB;
-		
-		// chain unblocked thread where it belongs
-		unblockedThread->nextTCB = &(ActiveThreads[unblockedThread->priority]);
-		unblockedThread->previousTCB = ActiveThreads[unblockedThread->priority].previousTCB;
-		ActiveThreads[unblockedThread->priority].previousTCB->nextTCB = unblockedThread;
-		ActiveThreads[unblockedThread->priority].previousTCB = unblockedThread;
-		
-		// if unblocked thread priority > RunPt priority, OS_Suspend and reset Systick timer
-		if(unblockedThread->priority > RunPt->priority){
-			// since OS_Suspend is lowest priority, should be safe to perform this operation
-			OS_Suspend();
-			// writing to NVIC_ST_CURRENT_R clears the current counter of Systick, effectively reseting the Systick counter
-			NVIC_ST_CURRENT_R = 0;
-		}
+	if(semaPt->blockedThreads.waitingPriorities){
+		preemptForThread(wakeBlockedThread(&(semaPt->blockedThreads)));
 	}else{
 		semaPt->Value = 1;
 	}
@@ -396,76 +982,678 @@ void OS_bSignal(Sema4Type *semaPt){
 	EndCritical(sr);
 }; 
 
+// ******** OS_InitMutex ************
+// initialize a mutex as free
+// input:  pointer to a mutex
+// output: none
+void OS_InitMutex(MutexType *mutexPt){
+	mutexPt->owner = NULL;
+	mutexPt->nextHeld = NULL;
+	waitQueueInit(&(mutexPt->waiters));
+}
 
-//******** OS_AddThread *************** 
-// add a foregound thread to the scheduler
-// Inputs: pointer to a void/void foreground task
-//         number of bytes allocated for its stack
-//         priority, 0 is highest, 5 is the lowest
-// Outputs: 1 if successful, 0 if this thread can not be added
-// stack size must be divisable by 8 (aligned to double word boundary)
-// In Lab 2, you can ignore both the stackSize and priority fields
-// In Lab 3, you can ignore the stackSize fields
-int OS_AddThread(void(*task)(void), 
-   uint32_t stackSize, uint32_t priority){
-  // put Lab 2 (and beyond) solution here
-		 
+// ******** OS_MutexCreate ************
+// initialize a free mutex the kernel keeps, for a process
+// input:  none
+// output: the mutex, NULL if none is left
+MutexType* OS_MutexCreate(void){
+	long sr = StartCritical();
+	MutexType* mutexPt = poolTake(&MutexPool);
+	if(mutexPt){
+		OS_InitMutex(mutexPt);
+	}
+	EndCritical(sr);
+	return mutexPt;
+}
+
+// ******** OS_MutexValid ************
+// check a mutex handle
+// input:  mutex
+// output: 1 if OS_MutexCreate handed it out, to the calling process for a process thread, 0 otherwise
+int OS_MutexValid(MutexType *mutexPt){
+	return poolValid(&MutexPool, mutexPt);
+}
+
+// give mutexPt to newOwner
+static void mutexTake(MutexType *mutexPt, struct TCB* newOwner){
+	mutexPt->owner = newOwner;
+	mutexPt->nextHeld = newOwner->heldMutexes;
+	newOwner->heldMutexes = mutexPt;
+}
+
+// ******** OS_MutexLock ************
+// take ownership of the mutex, block if another thread owns it
+// while blocked, the owner (and any owner it is waiting on in turn)
+//   runs at least at the priority of the calling thread
+// can not be called from the background, a thread can not lock a mutex it already owns
+// input:  pointer to a mutex
+// output: none
+void OS_MutexLock(MutexType *mutexPt){
 	long sr = StartCritical();
 	
-	// Lab 5 addition
-	struct PCB* pcbEntry = RunPt->currentPCB;
-	if(PcbPt){
-		// coming from OS_AddProcess
-		pcbEntry = PcbPt;
+	if(mutexPt->owner == NULL){
+		mutexTake(mutexPt, RunPt);
+		EndCritical(sr);
+		return;
 	}
-	// if valid process trying to add a thread
-	if(pcbEntry){
-		pcbEntry->threadCount++;
+	
+	// lend RunPt's priority down the chain of owners before choosing who runs next
+	MutexType* inheritMutex = mutexPt;
+	while(inheritMutex && inheritMutex->owner->priority > RunPt->priority){
+		struct TCB* owner = inheritMutex->owner;
+		setPriority(owner, RunPt->priority);
+		inheritMutex = owner->blockedOnMutex;
 	}
 	
+	// ownership is handed over by OS_MutexUnlock
+	RunPt->blockedOnMutex = mutexPt;
+	blockRunPt(&(mutexPt->waiters));
 	
-	int addThreadIndex = 0;
-	for(; addThreadIndex < THREAD_NUM && threadPool[addThreadIndex].active == true; addThreadIndex++){
+	EndCritical(sr);
+}
+
+// hand a mutex RunPt holds to its highest priority waiter, or free it, and drop RunPt's inherited priority
+// leaves preempting to the caller, must be called with interrupts disabled
+static void mutexRelease(MutexType *mutexPt){
+	// unchain mutexPt from the mutexes RunPt holds
+	MutexType** heldPt = &(RunPt->heldMutexes);
+	while(*heldPt != mutexPt){
+		heldPt = &((*heldPt)->nextHeld);
+	}
+	*heldPt = mutexPt->nextHeld;
+	mutexPt->nextHeld = NULL;
+	
+	// hand the mutex directly to the highest priority waiter
+	if(mutexPt->waiters.waitingPriorities){
+		struct TCB* newOwner = wakeBlockedThread(&(mutexPt->waiters));
+		newOwner->blockedOnMutex = NULL;
+		mutexTake(mutexPt, newOwner);
+	}else{
+		mutexPt->owner = NULL;
 	}
 	
-	if(addThreadIndex == THREAD_NUM){
-		EndCritical(sr);
-		return 0;
+	// drop back to the base priority, or to the highest waiter of any mutex still held
+	int32_t inheritedPriority = RunPt->basePriority;
+	for(MutexType* heldMutex = RunPt->heldMutexes; heldMutex; heldMutex = heldMutex->nextHeld){
+		if(heldMutex->waiters.waitingPriorities &&
+			 HIGHEST_PRIORITY(heldMutex->waiters.waitingPriorities) < inheritedPriority){
+			inheritedPriority = HIGHEST_PRIORITY(heldMutex->waiters.waitingPriorities);
+		}
 	}
+	setPriority(RunPt, inheritedPriority);
+}
+
+// ******** OS_MutexUnlock ************
+// release the mutex to the highest priority waiter and drop any inherited priority
+// only the owner can unlock
+// input:  pointer to a mutex
+// output: none
+void OS_MutexUnlock(MutexType *mutexPt){
+	long sr = StartCritical();
 	
-	//interrupts push R0-R3, R12, PC, LR, PSR -> 8 total registers
-	threadPool[addThreadIndex].stackPt = &(stackPool[addThreadIndex][STACKSIZE-1]);
-	
-	*(threadPool[addThreadIndex].stackPt--) = (int32_t)0x01000000;	//PSR
-	*(threadPool[addThreadIndex].stackPt--) = (int32_t)task;				//PC
-	*(threadPool[addThreadIndex].stackPt--) = (int32_t)task;				//LR
-	*(threadPool[addThreadIndex].stackPt--) = (int32_t)0x12121212;	//R12
-	*(threadPool[addThreadIndex].stackPt--) = (int32_t)0x03030303;	//R3
-	*(threadPool[addThreadIndex].stackPt--) = (int32_t)0x02020202;	//R2
-	*(threadPool[addThreadIndex].stackPt--) = (int32_t)0x01010101;	//R1
-	*(threadPool[addThreadIndex].stackPt--) = (int32_t)0x00000000;	//R0
-	*(threadPool[addThreadIndex].stackPt--) = (int32_t)0x11111111;	//R11
-	*(threadPool[addThreadIndex].stackPt--) = (int32_t)0x10101010;	//R10
-	*(threadPool[addThreadIndex].stackPt--) = (int32_t)dataPt;			//R9
-	*(threadPool[addThreadIndex].stackPt--) = (int32_t)0x08080808;	//R8
-	*(threadPool[addThreadIndex].stackPt--) = (int32_t)0x07070707;	//R7
-	*(threadPool[addThreadIndex].stackPt--) = (int32_t)0x06060606;	//R6
-	*(threadPool[addThreadIndex].stackPt--) = (int32_t)0x05050505;	//R5
-	*(threadPool[addThreadIndex].stackPt) 	= (int32_t)0x04040404;	//R4
-	
-	threadPool[addThreadIndex].active = true;
-	threadPool[addThreadIndex].listHead = false;
-	threadPool[addThreadIndex].id = threadId;
-	threadPool[addThreadIndex].priority = priority;
-	threadPool[addThreadIndex].currentPCB = pcbEntry;
+	if(mutexPt->owner != RunPt){
+		EndCritical(sr);
+		return;
+	}
+	mutexRelease(mutexPt);
 	
-	threadId++;
+	// the new owner, or anything RunPt was only running ahead of because of inheritance, may now preempt
+	preemptForPriority(HIGHEST_PRIORITY(ReadyPriorities));
 	
-	// if HeadRunPt is NULL, this thread is now the head
-	/*
-	if(HeadRunPt == NULL){
-		HeadRunPt = &(threadPool[addThreadIndex]);
-		// circular linkedlist of 1
+	EndCritical(sr);
+}
+
+
+// ******** OS_EventGroupInit ************
+// initialize an event group with every flag clear
+// input:  pointer to an event group
+// output: none
+void OS_EventGroupInit(EventGroupType *groupPt){
+	groupPt->flags = 0;
+	waitQueueInit(&(groupPt->waiters));
+}
+
+// ******** OS_EventGroupCreate ************
+// initialize an event group the kernel keeps, for a process, with every flag clear
+// input:  none
+// output: the event group, NULL if none is left
+EventGroupType* OS_EventGroupCreate(void){
+	long sr = StartCritical();
+	EventGroupType* groupPt = poolTake(&EventGroupPool);
+	if(groupPt){
+		OS_EventGroupInit(groupPt);
+	}
+	EndCritical(sr);
+	return groupPt;
+}
+
+// ******** OS_EventGroupValid ************
+// check an event group handle
+// input:  event group
+// output: 1 if OS_EventGroupCreate handed it out, to the calling process for a process thread, 0 otherwise
+int OS_EventGroupValid(EventGroupType *groupPt){
+	return poolValid(&EventGroupPool, groupPt);
+}
+
+// does flags meet the condition of a thread waiting with mask and options
+static bool eventSatisfied(uint32_t flags, uint32_t mask, uint32_t options){
+	if(options&EVENT_WAITALL){
+		return (flags&mask) == mask;
+	}
+	return (flags&mask) != 0;
+}
+
+// ******** OS_EventGroupSet ************
+// set flags and wake every waiter whose condition is now met
+// input:  pointer to an event group
+//         flags to set
+// output: flags of the group after waking the waiters
+uint32_t OS_EventGroupSet(EventGroupType *groupPt, uint32_t flags){
+	long sr = StartCritical();
+	groupPt->flags |= flags;
+	
+	uint32_t clear = 0;
+	struct TCB* first = NULL;				// most urgent thread woken
+	uint32_t priorities = groupPt->waiters.waitingPriorities;
+	while(priorities){
+		int32_t priority = HIGHEST_PRIORITY(priorities);
+		priorities &= ~PRIORITY_BIT(priority);
+		// walk the waiters of this priority once, waking takes a thread out of the list
+		struct TCB* waiter = groupPt->waiters.head[priority];
+		struct TCB* last = waiter->previousTCB;
+		bool done = false;
+		while(!done){
+			struct TCB* next = waiter->nextTCB;
+			done = waiter == last;
+			if(eventSatisfied(groupPt->flags, waiter->eventMask, waiter->eventOptions)){
+				waiter->eventFlags = groupPt->flags;
+				if(waiter->eventOptions&EVENT_CLEAR){
+					clear |= waiter->eventMask;
+				}
+				wakeThread(&(groupPt->waiters), waiter);
+				if(first == NULL){
+					first = waiter;
+				}
+			}
+			waiter = next;
+		}
+	}
+	groupPt->flags &= ~clear;
+	
+	if(first){
+		preemptForThread(first);
+	}
+	flags = groupPt->flags;
+	EndCritical(sr);
+	return flags;
+}
+
+// ******** OS_EventGroupClear ************
+// clear flags, can be called from threads and ISRs
+// input:  pointer to an event group
+//         flags to clear
+// output: flags of the group before clearing
+uint32_t OS_EventGroupClear(EventGroupType *groupPt, uint32_t flags){
+	long sr = StartCritical();
+	uint32_t previous = groupPt->flags;
+	groupPt->flags &= ~flags;
+	EndCritical(sr);
+	return previous;
+}
+
+// ******** OS_EventGroupGet ************
+// read the flags without waiting
+// input:  pointer to an event group
+// output: flags of the group
+uint32_t OS_EventGroupGet(EventGroupType *groupPt){
+	return groupPt->flags;
+}
+
+// take a satisfied wait, clearing the flags for EVENT_CLEAR
+// returns the flags of the group, 0 if the condition isn't met, must be called with interrupts disabled
+static uint32_t eventGroupTake(EventGroupType *groupPt, uint32_t mask, uint32_t options){
+	if(!eventSatisfied(groupPt->flags, mask, options)){
+		return 0;
+	}
+	uint32_t flags = groupPt->flags;
+	if(options&EVENT_CLEAR){
+		groupPt->flags &= ~mask;
+	}
+	return flags;
+}
+
+// ******** OS_EventGroupWait ************
+// block until any of the flags in mask are set, or all of them with EVENT_WAITALL
+// input:  pointer to an event group
+//         flags to wait for, not 0
+//         EVENT_WAITALL, EVENT_CLEAR or both, 0 for neither
+// output: flags of the group when the wait was satisfied, 0 for a mask of 0
+uint32_t OS_EventGroupWait(EventGroupType *groupPt, uint32_t mask, uint32_t options){
+	long sr = StartCritical();
+	uint32_t flags = eventGroupTake(groupPt, mask, options);
+	if(flags || mask == 0){
+		EndCritical(sr);
+		return flags;
+	}
+	
+	// OS_EventGroupSet fills in eventFlags and clears the flags for the thread it wakes
+	struct TCB* waitingThread = RunPt;
+	waitingThread->eventMask = mask;
+	waitingThread->eventOptions = options;
+	blockRunPt(&(groupPt->waiters));
+	EndCritical(sr);
+	return waitingThread->eventFlags;
+}
+
+// ******** OS_EventGroupWait_Timeout ************
+// like OS_EventGroupWait, giving up after timeout ms
+// input:  pointer to an event group
+//         flags to wait for, not 0
+//         EVENT_WAITALL, EVENT_CLEAR or both, 0 for neither
+//         timeout in ms, 0 never blocks
+// output: flags of the group when the wait was satisfied, 0 if the wait timed out
+uint32_t OS_EventGroupWait_Timeout(EventGroupType *groupPt, uint32_t mask, uint32_t options, uint32_t timeout){
+	long sr = StartCritical();
+	uint32_t flags = eventGroupTake(groupPt, mask, options);
+	if(flags || mask == 0 || timeout == 0){
+		EndCritical(sr);
+		return flags;
+	}
+	
+	struct TCB* waitingThread = RunPt;
+	waitingThread->eventMask = mask;
+	waitingThread->eventOptions = options;
+	waitingThread->eventFlags = 0;
+	blockRunPtTimeout(&(groupPt->waiters), NULL, timeout, sr);
+	return waitingThread->eventFlags;
+}
+
+
+// carve a stack of *size bytes out of the first free block that fits
+// *size must be a multiple of 8, and is grown if the rest of the block would be too small to track
+// returns the lowest address of the stack, NULL if no block fits, must be called with interrupts disabled
+static int32_t* stackAlloc(uint32_t* size){
+	struct StackBlock** blockPt = &FreeStacks;
+	while(*blockPt && (*blockPt)->size < *size){
+		blockPt = &((*blockPt)->next);
+	}
+	if(*blockPt == NULL){
+		return NULL;
+	}
+	
+	struct StackBlock* block = *blockPt;
+	if(block->size - *size < sizeof(struct StackBlock)){
+		// hand out the whole block
+		*size = block->size;
+		*blockPt = block->next;
+		return (int32_t*)block;
+	}
+	// take the top of the block, so the free part keeps its place in the list
+	block->size -= *size;
+	return (int32_t*)((uint8_t*)block + block->size);
+}
+
+// carve a stack for a process thread out of the first free block that fits, *size is rounded up to a
+// power of 2 and the stack aligned to it, so its MPU region covers the stack and nothing else
+// returns the lowest address of the stack, NULL if no block fits, must be called with interrupts disabled
+static int32_t* stackAllocAligned(uint32_t* size){
+	uint32_t alignedSize = STACKMINSIZE;
+	while(alignedSize < *size){
+		alignedSize *= 2;
+	}
+	for(struct StackBlock** blockPt = &FreeStacks; *blockPt; blockPt = &((*blockPt)->next)){
+		struct StackBlock* block = *blockPt;
+		// the highest aligned stack in the block, like stackAlloc takes the top
+		uintptr_t end = (uintptr_t)block + block->size;
+		uintptr_t stack = (end - alignedSize) & ~(uintptr_t)(alignedSize - 1);
+		if(block->size < alignedSize || stack < (uintptr_t)block){
+			continue;
+		}
+		// the parts left over are multiples of 8, each is big enough to track
+		if(end - stack > alignedSize){
+			struct StackBlock* above = (struct StackBlock*)(stack + alignedSize);
+			above->size = end - stack - alignedSize;
+			above->next = block->next;
+			block->next = above;
+		}
+		if(stack > (uintptr_t)block){
+			block->size = stack - (uintptr_t)block;
+		}else{
+			*blockPt = block->next;
+		}
+		*size = alignedSize;
+		return (int32_t*)stack;
+	}
+	return NULL;
+}
+
+// give a stack back to the arena, merging it with the free blocks on either side
+// must be called with interrupts disabled
+static void stackFree(int32_t* stack, uint32_t size){
+	struct StackBlock* freed = (struct StackBlock*)stack;
+	struct StackBlock* previous = NULL;
+	struct StackBlock* next = FreeStacks;
+	while(next && next < freed){
+		previous = next;
+		next = next->next;
+	}
+	
+	freed->size = size;
+	freed->next = next;
+	if(next && (uint8_t*)freed + freed->size == (uint8_t*)next){
+		freed->size += next->size;
+		freed->next = next->next;
+	}
+	if(previous == NULL){
+		FreeStacks = freed;
+	}else if((uint8_t*)previous + previous->size == (uint8_t*)freed){
+		previous->size += freed->size;
+		previous->next = freed->next;
+	}else{
+		previous->next = freed;
+	}
+}
+
+// a killed thread keeps running on its stack, and PendSV still saves into its TCB,
+// until the switch away from it moves StackPt on
+static bool threadSwitchedOut(struct TCB* tcb){
+	return &(tcb->stackPt) != StackPt;
+}
+
+// return the stack of the most recently killed thread to the arena
+// returns false if there is none, or it is still running, must be called with interrupts disabled
+static bool reapThread(void){
+	struct TCB* deadThread = ReapThreads;
+	if(deadThread == NULL || !threadSwitchedOut(deadThread)){
+		return false;
+	}
+	ReapThreads = deadThread->nextReap;
+	stackFree(deadThread->stackBase, deadThread->stackSize);
+	deadThread->stackBase = NULL;
+	return true;
+}
+
+// encode the MPU region that covers size bytes at base as NVIC_MPU_BASE and NVIC_MPU_ATTR values
+// regions are a power of 2 in size and aligned to it, so this takes the smallest one that holds the range
+// and disables every eighth that is not wholly inside, it never reaches past either end
+// it covers all of a range a power of 2 in size of at least 32 bytes and aligned to it, which is how
+// Heap_MallocAligned and stackAllocAligned hand out the memory of processes, less of any other range
+// a size of 0, or a range without a whole eighth in it, encodes a disabled region
+static void mpuRegionEncode(uint32_t region, uint32_t base, uint32_t size, uint32_t encoded[2]){
+	encoded[0] = NVIC_MPU_BASE_VALID|region;
+	encoded[1] = 0;
+	if(size == 0){
+		return;
+	}
+	uint32_t last = base + size - 1;
+	uint32_t log2Size = 8;				// subregions need at least 256 bytes
+	while(log2Size < 31 && (base >> log2Size) != (last >> log2Size)){
+		log2Size++;
+	}
+	uint32_t regionBase = base & ~((1UL << log2Size) - 1);
+	uint32_t subregionSize = (1UL << log2Size)/8;
+	uint32_t disabled = 0;
+	for(uint32_t i = 0; i < 8; i++){
+		uint32_t subregion = regionBase + i*subregionSize;
+		if(subregion < base || subregion + subregionSize - 1 > last){
+			disabled |= 1UL << i;
+		}
+	}
+	if(disabled == 0xFF){
+		return;
+	}
+	encoded[0] |= regionBase;
+	encoded[1] = MPU_SRAM_ATTR|(disabled << 8)|((log2Size - 1) << 1)|NVIC_MPU_ATTR_ENABLE;
+}
+
+// called from OS_ThreadSwitched for a process thread about to run, interrupts are disabled
+// loads the regions of its process and its stack unless they are still in the MPU
+// the time it takes, less what reading the timer costs, goes into MpuStats, the cost of isolation on a context switch
+static void mpuLoad(struct TCB* tcb){
+	MpuStats.switches++;
+	if(tcb->currentPCB == MpuPCB && tcb == MpuThread){
+		return;
+	}
+	uint32_t start = OS_Time();
+	if(tcb->currentPCB != MpuPCB){
+		MpuPCB = tcb->currentPCB;
+		NVIC_MPU_BASE_R = MpuPCB->mpuText[0];
+		NVIC_MPU_ATTR_R = MpuPCB->mpuText[1];
+		NVIC_MPU_BASE_R = MpuPCB->mpuData[0];
+		NVIC_MPU_ATTR_R = MpuPCB->mpuData[1];
+	}
+	if(tcb != MpuThread){
+		MpuThread = tcb;
+		NVIC_MPU_BASE_R = tcb->mpuStack[0];
+		NVIC_MPU_ATTR_R = tcb->mpuStack[1];
+	}
+	uint32_t cycles = OS_TimeDifference(start, OS_Time());
+	cycles = cycles > MpuTimeOverhead ? cycles - MpuTimeOverhead : 0;
+	MpuStats.updates++;
+	MpuStats.cycles += cycles;
+	if(cycles > MpuStats.maxCycles){
+		MpuStats.maxCycles = cycles;
+	}
+}
+
+// bytes from address to the end of the enabled subregions of an encoded MPU region that hold it,
+// 0 if none of them does
+static uint32_t mpuRegionReach(const uint32_t encoded[2], uint32_t address){
+	if(!(encoded[1] & NVIC_MPU_ATTR_ENABLE)){
+		return 0;
+	}
+	uint32_t log2Size = ((encoded[1] >> 1) & 0x1F) + 1;
+	uint32_t regionBase = encoded[0] & ~((1UL << log2Size) - 1);
+	if(address < regionBase || address - regionBase >= (1UL << log2Size)){
+		return 0;
+	}
+	uint32_t offset = address - regionBase;
+	uint32_t subregionSize = (1UL << log2Size)/8;
+	uint32_t disabled = (encoded[1] >> 8) & 0xFF;
+	uint32_t last = offset/subregionSize;
+	if(disabled & (1UL << last)){
+		return 0;
+	}
+	while(last < 7 && !(disabled & (1UL << (last + 1)))){
+		last++;
+	}
+	return (last + 1)*subregionSize - offset;
+}
+
+// bytes from address on that a process thread can reach through one of its regions,
+// flash only counts if they are just read
+static uint32_t processReach(struct TCB* tcb, uint32_t address, bool write){
+	uint32_t reach = mpuRegionReach(tcb->mpuStack, address);
+	uint32_t segmentReach = mpuRegionReach(tcb->currentPCB->mpuText, address);
+	if(segmentReach > reach){
+		reach = segmentReach;
+	}
+	segmentReach = mpuRegionReach(tcb->currentPCB->mpuData, address);
+	if(segmentReach > reach){
+		reach = segmentReach;
+	}
+	if(!write && address < MPU_FLASH_SIZE && MPU_FLASH_SIZE - address > reach){
+		reach = MPU_FLASH_SIZE - address;
+	}
+	return reach;
+}
+
+// ******** OS_ProcessAccess ************
+// Check that the thread making a system call could reach memory itself
+// Inputs:  address, size in bytes, true if the memory is written
+// Outputs: 1 if the caller is not a process thread, or all size bytes lie in its stack,
+//          its text or data segment, or in flash for memory that is only read
+//          0 otherwise
+int OS_ProcessAccess(const void* address, uint32_t size, bool write){
+	// StackPt rather than RunPt, which already points at the next thread while a switch is pending
+	struct TCB* caller = (struct TCB*)StackPt;
+	if(caller == NULL || caller->currentPCB == NULL || size == 0){
+		return 1;
+	}
+	return size <= processReach(caller, (uint32_t)address, write);
+}
+
+// ******** OS_ProcessStringAccess ************
+// OS_ProcessAccess for a string the kernel reads up to its terminating 0
+// Inputs:  string
+// Outputs: 1 if the caller could read all of the string including the 0, 0 otherwise
+int OS_ProcessStringAccess(const char* string){
+	struct TCB* caller = (struct TCB*)StackPt;
+	if(caller == NULL || caller->currentPCB == NULL){
+		return 1;
+	}
+	uint32_t reach = processReach(caller, (uint32_t)string, false);
+	return reach > 0 && memchr(string, 0, reach) != NULL;
+}
+
+// ******** OS_ProcessCodeAccess ************
+// Check that code the kernel would start for the thread making a system call is its own
+// Inputs:  function
+// Outputs: 1 if the caller is not a process thread, or the function starts in its text segment,
+//          0 otherwise
+int OS_ProcessCodeAccess(void(*function)(void)){
+	struct TCB* caller = (struct TCB*)StackPt;
+	if(caller == NULL || caller->currentPCB == NULL){
+		return 1;
+	}
+	// bit 0 of a function pointer is the Thumb bit
+	return mpuRegionReach(caller->currentPCB->mpuText, (uint32_t)function & ~1UL) >= sizeof(uint16_t);
+}
+
+// set up tcb to run task from the top of the stack it holds, for OS_AddThread and a restart after a fault
+// its ID, stack and restart policy are left as they are, the caller makes it ready
+// must be called with interrupts disabled
+static void threadStart(struct TCB* tcb, void(*task)(void), uint32_t priority, struct PCB* pcb){
+	tcb->stackOverflowed = false;
+	// paint everything below the initial register frame
+	tcb->stackBase[0] = STACKCANARY;
+	for(uint32_t i = 1; i < tcb->stackSize/sizeof(int32_t) - 16; i++){
+		tcb->stackBase[i] = STACKPAINT;
+	}
+	
+	//interrupts push R0-R3, R12, PC, LR, PSR -> 8 total registers
+	tcb->stackPt = &(tcb->stackBase[tcb->stackSize/sizeof(int32_t) - 1]);
+	
+	*(tcb->stackPt--) = (int32_t)0x01000000;	//PSR
+	*(tcb->stackPt--) = (int32_t)task;				//PC
+	*(tcb->stackPt--) = (int32_t)task;				//LR
+	*(tcb->stackPt--) = (int32_t)0x12121212;	//R12
+	*(tcb->stackPt--) = (int32_t)0x03030303;	//R3
+	*(tcb->stackPt--) = (int32_t)0x02020202;	//R2
+	*(tcb->stackPt--) = (int32_t)0x01010101;	//R1
+	*(tcb->stackPt--) = (int32_t)0x00000000;	//R0
+	*(tcb->stackPt--) = (int32_t)0x11111111;	//R11
+	*(tcb->stackPt--) = (int32_t)0x10101010;	//R10
+	*(tcb->stackPt--) = (int32_t)(pcb ? pcb->data : dataPt);	//R9, the data segment of the process
+	*(tcb->stackPt--) = (int32_t)0x08080808;	//R8
+	*(tcb->stackPt--) = (int32_t)0x07070707;	//R7
+	*(tcb->stackPt--) = (int32_t)0x06060606;	//R6
+	*(tcb->stackPt--) = (int32_t)0x05050505;	//R5
+	*(tcb->stackPt) 	= (int32_t)0x04040404;	//R4
+	tcb->excReturn = EXC_RETURN_THREAD;
+	// process threads run unprivileged inside their MPU regions
+	tcb->control = pcb ? 1 : 0;
+	mpuRegionEncode(MPU_STACK, (uint32_t)tcb->stackBase, tcb->stackSize, tcb->mpuStack);
+	if(MpuThread == tcb){
+		MpuThread = NULL;
+	}
+	
+	tcb->active = true;
+	tcb->listHead = false;
+	tcb->priority = priority;
+	tcb->currentPCB = pcb;
+	tcb->basePriority = priority;
+	tcb->sleeping = false;
+	tcb->waitQueue = NULL;
+	tcb->timedSema4 = NULL;
+	tcb->timedOut = false;
+	tcb->blockedOnMutex = NULL;
+	tcb->heldMutexes = NULL;
+	tcb->runTime = 0;
+	tcb->switchesIn = 0;
+	tcb->preemptions = 0;
+	tcb->voluntarySwitches = 0;
+	tcb->realTime = false;
+	tcb->jobs = 0;
+	tcb->deadlineMisses = 0;
+	tcb->task = task;
+	tcb->exitCode = 0;
+#ifdef HOST_SIM
+	HostThreadInit(tcb, task);
+#endif
+}
+
+//******** OS_AddThread *************** 
+// add a foregound thread to the scheduler
+// Inputs: pointer to a void/void foreground task
+//         number of bytes allocated for its stack
+//         priority, 0 is highest, PRIORITY_NUM-1 is the lowest
+// Outputs: 1 if successful, 0 if this thread can not be added or the priority is out of range
+// stack size must be divisable by 8 (aligned to double word boundary)
+// In Lab 2, you can ignore both the stackSize and priority fields
+// In Lab 3, you can ignore the stackSize fields
+int OS_AddThread(void(*task)(void), 
+   uint32_t stackSize, uint32_t priority){
+  // put Lab 2 (and beyond) solution here
+	// a priority past the last level would index outside ActiveThreads
+	if(priority >= PRIORITY_NUM){
+		return 0;
+	}
+		 
+	long sr = StartCritical();
+	
+	// OS_Idle normally returns the stacks of killed threads, reclaim them here only if it has fallen behind
+	int addThreadIndex;
+	do{
+		addThreadIndex = 0;
+		for(; addThreadIndex < THREAD_NUM && (threadPool[addThreadIndex].active || threadPool[addThreadIndex].stackBase); addThreadIndex++){
+		}
+	}while(addThreadIndex == THREAD_NUM && reapThread());
+	
+	if(addThreadIndex == THREAD_NUM){
+		EndCritical(sr);
+		return 0;
+	}
+	
+	// Lab 5 addition
+	struct PCB* pcbEntry = RunPt ? RunPt->currentPCB : NULL;
+	if(PcbPt){
+		// coming from OS_AddProcess
+		pcbEntry = PcbPt;
+	}
+	
+	stackSize = (stackSize + 7) & ~7UL;
+	if(stackSize < STACKMINSIZE){
+		stackSize = STACKMINSIZE;
+	}
+	int32_t* stackBase;
+	while((stackBase = pcbEntry ? stackAllocAligned(&stackSize) : stackAlloc(&stackSize)) == NULL && reapThread()){
+	}
+	if(stackBase == NULL){
+		EndCritical(sr);
+		return 0;
+	}
+	threadPool[addThreadIndex].stackBase = stackBase;
+	threadPool[addThreadIndex].stackSize = stackSize;
+	
+	// if valid process trying to add a thread
+	if(pcbEntry){
+		pcbEntry->threadCount++;
+	}
+	
+	threadPool[addThreadIndex].id = threadId;
+	threadStart(&threadPool[addThreadIndex], task, priority, pcbEntry);
+	threadPool[addThreadIndex].restartLimit = 0;
+	threadPool[addThreadIndex].restartWindow = 0;
+	threadPool[addThreadIndex].restartWindowStart = Ticks;
+	threadPool[addThreadIndex].restarts = 0;
+	threadId++;
+	
+	// if HeadRunPt is NULL, this thread is now the head
+	/*
+	if(HeadRunPt == NULL){
+		HeadRunPt = &(threadPool[addThreadIndex]);
+		// circular linkedlist of 1
 		HeadRunPt->nextTCB = HeadRunPt;
 		HeadRunPt->previousTCB = HeadRunPt;
 	}else{
@@ -485,10 +1673,7 @@ int OS_AddThread(void(*task)(void),
 	ActiveThreads.previousTCB = &threadPool[addThreadIndex];
 	*/
 	
-	threadPool[addThreadIndex].nextTCB = &(ActiveThreads[priority]);
-	threadPool[addThreadIndex].previousTCB = ActiveThreads[priority].previousTCB;
-	ActiveThreads[priority].previousTCB->nextTCB = &threadPool[addThreadIndex];
-	ActiveThreads[priority].previousTCB = &(threadPool[addThreadIndex]);
+	readyListAppend(&threadPool[addThreadIndex]);
 	
 	
 	EndCritical(sr);
@@ -497,20 +1682,41 @@ int OS_AddThread(void(*task)(void),
 };
 
 
+// unchain a process without threads from the list of processes and hand it to OS_Idle,
+// which frees its segments and PCB, its kernel objects go back to the pools right away
+// must be called with interrupts disabled
 static void killProcess(struct PCB* killedPCB){
-	
-	unsigned long sr = StartCritical();
-	
-	Heap_Free(killedPCB->data);
-	Heap_Free(killedPCB->text);
-	
-	// unchain the killedPCB from list of PCBs
 	killedPCB->nextPCB->prevPCB = killedPCB->prevPCB;
 	killedPCB->prevPCB->nextPCB = killedPCB->nextPCB;
+	poolsRelease(killedPCB);
 	
-	Heap_Free(killedPCB);
+	killedPCB->nextPCB = ReapProcesses;
+	ReapProcesses = killedPCB;
+}
 
+// free the memory of one killed thread or process, the heap is only touched outside the critical section
+// the idle thread must not block, so a process waits for the next call while another thread holds HeapMutex
+// returns false if there was nothing to free
+static bool reap(void){
+	long sr = StartCritical();
+	if(reapThread()){
+		EndCritical(sr);
+		return true;
+	}
+	struct PCB* deadPCB = ReapProcesses;
+	if(deadPCB == NULL || HeapMutex.owner != NULL){
+		EndCritical(sr);
+		return false;
+	}
+	ReapProcesses = deadPCB->nextPCB;
+	mutexTake(&HeapMutex, RunPt);
 	EndCritical(sr);
+	
+	Heap_Free(deadPCB->data);
+	Heap_Free(deadPCB->text);
+	Heap_Free(deadPCB);
+	OS_MutexUnlock(&HeapMutex);
+	return true;
 }
 //******** OS_AddProcess *************** 
 // add a process with foregound thread to the scheduler
@@ -522,6 +1728,11 @@ static void killProcess(struct PCB* killedPCB){
 // Outputs: 1 if successful, 0 if this process can not be added
 // This function will be needed for Lab 5
 // In Labs 2-4, this function can be ignored
+// The threads of the process run unprivileged and reach the kernel through the system calls
+// in Syscall.h. Besides flash they can only touch their own stack and the text and data
+// segments, which have to be heap blocks so their size is known. Blocks from Heap_MallocAligned
+// are covered exactly, of a Heap_Malloc block the MPU only opens the part a region can cover
+// without reaching past it. Stacks of process threads are rounded up to a power of 2
 int OS_AddProcess(void(*entry)(void), void *text, void *data, 
   unsigned long stackSize, unsigned long priority){
   // put Lab 5 solution here
@@ -532,20 +1743,36 @@ int OS_AddProcess(void(*entry)(void), void *text, void *data,
 	// set r9 in the thread's stack to the data pointer
 	// create the thread with addThread
 		
-	unsigned long sr = StartCritical();
-		
+	// before OS_Launch there is no thread to own HeapMutex, nor one to share the heap with
+	bool heapLocked = RunPt != NULL;
+	if(heapLocked){
+		OS_MutexLock(&HeapMutex);
+	}
 	struct PCB* newPCB = Heap_Malloc(sizeof(struct PCB));
+	// a segment that isn't a heap block gets no region, the process faults if it uses it
+	int32_t textSize = Heap_Size(text);
+	int32_t dataSize = Heap_Size(data);
+	if(heapLocked){
+		OS_MutexUnlock(&HeapMutex);
+	}
 	if(!newPCB){
-		EndCritical(sr);
 		return 0;
 	}
 	newPCB->data = data;
 	newPCB->text = text;
 	newPCB->threadCount = 0;
+	mpuRegionEncode(MPU_TEXT, (uint32_t)text, textSize > 0 ? textSize : 0, newPCB->mpuText);
+	mpuRegionEncode(MPU_DATA, (uint32_t)data, dataSize > 0 ? dataSize : 0, newPCB->mpuData);
+	
+	unsigned long sr = StartCritical();
+	// the PCB may reuse the memory of one whose regions are still loaded
+	if(MpuPCB == newPCB){
+		MpuPCB = NULL;
+	}
 		
 	// add new process to the processes list
 	newPCB->nextPCB = &Processes;
-	newPCB->prevPCB = &Processes;
+	newPCB->prevPCB = Processes.prevPCB;
 	Processes.prevPCB->nextPCB = newPCB;
 	Processes.prevPCB = newPCB;
 	
@@ -563,55 +1790,500 @@ int OS_AddProcess(void(*entry)(void), void *text, void *data,
 		EndCritical(sr);
 		return 0;
 	}
-	
-  EndCritical(sr);
-  return 1; // replace this line with Lab 5 solution
+	
+  EndCritical(sr);
+  return 1; // replace this line with Lab 5 solution
+}
+
+
+//******** OS_StackStats *************** 
+// measure the stack of a thread
+// Inputs: thread ID
+//         pointer to the stats to fill in
+// Outputs: 1 if successful, 0 if there is no thread with this ID
+int OS_StackStats(uint32_t id, StackStatsType* stats){
+	long sr = StartCritical();
+	struct TCB* tcb = NULL;
+	for(int i = 0; i < THREAD_NUM; i++){
+		if(threadPool[i].active && threadPool[i].id == id){
+			tcb = &threadPool[i];
+			break;
+		}
+	}
+	if(tcb == NULL){
+		EndCritical(sr);
+		return 0;
+	}
+	
+	// the paint is never restored, so the lowest overwritten word above the canary marks the peak
+	uint32_t stackWords = tcb->stackSize/sizeof(int32_t);
+	uint32_t untouchedWords = 1;
+	while(untouchedWords < stackWords && tcb->stackBase[untouchedWords] == (int32_t)STACKPAINT){
+		untouchedWords++;
+	}
+	
+	stats->size = tcb->stackSize;
+	stats->peakUsed = (stackWords - untouchedWords)*sizeof(int32_t);
+	stats->overflowed = tcb->stackOverflowed || tcb->stackBase[0] != (int32_t)STACKCANARY;
+	EndCritical(sr);
+	
+	return 1;
+}
+
+// called by PendSV_Handler between saving the outgoing thread and loading RunPt
+// charges the time since the last switch to the outgoing thread
+// and loads the MPU regions of an incoming process thread
+void OS_ThreadSwitched(void){
+	uint64_t now = OS_Time64();
+	// stackPt is the first field of a TCB, so StackPt is also the outgoing TCB
+	struct TCB* outgoing = (struct TCB*)StackPt;
+	uint64_t elapsed = now - SwitchStamp;
+	SwitchStamp = now;
+	outgoing->runTime += elapsed;
+	TotalRunTime += elapsed;
+	
+	if(outgoing != RunPt){
+		TRACE(TRACE_SWITCH, RunPt->id, outgoing->id);
+		RunPt->switchesIn++;
+		if(SwitchPreempted && outgoing->active && outgoing->waitQueue == NULL && !outgoing->sleeping){
+			outgoing->preemptions++;
+		}else{
+			outgoing->voluntarySwitches++;
+		}
+	}
+	SwitchPreempted = false;
+	
+	// a process thread in a system call runs privileged, but its regions still have to be in place for the return
+	if(RunPt->currentPCB){
+		mpuLoad(RunPt);
+	}
+}
+
+//******** OS_ThreadStats *************** 
+// report where the CPU time of a thread went
+// Inputs: thread ID
+//         pointer to the stats to fill in
+// Outputs: 1 if successful, 0 if there is no thread with this ID
+int OS_ThreadStats(uint32_t id, ThreadStatsType* stats){
+	long sr = StartCritical();
+	struct TCB* tcb = NULL;
+	for(int i = 0; i < THREAD_NUM; i++){
+		if(threadPool[i].active && threadPool[i].id == id){
+			tcb = &threadPool[i];
+			break;
+		}
+	}
+	if(tcb == NULL){
+		EndCritical(sr);
+		return 0;
+	}
+	
+	// RunPt has not been charged for the time since it was switched in
+	uint64_t sinceSwitch = OS_Time64() - SwitchStamp;
+	uint64_t totalRunTime = TotalRunTime + sinceSwitch;
+	stats->runTime = tcb->runTime;
+	if(tcb == RunPt){
+		stats->runTime += sinceSwitch;
+	}
+	stats->switchesIn = tcb->switchesIn;
+	stats->preemptions = tcb->preemptions;
+	stats->voluntarySwitches = tcb->voluntarySwitches;
+	stats->priority = tcb->priority;
+	stats->jobs = tcb->jobs;
+	stats->deadlineMisses = tcb->deadlineMisses;
+	EndCritical(sr);
+	
+	stats->share = totalRunTime ? (stats->runTime*1000)/totalRunTime : 0;
+	return 1;
+}
+
+//******** OS_Id *************** 
+// returns the thread ID for the currently running thread
+// Inputs: none
+// Outputs: Thread ID, number greater than zero 
+uint32_t OS_Id(void){
+  // put Lab 2 (and beyond) solution here
+  return RunPt->id;
+};
+
+
+// background task released by WTIMER0A, see OS_AddPeriodicThread
+struct PeriodicTask{
+	void (*task)(void);
+	uint32_t period;						// bus cycles
+	uint32_t priority;
+	uint32_t release;						// low word of WTIMER5 at the next ideal release
+	uint32_t releases;
+	uint32_t overruns;
+	uint32_t maxJitter;					// bus cycles
+	struct PeriodicTask* next;
+};
+struct PeriodicTask periodicPool[PERIODIC_NUM];
+// tasks waiting for their release, earliest first, chained through next
+struct PeriodicTask* PeriodicQueue = NULL;
+uint32_t PeriodicPriority = 7;				// NVIC priority of WTIMER0A, the highest of the tasks
+bool PeriodicStarted = false;					// OS_Launch has set WTIMER0A to follow the queue
+
+// releases are compared by the signed difference of WTIMER5 low words,
+// ties go to the higher priority, then to the task that was queued first
+static void periodicQueueInsert(struct PeriodicTask* periodic){
+	struct PeriodicTask** link = &PeriodicQueue;
+	while(*link){
+		int32_t difference = periodic->release - (*link)->release;
+		if(difference < 0 || (difference == 0 && periodic->priority < (*link)->priority)){
+			break;
+		}
+		link = &((*link)->next);
+	}
+	periodic->next = *link;
+	*link = periodic;
+}
+
+// set the WTIMER0A one-shot to time out at the first release in the queue
+static void periodicArm(uint32_t now){
+	WTIMER0_CTL_R = 0x00000000;
+	if(PeriodicQueue == NULL){
+		return;
+	}
+	int32_t wait = PeriodicQueue->release - now;
+	WTIMER0_TAILR_R = wait > 0 ? wait : 1;
+	WTIMER0_CTL_R = 0x00000001;
+}
+
+// one-shot 32-bit down counter, reloaded for every release by periodicArm
+static void WideTimer0A_OneShotInit(uint32_t priority){
+  SYSCTL_RCGCWTIMER_R |= 0x01;  // 0) activate WTIMER0
+  while((SYSCTL_PRWTIMER_R&0x01) == 0){};
+  WTIMER0_CTL_R = 0x00000000;   // 1) disable WTIMER0A during setup
+  WTIMER0_CFG_R = 0x00000004;   // 2) configure for 32-bit mode
+  WTIMER0_TAMR_R = 0x00000001;  // 3) configure for one-shot mode, down-count
+  WTIMER0_TAPR_R = 0;           // 4) bus clock resolution
+  WTIMER0_ICR_R = 0x00000001;   // 5) clear WTIMER0A timeout flag
+  WTIMER0_IMR_R = 0x00000001;   // 6) arm timeout interrupt
+  NVIC_PRI23_R = (NVIC_PRI23_R&0xFF1FFFFF)|(priority<<21); // priority
+// vector number 110, interrupt number 94
+  NVIC_EN2_R = 1<<30;           // 7) enable IRQ 94 in NVIC
+}
+
+// called by OS_Launch, releases queued before then were relative to the launch
+static void periodicStart(void){
+	long sr = StartCritical();
+	WideTimer0A_OneShotInit(PeriodicPriority);
+	uint32_t now = WTIMER5_TAV_R;
+	for(struct PeriodicTask* periodic = PeriodicQueue; periodic; periodic = periodic->next){
+		periodic->release += now;
+	}
+	PeriodicStarted = true;
+	periodicArm(now);
+	EndCritical(sr);
+}
+
+// a release started late bus cycles after it was due
+static void periodicJitter(struct PeriodicTask* periodic, uint32_t late){
+	if(late > periodic->maxJitter){
+		periodic->maxJitter = late;
+	}
+	uint32_t jitter = late/8;		// 0.1 usec
+	if((int32_t)jitter > MaxJitter){
+		MaxJitter = jitter;
+	}
+	if(jitter >= JITTERSIZE){
+		jitter = JITTERSIZE-1;
+	}
+	JitterHistogram[jitter]++;
+}
+
+// run every task that is due, then wait for the next release
+void WideTimer0A_Handler(void){
+	// a task can make a thread ready and switch RunPt, the exit record names the interrupted thread
+	int32_t interruptedId = RunPt ? RunPt->id : TRACE_NOTHREAD;
+	TRACE(TRACE_ISR_ENTER, interruptedId, TRACE_WTIMER0A);
+	WTIMER0_ICR_R = TIMER_ICR_TATOCINT;	// acknowledge WTIMER0A timeout
+	uint32_t now = WTIMER5_TAV_R;
+	while(PeriodicQueue && (int32_t)(now - PeriodicQueue->release) >= 0){
+		struct PeriodicTask* periodic = PeriodicQueue;
+		PeriodicQueue = periodic->next;
+		periodicJitter(periodic, now - periodic->release);
+		periodic->releases++;
+		periodic->task();
+		
+		// the next release follows the ideal one, so late starts don't add up to drift,
+		// but a task a whole period behind drops releases instead of running back to back
+		periodic->release += periodic->period;
+		now = WTIMER5_TAV_R;
+		while((int32_t)(now - periodic->release) >= (int32_t)periodic->period){
+			periodic->release += periodic->period;
+			periodic->overruns++;
+		}
+		periodicQueueInsert(periodic);
+	}
+	periodicArm(now);
+	TRACE(TRACE_ISR_EXIT, interruptedId, TRACE_WTIMER0A);
+}
+
+//******** OS_AddPeriodicThread *************** 
+// add a background periodic task
+// typically this function receives the highest priority
+// Inputs: pointer to a void/void background function
+//         period given in system time units (12.5ns)
+//         priority 0 is the highest, 5 is the lowest
+// Outputs: 1 if successful, 0 if this thread can not be added
+// You are free to select the time resolution for this function
+// It is assumed that the user task will run to completion and return
+// This task can not spin, block, loop, sleep, or kill
+// This task can call OS_Signal  OS_bSignal   OS_AddThread
+// This task does not have a Thread ID
+// Up to PERIODIC_NUM tasks share WTIMER0A, which is set to time out at the next release
+// Tasks released at the same time run in priority order, the WTIMER0A interrupt
+// takes the highest priority of all the periodic tasks
+// The period must be less than 2^31 bus cycles, about 26 s
+int OS_AddPeriodicThread(void(*task)(void), 
+   uint32_t period, uint32_t priority){
+	if(period == 0 || period > 0x7FFFFFFF || priority > 7){
+		return 0;
+	}
+	long sr = StartCritical();
+	if(periodicThreadCount >= PERIODIC_NUM){
+		EndCritical(sr);
+		return 0;
+	}
+	struct PeriodicTask* periodic = &periodicPool[periodicThreadCount];
+	periodicThreadCount++;
+	periodic->task = task;
+	periodic->period = period;
+	periodic->priority = priority;
+	periodic->releases = 0;
+	periodic->overruns = 0;
+	periodic->maxJitter = 0;
+	
+	uint32_t now = PeriodicStarted ? WTIMER5_TAV_R : 0;
+	periodic->release = now + period;
+	periodicQueueInsert(periodic);
+	if(priority < PeriodicPriority){
+		PeriodicPriority = priority;
+		NVIC_PRI23_R = (NVIC_PRI23_R&0xFF1FFFFF)|(priority<<21);
+	}
+	if(PeriodicStarted){
+		periodicArm(now);
+	}
+	EndCritical(sr);
+	return 1;
+};
+
+//******** OS_PeriodicStats *************** 
+// report the release timing of a periodic task
+// Inputs: index of the task, 0 for the first one added with OS_AddPeriodicThread
+//         pointer to the stats to fill in
+// Outputs: 1 if successful, 0 if there is no task with this index
+int OS_PeriodicStats(uint32_t index, PeriodicStatsType* stats){
+	long sr = StartCritical();
+	if(index >= periodicThreadCount){
+		EndCritical(sr);
+		return 0;
+	}
+	struct PeriodicTask* periodic = &periodicPool[index];
+	stats->period = periodic->period;
+	stats->priority = periodic->priority;
+	stats->releases = periodic->releases;
+	stats->overruns = periodic->overruns;
+	stats->maxJitter = periodic->maxJitter;
+	EndCritical(sr);
+	return 1;
+}
+
+//******** OS_SchedulingMode *************** 
+// select how real-time threads are admitted and ordered
+// Inputs: SCHED_PRIORITY, SCHED_DM or SCHED_EDF
+// Outputs: 1 if successful, 0 if real-time threads have already been added
+// Threads added with OS_AddThread keep their fixed priority in every mode
+int OS_SchedulingMode(uint32_t mode){
+	if(mode > SCHED_EDF){
+		return 0;
+	}
+	long sr = StartCritical();
+	// the ready list is ordered for the current mode
+	if(RealTimeCount){
+		EndCritical(sr);
+		return 0;
+	}
+	SchedulingMode = mode;
+	EndCritical(sr);
+	return 1;
+}
+
+// the TCB of the thread OS_AddThread added last, must be called with interrupts disabled
+static struct TCB* threadNewest(void){
+	for(int i = 0; i < THREAD_NUM; i++){
+		if(threadPool[i].active && threadPool[i].id == threadId - 1){
+			return &threadPool[i];
+		}
+	}
+	return NULL;
+}
+
+// does one more real-time thread whose wcet/deadline in parts per million is density pass the admission test
+// must be called with interrupts disabled
+static bool realTimeAdmitted(uint32_t density){
+	uint32_t bound = 1000000;
+	if(SchedulingMode == SCHED_DM){
+		bound = RealTimeCount < 8 ? DMBound[RealTimeCount] : DMBOUND_LIMIT;
+	}
+	return RealTimeDensity + density <= bound;
+}
+
+// turn a ready thread at REALTIME_PRIORITY into a real-time one with its first job released now
+// must be called with interrupts disabled
+static void realTimeStart(struct TCB* tcb, uint32_t period, uint32_t deadline, uint32_t density){
+	// it was queued as an ordinary thread, requeue it by its deadline
+	readyListRemove(tcb);
+	tcb->realTime = true;
+	tcb->period = period;
+	tcb->deadline = deadline;
+	tcb->density = density;
+	tcb->release = Ticks;
+	tcb->absoluteDeadline = Ticks + deadline;
+	readyListAppend(tcb);
+	RealTimeCount++;
+	RealTimeDensity += density;
+}
+
+// admit and add a real-time thread whose wcet/deadline in parts per million is density
+// returns its TCB, NULL if it fails the admission test or can not be added, must be called with interrupts disabled
+static struct TCB* addRealTimeThread(void(*task)(void), uint32_t stackSize,
+   uint32_t period, uint32_t deadline, uint32_t density){
+	if(!realTimeAdmitted(density) || !OS_AddThread(task, stackSize, REALTIME_PRIORITY)){
+		return NULL;
+	}
+	struct TCB* tcb = threadNewest();
+	realTimeStart(tcb, period, deadline, density);
+	return tcb;
+}
+
+//******** OS_AddRealTimeThread *************** 
+// add a foreground thread that runs one job per period at REALTIME_PRIORITY
+// Inputs: pointer to a void/void foreground task
+//         number of bytes allocated for its stack
+//         period in ms
+//         worst case execution time of one job in 12.5ns units, OS_ThreadStats helps measure it
+//         deadline in ms after each release, no longer than the period
+// Outputs: 1 if successful, 0 if the thread can not be added or would fail the admission test
+// The first job is released right away, the task ends each job with OS_NextPeriod
+// SCHED_DM admits while the sum of wcet/deadline stays under n(2^(1/n)-1) for n threads,
+// SCHED_EDF while it stays at or under 1
+int OS_AddRealTimeThread(void(*task)(void), uint32_t stackSize,
+   uint32_t period, uint32_t wcet, uint32_t deadline){
+	if(SchedulingMode == SCHED_PRIORITY || period == 0 || deadline == 0 || deadline > period || wcet == 0){
+		return 0;
+	}
+	// rounded up, so the sum never slips under the bound
+	uint64_t deadlineCycles = (uint64_t)deadline*TIME_1MS;
+	uint64_t density = ((uint64_t)wcet*1000000 + deadlineCycles - 1)/deadlineCycles;
+	
+	long sr = StartCritical();
+	int added = addRealTimeThread(task, stackSize, period, deadline, density) != NULL;
+	EndCritical(sr);
+	return added;
+}
+
+//******** OS_NextPeriod *************** 
+// finish the current job of a real-time thread and sleep until the next release
+// Inputs: none
+// Outputs: none
+// A job finishing at or after its deadline counts as a miss, a job more than a period
+// late skips the releases it missed and counts each of them as a miss too
+// Does nothing in a thread that is not real-time
+void OS_NextPeriod(void){
+	long sr = StartCritical();
+	struct TCB* job = RunPt;
+	if(!job->realTime){
+		EndCritical(sr);
+		return;
+	}
+	job->jobs++;
+	if((int32_t)(Ticks - job->absoluteDeadline) >= 0){
+		job->deadlineMisses++;
+	}
+	
+	// releases stay on the period grid, however late the job finished
+	job->release += job->period;
+	while((int32_t)(Ticks - job->release) >= (int32_t)job->period){
+		job->release += job->period;
+		job->deadlineMisses++;
+	}
+	job->absoluteDeadline = job->release + job->deadline;
+	
+	int32_t wait = job->release - Ticks;
+	if(wait > 0){
+		TRACE(TRACE_SLEEP, job->id, wait);
+		OS_Suspend();
+		readyListRemove(job);
+		sleepQueueInsert(job, wait);
+	}else{
+		// the next job is already released, it only gives way to a more urgent one
+		readyListRemove(job);
+		readyListAppend(job);
+		if(ActiveThreads[job->priority].nextTCB != job){
+			OS_Suspend();
+		}
+	}
+	EndCritical(sr);
 }
 
 
-//******** OS_Id *************** 
-// returns the thread ID for the currently running thread
-// Inputs: none
-// Outputs: Thread ID, number greater than zero 
-uint32_t OS_Id(void){
-  // put Lab 2 (and beyond) solution here
-  return RunPt->id;
-};
+//******** OS_SoftTimerInit *************** 
+// set up a stopped software timer
+// Inputs: pointer to the timer
+//         function to call when the timer expires
+//         argument handed to the function
+// Outputs: none
+void OS_SoftTimerInit(SoftTimerType* timer, void (*callback)(void*), void* arg){
+	timer->callback = callback;
+	timer->arg = arg;
+	timer->expiry = 0;
+	timer->period = 0;
+	timer->next = NULL;
+	timer->previous = NULL;
+}
 
+//******** OS_SoftTimerStart *************** 
+// start a software timer, or restart it if it is already running
+// Inputs: pointer to the timer
+//         ms until it first expires, at least 1
+//         ms between later expiries, 0 for a one-shot timer
+// Outputs: none
+void OS_SoftTimerStart(SoftTimerType* timer, uint32_t delay, uint32_t period){
+	long sr = StartCritical();
+	if(timer->next){
+		timerWheelRemove(timer);
+	}
+	if(delay == 0){
+		delay = 1;
+	}
+	timer->expiry = Ticks + delay;
+	timer->period = period;
+	timerWheelInsert(timer);
+	EndCritical(sr);
+}
 
-//******** OS_AddPeriodicThread *************** 
-// add a background periodic task
-// typically this function receives the highest priority
-// Inputs: pointer to a void/void background function
-//         period given in system time units (12.5ns)
-//         priority 0 is the highest, 5 is the lowest
-// Outputs: 1 if successful, 0 if this thread can not be added
-// You are free to select the time resolution for this function
-// It is assumed that the user task will run to completion and return
-// This task can not spin, block, loop, sleep, or kill
-// This task can call OS_Signal  OS_bSignal   OS_AddThread
-// This task does not have a Thread ID
-// In lab 1, this command will be called 1 time
-// In lab 2, this command will be called 0 or 1 times
-// In lab 2, the priority field can be ignored
-// In lab 3, this command will be called 0 1 or 2 times
-// In lab 3, there will be up to four background threads, and this priority field 
-//           determines the relative priority of these four threads
-int OS_AddPeriodicThread(void(*task)(void), 
-   uint32_t period, uint32_t priority){
-  // put Lab 2 (and beyond) solution here
-	periodicThreadCount++;
-	switch(periodicThreadCount){
-	 case 1:
-		WideTimer0A_Init(task, period, priority);
-		break;
-	 case 2:
-		WideTimer1A_Init(task, period, priority);
-		break;
+//******** OS_SoftTimerStop *************** 
+// stop a software timer, its callback won't be called until it is started again
+// Inputs: pointer to the timer
+// Outputs: none
+void OS_SoftTimerStop(SoftTimerType* timer){
+	long sr = StartCritical();
+	if(timer->next){
+		timerWheelRemove(timer);
 	}
-	
-  return 0; // replace this line with solution
-};
+	EndCritical(sr);
+}
+
+//******** OS_SoftTimerActive *************** 
+// check whether a software timer is running
+// Inputs: pointer to the timer
+// Outputs: true until a one-shot timer expires or the timer is stopped
+bool OS_SoftTimerActive(SoftTimerType* timer){
+	return timer->next != NULL;
+}
 
 
 /*----------------------------------------------------------------------------
@@ -621,44 +2293,46 @@ int OS_AddPeriodicThread(void(*task)(void),
 void (*AddSW1Task)(void);
 void (*AddSW2Task)(void);
 
-static void GPIOPortF_4DebounceTask(){
-	OS_Sleep(20);
-	GPIO_PORTF_ICR_R = 0x10;	// clear the PF4 interrupt flag
-	GPIO_PORTF_IM_R |= 0x10;	// rearm PF4 interrupts
-	OS_Kill();
-}
+#define DEBOUNCETIME	20		// ms a switch stays disarmed after a press
 
-static void GPIOPortF_0DebounceTask(){
-	OS_Sleep(20);
-	GPIO_PORTF_ICR_R = 0x01;	// clear the PF0 interrupt flag
-	GPIO_PORTF_IM_R |= 0x01;	// rearm PF0 interrupts
-	OS_Kill();
+SoftTimerType SW1Debounce;
+SoftTimerType SW2Debounce;
+
+// timer callback, arg is the Port F pin to clear and rearm
+static void GPIOPortF_Rearm(void* arg){
+	uint32_t pin = (uint32_t)arg;
+	GPIO_PORTF_ICR_R = pin;		// clear the interrupt flag
+	GPIO_PORTF_IM_R |= pin;		// rearm interrupts
 }
 
 void GPIOPortF_Handler(void){
 	
 	// disable Port F interrupts
 	// clear interrupt flag
-	// start new thread that sleeps and will reenable Port F interrupts
+	// start a one-shot timer that will reenable Port F interrupts
 	
 	// NOTE: PF4 -> SW1
 	// NOTE: PF0 -> SW2
 	
+	// the button tasks can switch RunPt, the exit record names the interrupted thread
+	int32_t interruptedId = RunPt->id;
+	TRACE(TRACE_ISR_ENTER, interruptedId, TRACE_GPIOF);
 	// is it possible for RIS to change servicing interrupt and when interrupt occured?
 	// PF4
 	if(GPIO_PORTF_RIS_R&0x10){
 		GPIO_PORTF_ICR_R = 0x10;												// clear the PF4 interrupt flag
 		GPIO_PORTF_IM_R &= ~0x10;												// disarm PF4 interrupts
-		int retVal = OS_AddThread(&GPIOPortF_4DebounceTask, 128, 0);
+		OS_SoftTimerStart(&SW1Debounce, DEBOUNCETIME, 0);
 		AddSW1Task();
 	}
 	// PF0
 	if(GPIO_PORTF_RIS_R&0x01){
 		GPIO_PORTF_ICR_R = 0x01;;												// clear the PF0 interrupt flag
 		GPIO_PORTF_IM_R &= ~0x01;												// disarm PF0 interrupts
-		int retVal = OS_AddThread(&GPIOPortF_0DebounceTask, 128, 0);
+		OS_SoftTimerStart(&SW2Debounce, DEBOUNCETIME, 0);
 		AddSW2Task();
 	}
+	TRACE(TRACE_ISR_EXIT, interruptedId, TRACE_GPIOF);
 }
 
 //******** OS_AddSW1Task *************** 
@@ -678,6 +2352,7 @@ int OS_AddSW1Task(void(*task)(void), uint32_t priority){
   // put Lab 2 (and beyond) solution here
 	
 	AddSW1Task = task;
+	OS_SoftTimerInit(&SW1Debounce, &GPIOPortF_Rearm, (void*)0x10);
 	SYSCTL_RCGCGPIO_R |= 0x00000020;													// activate clock for port F
 	GPIO_PORTF_LOCK_R = 0x4C4F434B;														// unlock GPIO Port F						
 	GPIO_PORTF_CR_R = 0x1F;																		// allow changes to PF4-0
@@ -730,6 +2405,7 @@ int OS_AddSW2Task(void(*task)(void), uint32_t priority){
   // put Lab 2 (and beyond) solution here
 	
 	AddSW2Task = task;
+	OS_SoftTimerInit(&SW2Debounce, &GPIOPortF_Rearm, (void*)0x01);
 	SYSCTL_RCGCGPIO_R |= 0x00000020;													// activate clock for port F
 	GPIO_PORTF_LOCK_R = 0x4C4F434B;														// unlock GPIO Port F						
 	GPIO_PORTF_CR_R = 0x1F;																		// allow changes to PF4-0
@@ -758,127 +2434,697 @@ int OS_AddSW2Task(void(*task)(void), uint32_t priority){
 void OS_Sleep(uint32_t sleepTime){
   // put Lab 2 (and beyond) solution here
 	
+	if(sleepTime == 0){
+		OS_Suspend();
+		return;
+	}
+	
 	// shouldn't be allowed to context switch when in here
 	long sr = StartCritical();
 	
-	RunPt->sleepTime = sleepTime;
 	/*
 	
 	// unchaining RunPt from active threads
 	RunPt->previousTCB->nextTCB = RunPt->nextTCB;
 	RunPt->nextTCB->previousTCB = RunPt->previousTCB;
 	
-	struct TCB* nextRunPt = RunPt->nextTCB;
-	if(nextRunPt->listHead){
-		nextRunPt = nextRunPt->nextTCB;
+	struct TCB* nextRunPt = RunPt->nextTCB;
+	if(nextRunPt->listHead){
+		nextRunPt = nextRunPt->nextTCB;
+	}
+	
+	// chain RunPt to sleeping threads
+	RunPt->previousTCB = SleepingThreads.previousTCB;
+	RunPt->nextTCB = &(SleepingThreads);
+	SleepingThreads.previousTCB->nextTCB = RunPt;
+	SleepingThreads.previousTCB = RunPt;
+	
+	// set RunPt to next valid active thread
+	RunPt = nextRunPt;
+	*/
+	
+	struct TCB* sleepingThread = RunPt;
+	TRACE(TRACE_SLEEP, sleepingThread->id, sleepTime);
+	// OS_Suspend will LSL TCB list and update RunPt with next valid thread
+	OS_Suspend();
+	
+	// remove sleepingThread from its list and append to SleepingThreads list
+	
+	// unchaining sleepingThread from active threads
+	readyListRemove(sleepingThread);
+	sleepQueueInsert(sleepingThread, sleepTime);
+	
+	EndCritical(sr);
+	//OS_Suspend();
+};  
+
+// wake the threads waiting in OS_Join for tcb, handing them its exit code
+// leaves preempting to the caller, must be called with interrupts disabled
+static void joinersWake(struct TCB* tcb){
+	uint32_t priorities = Joiners.waitingPriorities;
+	while(priorities){
+		int32_t priority = HIGHEST_PRIORITY(priorities);
+		priorities &= ~PRIORITY_BIT(priority);
+		// walk the waiters of this priority once, waking takes a thread out of the list
+		struct TCB* waiter = Joiners.head[priority];
+		struct TCB* last = waiter->previousTCB;
+		bool done = false;
+		while(!done){
+			struct TCB* next = waiter->nextTCB;
+			done = waiter == last;
+			if(waiter->joinId == tcb->id){
+				waiter->joinCode = tcb->exitCode;
+				wakeThread(&Joiners, waiter);
+			}
+			waiter = next;
+		}
+	}
+}
+
+// does the restart policy of a thread that ended on a fault allow another restart in this window
+// must be called with interrupts disabled
+static bool threadRestartAllowed(struct TCB* tcb){
+	if(tcb->restartLimit == 0){
+		return false;
+	}
+	if(Ticks - tcb->restartWindowStart >= tcb->restartWindow){
+		tcb->restartWindowStart = Ticks;
+		tcb->restarts = 0;
+	}
+	return tcb->restarts < tcb->restartLimit;
+}
+
+// hand the TCB and stack of an ended thread to OS_Idle, and end its process if it was the last thread
+// must be called with interrupts disabled
+static void threadRetire(struct TCB* tcb){
+	// mark as inactive, OS_Idle returns the stack once the switch away from it is done
+	tcb->active = false;
+	tcb->nextReap = ReapThreads;
+	ReapThreads = tcb;
+	
+	// Lab 5 addition for processes, threads added outside a process have no PCB
+	if(tcb->currentPCB){
+		tcb->currentPCB->threadCount--;
+		if(tcb->currentPCB->threadCount == 0){
+			killProcess(tcb->currentPCB);
+		}
+	}
+	// reset the PCB pointer
+	tcb->currentPCB = NULL;
+}
+
+// start a thread that ended on a fault over on its own stack, keeping its TCB, ID and restart policy
+// the timer daemon calls this once the thread has been switched out, it ran on that stack until then
+// returns false if a real-time thread no longer passes the admission test, must be called with interrupts disabled
+static bool threadRestart(struct TCB* tcb){
+	if(tcb->restartRealTime && !realTimeAdmitted(tcb->density)){
+		return false;
+	}
+	threadStart(tcb, tcb->task, tcb->basePriority, tcb->currentPCB);
+	tcb->restarts++;
+	readyListAppend(tcb);
+	if(tcb->restartRealTime){
+		realTimeStart(tcb, tcb->period, tcb->deadline, tcb->density);
+	}
+	return true;
+}
+
+// start over the threads OS_Exit left on RestartThreads, a thread that can not be restarted
+// ends for good with a FAULT_RESTARTFAILED record, must be called with interrupts disabled
+static void threadsRestart(void){
+	while(RestartThreads){
+		struct TCB* tcb = RestartThreads;
+		RestartThreads = tcb->nextReap;
+		if(!threadRestart(tcb)){
+			FaultRecordType* record = &FaultRecords[FaultCount%FAULTRECORD_NUM];
+			memset(record, 0, sizeof(*record));
+			record->time = OS_MsTime();
+			record->id = tcb->id;
+			record->exception = FAULT_RESTARTFAILED;
+			FaultCount++;
+			joinersWake(tcb);
+			threadRetire(tcb);
+		}
+	}
+}
+
+// ******** OS_Exit ************
+// end the currently running thread with an exit code, release its TCB and stack
+// mutexes it still holds are handed on, threads in OS_Join for it are woken with the exit code
+// the stack, and the segments of a process whose last thread this is, are freed later by OS_Idle
+// input:  exit code, FAULT_EXITCODE restarts the thread if its restart policy allows
+// output: none
+void OS_Exit(int32_t exitCode){
+	DisableInterrupts();
+	
+	struct TCB* exitThread = RunPt;
+	exitThread->exitCode = exitCode;
+	TRACE(TRACE_KILL, exitThread->id, 0);
+	
+	// nobody could unlock them after this
+	while(exitThread->heldMutexes){
+		mutexRelease(exitThread->heldMutexes);
+	}
+	
+	// give back the utilization first, a restart is admitted again
+	bool realTime = exitThread->realTime;
+	if(realTime){
+		exitThread->realTime = false;
+		RealTimeCount--;
+		RealTimeDensity -= exitThread->density;
+	}
+	
+	bool restart = exitCode == FAULT_EXITCODE && threadRestartAllowed(exitThread);
+	if(!restart){
+		joinersWake(exitThread);
+	}
+	
+	// OS_Suspend will LSL TCB list and update RunPt with next valid thread
+	OS_Suspend();
+	
+	// unchaining exitThread from active threads
+	readyListRemove(exitThread);
+	
+	if(restart){
+		// it still runs on its stack, the timer daemon starts it over there once it is switched out
+		// it stays active meanwhile, so OS_Join keeps waiting
+		exitThread->restartRealTime = realTime;
+		exitThread->nextReap = RestartThreads;
+		RestartThreads = exitThread;
+		OS_bSignal(&TimerDaemonReady);
+	}else{
+		threadRetire(exitThread);
+	}
+
+  EnableInterrupts();   // end of atomic section 
+}
+
+// ******** OS_Kill ************
+// kill the currently running thread, release its TCB and stack
+// same as OS_Exit(0)
+// input:  none
+// output: none
+void OS_Kill(void){
+	OS_Exit(0);
+}
+
+// the fault handlers in osasm.s call this first with the frame stacked on exception entry,
+// the exception number and EXC_RETURN, in handler mode
+void OS_FaultCapture(uint32_t* frame, uint32_t exception, uint32_t excReturn){
+	FaultRecordType* record = &FaultRecords[FaultCount%FAULTRECORD_NUM];
+	// stackPt is the first field of a TCB, StackPt is the thread that was running
+	struct TCB* thread = (excReturn & 0x08) ? (struct TCB*)StackPt : NULL;
+	record->time = OS_MsTime();
+	record->id = thread ? thread->id : -1;
+	record->exception = exception & 0x1FF;
+	record->cfsr = NVIC_FAULT_STAT_R;
+	record->hfsr = NVIC_HFAULT_STAT_R;
+	if(record->cfsr & NVIC_FAULT_STAT_MMARV){
+		record->address = NVIC_MM_ADDR_R;
+	}else if(record->cfsr & NVIC_FAULT_STAT_BFARV){
+		record->address = NVIC_FAULT_ADDR_R;
+	}else{
+		record->address = 0;
+	}
+	for(int i = 0; i < 8; i++){
+		record->registers[i] = frame[i];
+	}
+	FaultCount++;
+	
+	// the fault status bits are sticky, clear them for the next fault
+	NVIC_FAULT_STAT_R = record->cfsr;
+	NVIC_HFAULT_STAT_R = record->hfsr;
+}
+
+// the fault handlers in osasm.s return into this in place of a thread that faulted
+void OS_ThreadFaulted(void){
+	OS_Exit(FAULT_EXITCODE);
+}
+
+//******** OS_FaultRecord *************** 
+// read back one of the last FAULTRECORD_NUM faults
+// Inputs: 0 for the newest fault, 1 for the one before, ...
+//         pointer to the record to fill in
+// Outputs: 1 if successful, 0 if there is no such fault
+int OS_FaultRecord(uint32_t index, FaultRecordType* record){
+	long sr = StartCritical();
+	if(index >= FaultCount || index >= FAULTRECORD_NUM){
+		EndCritical(sr);
+		return 0;
+	}
+	*record = FaultRecords[(FaultCount - 1 - index)%FAULTRECORD_NUM];
+	EndCritical(sr);
+	return 1;
+}
+
+//******** OS_MpuStats *************** 
+// report what loading the MPU regions of process threads has cost the context switches
+// Inputs: pointer to the stats to fill in
+// Outputs: none
+void OS_MpuStats(MpuStatsType* stats){
+	long sr = StartCritical();
+	*stats = MpuStats;
+	EndCritical(sr);
+}
+
+//******** OS_Join *************** 
+// wait for a thread to end
+// Inputs: thread ID
+//         where to put the exit code of the thread, NULL if it is not needed
+// Outputs: 1 if successful, 0 if there is no thread with this ID or it is the calling thread
+// A thread restarted after a fault has not ended, OS_Join goes on waiting for the restarted thread
+// Once the TCB of an ended thread has been reused, its ID is no longer found
+int OS_Join(uint32_t id, int32_t *exitCode){
+	long sr = StartCritical();
+	struct TCB* tcb = NULL;
+	for(int i = 0; i < THREAD_NUM; i++){
+		if(threadPool[i].id == (int32_t)id){
+			tcb = &threadPool[i];
+			break;
+		}
+	}
+	if(tcb == NULL || tcb == RunPt){
+		EndCritical(sr);
+		return 0;
+	}
+	
+	int32_t code = tcb->exitCode;
+	if(tcb->active){
+		// OS_Exit fills in joinCode for the thread it wakes
+		struct TCB* joiningThread = RunPt;
+		joiningThread->joinId = id;
+		blockRunPt(&Joiners);
+		EndCritical(sr);
+		code = joiningThread->joinCode;
+	}else{
+		EndCritical(sr);
+	}
+	if(exitCode){
+		*exitCode = code;
+	}
+	return 1;
+}
+
+//******** OS_SetRestartPolicy *************** 
+// have a thread started over when it ends on a fault
+// Inputs: thread ID
+//         restarts allowed within one window, 0 turns restarting off
+//         window in ms
+// Outputs: 1 if successful, 0 if there is no running thread with this ID
+// The timer daemon restarts the thread on its own stack once it has been switched out, running
+// its task from the top and keeping its ID, priority, real-time parameters and restart policy.
+// Once limit restarts have happened within one window the next fault ends the thread for good,
+// and OS_Join returns FAULT_EXITCODE. So does a real-time thread that no longer passes the
+// admission test, which also leaves a FAULT_RESTARTFAILED record for OS_FaultRecord.
+// The restarts counted so far are kept, so a thread can set its own policy each time it starts
+int OS_SetRestartPolicy(uint32_t id, uint32_t limit, uint32_t window){
+	long sr = StartCritical();
+	for(int i = 0; i < THREAD_NUM; i++){
+		if(threadPool[i].active && threadPool[i].id == (int32_t)id){
+			threadPool[i].restartLimit = limit;
+			threadPool[i].restartWindow = window;
+			EndCritical(sr);
+			return 1;
+		}
+	}
+	EndCritical(sr);
+	return 0;
+}
+
+// ******** OS_Suspend ************
+// suspend execution of currently running thread
+// scheduler will choose another thread to execute
+// Can be used to implement cooperative multitasking 
+// Same function as OS_Sleep(0)
+// input:  none
+// output: none
+void OS_Suspend(void){
+  // put Lab 2 (and beyond) solution here
+	
+	long sr = StartCritical();
+	/*
+	RunPt = RunPt->nextTCB;
+	if(RunPt->listHead){
+		RunPt = RunPt->nextTCB;
+	}
+	*/
+	scheduler();
+	
+	INTCTRL = 0x10000000;
+	// reset systick timer here:
+	NVIC_ST_CURRENT_R = 0;
+	
+	EndCritical(sr);
+	
+	//INTCTRL = 0x10000000;
+
+};
+  
+// increment semaphore count times, waking as many blocked threads as the count covers
+// preempts once for the highest priority woken thread
+static void signalCount(Sema4Type *semaPt, uint32_t count){
+	long sr = StartCritical();
+	int32_t wokenPriority = PRIORITY_NUM;
+	
+	while(count--){
+		semaPt->Value++;
+		if(semaPt->Value <= 0){
+			struct TCB* wokenThread = wakeBlockedThread(&(semaPt->blockedThreads));
+			if(wokenThread->priority < wokenPriority){
+				wokenPriority = wokenThread->priority;
+			}
+		}
+	}
+	preemptForPriority(wokenPriority);
+	
+	EndCritical(sr);
+}
+
+// copy count elements, word sized elements skip memcpy
+static void fifoCopy(void* dest, const void* src, uint32_t count, uint32_t elemSize){
+	if(count == 1 && elemSize == sizeof(uint32_t)){
+		*(uint32_t*)dest = *(const uint32_t*)src;
+	}else{
+		memcpy(dest, src, count*elemSize);
+	}
+}
+
+static void fifoInit(FifoType* fifo, void* buffer, uint32_t size, uint32_t elemSize){
+	fifo->buffer = buffer;
+	fifo->mask = size - 1;
+	fifo->elemSize = elemSize;
+	fifo->putIndex = 0;
+	fifo->getIndex = 0;
+	OS_InitSemaphore(&(fifo->dataAvailable), 0);			// data is not initially available
+}
+
+// ******** OS_FifoCreate ************
+// Create a FIFO on top of a caller supplied buffer
+// Inputs:  buffer of size*elemSize bytes, word aligned when elemSize is 4
+//          size, number of elements, must be a power of 2
+//          elemSize, number of bytes in each element
+// Outputs: the new FIFO, NULL if size is not a power of 2 or no FIFO is left
+FifoType* OS_FifoCreate(void* buffer, uint32_t size, uint32_t elemSize){
+	if(buffer == NULL || size == 0 || (size & (size-1)) || elemSize == 0){
+		return NULL;
+	}
+	
+	long sr = StartCritical();
+	FifoType* fifo = NULL;
+	for(int i = 0; i < FIFO_NUM; i++){
+		if(fifoPool[i].buffer == NULL){
+			fifo = &(fifoPool[i]);
+			fifoInit(fifo, buffer, size, elemSize);
+			break;
+		}
+	}
+	EndCritical(sr);
+	
+	return fifo;
+}
+
+// ******** OS_FifoValid ************
+// Check a FIFO handle
+// Inputs:  FIFO
+// Outputs: 1 if it is a FIFO OS_FifoCreate handed out, 0 otherwise
+int OS_FifoValid(FifoType* fifo){
+	for(int i = 0; i < FIFO_NUM; i++){
+		if(fifo == &(fifoPool[i])){
+			return fifo->buffer != NULL;
+		}
+	}
+	return 0;
+}
+
+// ******** OS_FifoPut ************
+// Enter one element into the FIFO
+// Can be called from the background, so no waiting
+// Inputs:  FIFO, pointer to elemSize bytes of data
+// Outputs: true if data is properly saved,
+//          false if data not saved, because it was full
+int OS_FifoPut(FifoType* fifo, const void* data){
+	long sr = StartCritical();
+	if(fifo->putIndex - fifo->getIndex > fifo->mask){
+		EndCritical(sr);
+		return 0;
+	}
+	
+	fifoCopy(&(fifo->buffer[(fifo->putIndex & fifo->mask)*fifo->elemSize]), data, 1, fifo->elemSize);
+	fifo->putIndex++;
+	
+	OS_Signal(&(fifo->dataAvailable));
+	EndCritical(sr);
+	
+	return 1;
+}
+
+// ******** OS_FifoGet ************
+// Remove one element from the FIFO
+// Called in foreground, will block if empty
+// Inputs:  FIFO, pointer to elemSize bytes to receive the data
+// Outputs: none
+void OS_FifoGet(FifoType* fifo, void* data){
+	OS_Wait(&(fifo->dataAvailable));
+	
+	long sr = StartCritical();
+	fifoCopy(data, &(fifo->buffer[(fifo->getIndex & fifo->mask)*fifo->elemSize]), 1, fifo->elemSize);
+	fifo->getIndex++;
+	EndCritical(sr);
+}
+
+// ******** OS_FifoPutBulk ************
+// Enter up to count elements into the FIFO, waking a consumer once per element
+// Can be called from the background, so no waiting
+// Inputs:  FIFO, pointer to count*elemSize bytes of data, count
+// Outputs: number of elements saved, less than count if the FIFO filled up
+uint32_t OS_FifoPutBulk(FifoType* fifo, const void* data, uint32_t count){
+	long sr = StartCritical();
+	uint32_t space = fifo->mask + 1 - (fifo->putIndex - fifo->getIndex);
+	if(count > space){
+		count = space;
+	}
+	
+	// at most two copies, up to the end of the buffer and then from its start
+	uint32_t first = fifo->mask + 1 - (fifo->putIndex & fifo->mask);
+	if(first > count){
+		first = count;
 	}
+	fifoCopy(&(fifo->buffer[(fifo->putIndex & fifo->mask)*fifo->elemSize]), data, first, fifo->elemSize);
+	fifoCopy(fifo->buffer, (const uint8_t*)data + first*fifo->elemSize, count - first, fifo->elemSize);
+	fifo->putIndex += count;
 	
-	// chain RunPt to sleeping threads
-	RunPt->previousTCB = SleepingThreads.previousTCB;
-	RunPt->nextTCB = &(SleepingThreads);
-	SleepingThreads.previousTCB->nextTCB = RunPt;
-	SleepingThreads.previousTCB = RunPt;
+	signalCount(&(fifo->dataAvailable), count);
+	EndCritical(sr);
 	
-	// set RunPt to next valid active thread
-	RunPt = nextRunPt;
-	*/
+	return count;
+}
+
+// ******** OS_FifoGetBulk ************
+// Remove between 1 and maxCount elements from the FIFO
+// Called in foreground, will block until at least one element is available
+// Inputs:  FIFO, pointer to maxCount*elemSize bytes to receive the data, maxCount
+// Outputs: number of elements removed
+uint32_t OS_FifoGetBulk(FifoType* fifo, void* data, uint32_t maxCount){
+	if(maxCount == 0){
+		return 0;
+	}
+	OS_Wait(&(fifo->dataAvailable));
 	
-	struct TCB* sleepingThread = RunPt;
-	// OS_Suspend will LSL TCB list and update RunPt with next valid thread
-	OS_Suspend();
+	long sr = StartCritical();
+	// one element is ours from OS_Wait, claim whatever else is already counted
+	uint32_t count = 1;
+	if(fifo->dataAvailable.Value > 0){
+		uint32_t extra = fifo->dataAvailable.Value;
+		if(extra > maxCount - 1){
+			extra = maxCount - 1;
+		}
+		fifo->dataAvailable.Value -= extra;
+		count += extra;
+	}
 	
-	// remove sleepingThread from its list and append to SleepingThreads list
+	uint32_t first = fifo->mask + 1 - (fifo->getIndex & fifo->mask);
+	if(first > count){
+		first = count;
+	}
+	fifoCopy(data, &(fifo->buffer[(fifo->getIndex & fifo->mask)*fifo->elemSize]), first, fifo->elemSize);
+	fifoCopy((uint8_t*)data + first*fifo->elemSize, fifo->buffer, count - first, fifo->elemSize);
+	fifo->getIndex += count;
+	EndCritical(sr);
 	
-	// unchaining sleepingThread from active threads
-	sleepingThread->previousTCB->nextTCB = sleepingThread->nextTCB;
-	sleepingThread->nextTCB->previousTCB = sleepingThread->previousTCB;
+	return count;
+}
+
+// ******** OS_FifoSize ************
+// Check the status of the FIFO
+// Inputs:  FIFO
+// Outputs: returns the number of elements in the FIFO
+int32_t OS_FifoSize(FifoType* fifo){
+	return fifo->putIndex - fifo->getIndex;
+}
+
+// ******** OS_RingInit ************
+// Initialize a single producer, single consumer ring to be empty
+// Inputs:  ring, buffer of size words
+//          size, number of elements, must be a power of 2
+//          watermark, number of buffered elements that wakes a blocked consumer, 1 to size
+// Outputs: 1 if successful, 0 if size or watermark is invalid
+int OS_RingInit(RingType* ring, uint32_t* buffer, uint32_t size, uint32_t watermark){
+	if(buffer == NULL || size == 0 || (size & (size-1)) || watermark == 0 || watermark > size){
+		return 0;
+	}
 	
-	// chain sleepingThread to sleeping threads
-	sleepingThread->previousTCB = SleepingThreads.previousTCB;
-	sleepingThread->nextTCB = &(SleepingThreads);
-	SleepingThreads.previousTCB->nextTCB = sleepingThread;
-	SleepingThreads.previousTCB = sleepingThread;
+	ring->buffer = buffer;
+	ring->mask = size - 1;
+	ring->watermark = watermark;
+	ring->putIndex = 0;
+	ring->getIndex = 0;
+	OS_InitSemaphore(&(ring->dataAvailable), 0);
 	
+	return 1;
+}
+
+// ******** OS_RingCreate ************
+// Initialize a ring the kernel keeps over a caller supplied buffer, for a process
+// Inputs:  buffer of size words
+//          size, number of elements, must be a power of 2
+//          watermark, number of buffered elements that wakes a blocked consumer, 1 to size
+// Outputs: the ring, NULL if size or watermark is invalid or no ring is left
+RingType* OS_RingCreate(uint32_t* buffer, uint32_t size, uint32_t watermark){
+	long sr = StartCritical();
+	RingType* ring = poolTake(&RingPool);
+	if(ring && !OS_RingInit(ring, buffer, size, watermark)){
+		poolGive(&RingPool, ring);
+		ring = NULL;
+	}
 	EndCritical(sr);
-	//OS_Suspend();
-};  
+	return ring;
+}
 
-// ******** OS_Kill ************
-// kill the currently running thread, release its TCB and stack
-// input:  none
-// output: none
-void OS_Kill(void){
-  // put Lab 2 (and beyond) solution here
-	DisableInterrupts();
-	
-	struct TCB* killThread = RunPt;
-	// OS_Suspend will LSL TCB list and update RunPt with next valid thread
-	OS_Suspend();
+// ******** OS_RingValid ************
+// Check a ring handle
+// Inputs:  ring
+// Outputs: 1 if OS_RingCreate handed it out, to the calling process for a process thread, 0 otherwise
+int OS_RingValid(RingType* ring){
+	return poolValid(&RingPool, ring);
+}
+
+// ******** OS_RingPut ************
+// Enter one sample into the ring, only ever called by the one producer
+// Can be called from the background, so no waiting, interrupts are only
+//   disabled to wake the consumer when the watermark is reached
+// Inputs:  ring, data
+// Outputs: true if data is properly saved,
+//          false if data not saved, because it was full
+int OS_RingPut(RingType* ring, uint32_t data){
+	uint32_t putIndex = ring->putIndex;
+	uint32_t count = putIndex - ring->getIndex;
+	if(count > ring->mask){
+		return 0;
+	}
 	
-	// unchaining killThread from active threads
-	killThread->previousTCB->nextTCB = killThread->nextTCB;
-	killThread->nextTCB->previousTCB = killThread->previousTCB;
+	ring->buffer[putIndex & ring->mask] = data;
+	RING_BARRIER();		// the sample must land before the consumer can see it
+	ring->putIndex = putIndex + 1;
 	
-	// mark as inactive for addThread to overwrite TCB
-	killThread->active = false;
+	// a blocked consumer only waits on an empty ring, and getIndex can not move while it waits,
+	// so the count passes through the watermark exactly
+	if(count + 1 == ring->watermark){
+		OS_bSignal(&(ring->dataAvailable));
+	}
 	
-	// Lab 5 addition for processes
-	killThread->currentPCB->threadCount--;
-	if(killThread->currentPCB->threadCount == 0){
-		killProcess(killThread->currentPCB);
+	return 1;
+}
+
+// block the consumer until the ring is not empty
+static void ringWait(RingType* ring){
+	while(ring->putIndex == ring->getIndex){
+		OS_bWait(&(ring->dataAvailable));
 	}
-	// reset the PCB pointer
-	killThread->currentPCB = NULL;
+	RING_BARRIER();		// read the samples only after seeing putIndex
+}
 
-  EnableInterrupts();   // end of atomic section 
-  //for(;;){};        // can not return
-    
-}; 
+// ringWait that gives up after timeout ms, a signal left over from samples already
+// taken restarts the wait for only the time that is left
+// the deadline is kept in OS_Time64, so OS_ClearMsTime during the wait can't cut it short
+// returns 1 if the ring is not empty, 0 if the wait timed out
+static int ringWaitTimeout(RingType* ring, uint32_t timeout){
+	uint64_t deadline = OS_Time64() + (uint64_t)timeout*TIME_1MS;
+	while(ring->putIndex == ring->getIndex){
+		uint64_t now = OS_Time64();
+		uint32_t remaining = now < deadline ? (deadline - now + TIME_1MS - 1)/TIME_1MS : 0;
+		if(!OS_bWait_Timeout(&(ring->dataAvailable), remaining)){
+			return 0;
+		}
+	}
+	RING_BARRIER();
+	return 1;
+}
 
-// ******** OS_Suspend ************
-// suspend execution of currently running thread
-// scheduler will choose another thread to execute
-// Can be used to implement cooperative multitasking 
-// Same function as OS_Sleep(0)
-// input:  none
-// output: none
-void OS_Suspend(void){
-  // put Lab 2 (and beyond) solution here
+// remove one sample from a ring that is not empty
+static uint32_t ringTake(RingType* ring){
+	uint32_t getIndex = ring->getIndex;
+	uint32_t data = ring->buffer[getIndex & ring->mask];
+	RING_BARRIER();		// the sample must be read before the producer can reuse its slot
+	ring->getIndex = getIndex + 1;
 	
-	long sr = StartCritical();
-	/*
-	RunPt = RunPt->nextTCB;
-	if(RunPt->listHead){
-		RunPt = RunPt->nextTCB;
+	return data;
+}
+
+// ******** OS_RingGet ************
+// Remove one sample from the ring, only ever called by the one consumer
+// Called in foreground, blocks while the ring is empty until the watermark is reached
+// Inputs:  ring
+// Outputs: data
+uint32_t OS_RingGet(RingType* ring){
+	ringWait(ring);
+	return ringTake(ring);
+}
+
+// ******** OS_RingGetBulk ************
+// Remove between 1 and maxCount samples from the ring, only ever called by the one consumer
+// Called in foreground, blocks while the ring is empty until the watermark is reached
+// Inputs:  ring, buffer of maxCount words, maxCount
+// Outputs: number of samples removed
+uint32_t OS_RingGetBulk(RingType* ring, uint32_t* data, uint32_t maxCount){
+	if(maxCount == 0){
+		return 0;
 	}
-	*/
-	scheduler();
-	
-	INTCTRL = 0x10000000;
-	// reset systick timer here:
-	NVIC_ST_CURRENT_R = 0;
+	ringWait(ring);
 	
-	EndCritical(sr);
+	uint32_t getIndex = ring->getIndex;
+	uint32_t count = ring->putIndex - getIndex;
+	if(count > maxCount){
+		count = maxCount;
+	}
+	for(uint32_t i = 0; i < count; i++){
+		data[i] = ring->buffer[(getIndex + i) & ring->mask];
+	}
+	RING_BARRIER();
+	ring->getIndex = getIndex + count;
 	
-	//INTCTRL = 0x10000000;
+	return count;
+}
+
+// ******** OS_RingSize ************
+// Check the status of the ring
+// Inputs:  ring
+// Outputs: returns the number of samples in the ring
+int32_t OS_RingSize(RingType* ring){
+	return ring->putIndex - ring->getIndex;
+}
 
-};
-  
 // ******** OS_Fifo_Init ************
 // Initialize the Fifo to be empty
 // Inputs: size
 // Outputs: none 
-// In Lab 2, you can ignore the size field
-// In Lab 3, you should implement the user-defined fifo size
-// In Lab 3, you can put whatever restrictions you want on size
-//    e.g., 4 to 64 elements
-//    e.g., must be a power of 2,4,8,16,32,64,128
+// size is rounded down to a power of 2 and limited to FIFOSIZE elements
 void OS_Fifo_Init(uint32_t size){
   // put Lab 2 (and beyond) solution here
-	OS_InitSemaphore(&dataAvailable, 0);			// data is not initially available
-	getIFFIndex = 0;
-	putIFFIndex = 0;
-	isrToForegroundFIFOCount = 0;
+	uint32_t fifoSize = FIFOSIZE;
+	while(fifoSize > 1 && fifoSize > size){
+		fifoSize >>= 1;
+	}
+	OS_RingInit(&isrToForegroundFIFO, isrToForegroundFIFOBuffer, fifoSize, 1);
 };
 
 // ******** OS_Fifo_Put ************
@@ -887,21 +3133,15 @@ void OS_Fifo_Init(uint32_t size){
 // Inputs:  data
 // Outputs: true if data is properly saved,
 //          false if data not saved, because it was full
-// Since this is called by interrupt handlers 
-//  this function can not disable or enable interrupts
+// Since this is called by interrupt handlers and threads alike,
+//  any number of producers may call it, it only saves and restores the interrupt state
+//  around the put, a single producer stream should use OS_RingPut instead
 int OS_Fifo_Put(uint32_t data){
   // put Lab 2 (and beyond) solution here
-	if(isrToForegroundFIFOCount == FIFOSIZE){
-		return 0;
-	}
-	
-	isrToForegroundFIFO[putIFFIndex] = data;
-	putIFFIndex = (putIFFIndex+1)%FIFOSIZE;
-	isrToForegroundFIFOCount++;
-	
-	OS_Signal(&dataAvailable);
-	
-	return 1;
+	long sr = StartCritical();
+	int saved = OS_RingPut(&isrToForegroundFIFO, data);
+	EndCritical(sr);
+	return saved;
 };  
 
 // ******** OS_Fifo_Get ************
@@ -911,18 +3151,23 @@ int OS_Fifo_Put(uint32_t data){
 // Outputs: data 
 uint32_t OS_Fifo_Get(void){
   // put Lab 2 (and beyond) solution here
-	
-	OS_Wait(&dataAvailable);
-	
-	long sr = StartCritical();
-	int fifoVal = isrToForegroundFIFO[getIFFIndex];
-	isrToForegroundFIFOCount--;
-	getIFFIndex = (getIFFIndex+1)%FIFOSIZE;
-	EndCritical(sr);
-  
-	return fifoVal; // replace this line with solution
+	return OS_RingGet(&isrToForegroundFIFO);
 };
 
+// ******** OS_Fifo_Get_Timeout ************
+// Remove one data sample from the Fifo, giving up if it stays empty
+// Called in foreground
+// Inputs:  pointer to receive the data
+//          timeout in ms, 0 never blocks
+// Outputs: 1 if data was removed, 0 if the wait timed out
+int OS_Fifo_Get_Timeout(uint32_t* data, uint32_t timeout){
+	if(!ringWaitTimeout(&isrToForegroundFIFO, timeout)){
+		return 0;
+	}
+	*data = ringTake(&isrToForegroundFIFO);
+	return 1;
+}
+
 // ******** OS_Fifo_Size ************
 // Check the status of the Fifo
 // Inputs: none
@@ -933,7 +3178,7 @@ uint32_t OS_Fifo_Get(void){
 int32_t OS_Fifo_Size(void){
   // put Lab 2 (and beyond) solution here
 	
-	return isrToForegroundFIFOCount;
+	return OS_RingSize(&isrToForegroundFIFO);
 };
 
 
@@ -984,6 +3229,169 @@ uint32_t OS_MailBox_Recv(void){
   return mailboxVal; // replace this line with solution
 };
 
+// ******** OS_MailBox_Recv_Timeout ************
+// remove mail from the MailBox, giving up if it stays empty
+// Inputs:  pointer to receive the data
+//          timeout in ms, 0 never blocks
+// Outputs: 1 if mail was received, 0 if the wait timed out
+// This function will be called from a foreground thread
+int OS_MailBox_Recv_Timeout(uint32_t* data, uint32_t timeout){
+	if(!OS_bWait_Timeout(&DataValid, timeout)){
+		return 0;
+	}
+	*data = Mailbox;
+	OS_bSignal(&BoxFree);
+	
+	return 1;
+}
+
+// ******** OS_MsgQueueInit ************
+// Initialize a message queue to be empty
+// Inputs:  queue, buffer of capacity*msgSize bytes
+//          capacity, number of messages the queue holds
+//          msgSize, number of bytes in each message
+// Outputs: none
+void OS_MsgQueueInit(MsgQueueType* queue, void* buffer, uint32_t capacity, uint32_t msgSize){
+	queue->buffer = buffer;
+	queue->capacity = capacity;
+	queue->msgSize = msgSize;
+	queue->putIndex = 0;
+	queue->getIndex = 0;
+	OS_InitSemaphore(&(queue->slotsFree), capacity);
+	OS_InitSemaphore(&(queue->msgsAvailable), 0);
+}
+
+// ******** OS_MsgQueueCreate ************
+// Initialize a message queue the kernel keeps over a caller supplied buffer, for a process
+// Inputs:  buffer of capacity*msgSize bytes
+//          capacity, number of messages the queue holds, not 0
+//          msgSize, number of bytes in each message, not 0
+// Outputs: the queue, NULL if capacity or msgSize is 0 or no queue is left
+MsgQueueType* OS_MsgQueueCreate(void* buffer, uint32_t capacity, uint32_t msgSize){
+	if(buffer == NULL || capacity == 0 || msgSize == 0){
+		return NULL;
+	}
+	long sr = StartCritical();
+	MsgQueueType* queue = poolTake(&MsgQueuePool);
+	if(queue){
+		OS_MsgQueueInit(queue, buffer, capacity, msgSize);
+	}
+	EndCritical(sr);
+	return queue;
+}
+
+// ******** OS_MsgQueueValid ************
+// Check a message queue handle
+// Inputs:  queue
+// Outputs: 1 if OS_MsgQueueCreate handed it out, to the calling process for a process thread, 0 otherwise
+int OS_MsgQueueValid(MsgQueueType* queue){
+	return poolValid(&MsgQueuePool, queue);
+}
+
+// copy msg into the next free slot, a slot must have been claimed from slotsFree
+static void msgQueuePut(MsgQueueType* queue, const void* msg){
+	long sr = StartCritical();
+	memcpy(&(queue->buffer[queue->putIndex*queue->msgSize]), msg, queue->msgSize);
+	queue->putIndex++;
+	if(queue->putIndex == queue->capacity){
+		queue->putIndex = 0;
+	}
+	EndCritical(sr);
+	OS_Signal(&(queue->msgsAvailable));
+}
+
+// copy the oldest message into msg, a message must have been claimed from msgsAvailable
+static void msgQueueGet(MsgQueueType* queue, void* msg){
+	long sr = StartCritical();
+	memcpy(msg, &(queue->buffer[queue->getIndex*queue->msgSize]), queue->msgSize);
+	queue->getIndex++;
+	if(queue->getIndex == queue->capacity){
+		queue->getIndex = 0;
+	}
+	EndCritical(sr);
+	OS_Signal(&(queue->slotsFree));
+}
+
+// ******** OS_MsgQueueSend ************
+// Copy a message into the queue
+// Called in foreground, will block while the queue is full
+// Inputs:  queue, pointer to msgSize bytes
+// Outputs: none
+void OS_MsgQueueSend(MsgQueueType* queue, const void* msg){
+	OS_Wait(&(queue->slotsFree));
+	msgQueuePut(queue, msg);
+}
+
+// ******** OS_MsgQueueRecv ************
+// Copy the oldest message out of the queue
+// Called in foreground, will block while the queue is empty
+// Inputs:  queue, pointer to msgSize bytes to receive the message
+// Outputs: none
+void OS_MsgQueueRecv(MsgQueueType* queue, void* msg){
+	OS_Wait(&(queue->msgsAvailable));
+	msgQueueGet(queue, msg);
+}
+
+// ******** OS_MsgQueueSendTimeout ************
+// Copy a message into the queue, giving up if the queue stays full
+// Called in foreground
+// Inputs:  queue, pointer to msgSize bytes
+//          timeout in ms, 0 never blocks
+// Outputs: 1 if the message was sent, 0 if the wait timed out
+int OS_MsgQueueSendTimeout(MsgQueueType* queue, const void* msg, uint32_t timeout){
+	if(!OS_Wait_Timeout(&(queue->slotsFree), timeout)){
+		return 0;
+	}
+	msgQueuePut(queue, msg);
+	return 1;
+}
+
+// ******** OS_MsgQueueRecvTimeout ************
+// Copy the oldest message out of the queue, giving up if the queue stays empty
+// Called in foreground
+// Inputs:  queue, pointer to msgSize bytes to receive the message
+//          timeout in ms, 0 never blocks
+// Outputs: 1 if a message was received, 0 if the wait timed out
+int OS_MsgQueueRecvTimeout(MsgQueueType* queue, void* msg, uint32_t timeout){
+	if(!OS_Wait_Timeout(&(queue->msgsAvailable), timeout)){
+		return 0;
+	}
+	msgQueueGet(queue, msg);
+	return 1;
+}
+
+// ******** OS_Time64 ************
+// return the free-running clock
+// Inputs:  none
+// Outputs: time since OS_Init in 12.5ns units
+// Never wraps in practice, 2^64 bus cycles are over 7000 years
+uint64_t OS_Time64(void){
+	// read the high word on both sides of the low word,
+	// so a carry out of the low word between the reads can't tear the value
+	uint32_t high, low;
+	do{
+		high = WTIMER5_TBV_R;
+		low = WTIMER5_TAV_R;
+	}while(high != WTIMER5_TBV_R);
+	return ((uint64_t)high << 32)|low;
+}
+
+// ******** OS_TimeUs ************
+// return the free-running clock in usec
+// Inputs:  none
+// Outputs: time since OS_Init in usec
+uint64_t OS_TimeUs(void){
+	return OS_Time64()/(TIME_1MS/1000);
+}
+
+// ******** OS_TimeNs ************
+// return the free-running clock in nsec
+// Inputs:  none
+// Outputs: time since OS_Init in nsec, a multiple of 12.5ns rounded down
+uint64_t OS_TimeNs(void){
+	return OS_Time64()*25/2;
+}
+
 // ******** OS_Time ************
 // return the system time 
 // Inputs:  none
@@ -991,27 +3399,10 @@ uint32_t OS_MailBox_Recv(void){
 // The time resolution should be less than or equal to 1us, and the precision 32 bits
 // It is ok to change the resolution and precision of this function as long as 
 //   this function and OS_TimeDifference have the same resolution and precision 
+// The low word of OS_Time64, it wraps every 53.7 s
 uint32_t OS_Time(void){
   // put Lab 2 (and beyond) solution here
-	
-	uint32_t ticks = TIMER5_TAV_R;
-	//uint32_t ticks = 0;
-	
-	uint32_t msTicks = time.ms;
-	msTicks *= TIMEPERIOD;
-	
-	uint32_t sTicks = time.s;
-	sTicks *= 1000;
-	sTicks *= TIMEPERIOD;
-	
-	uint32_t minTicks = time.min;
-	minTicks *= 60;
-	minTicks *= 1000;
-	minTicks *= TIMEPERIOD;
-	
-	uint32_t totalTicks = (ticks + msTicks + sTicks + minTicks);
-
-  return totalTicks; // output is in 12.5ns units
+	return (uint32_t)OS_Time64();
 };
 
 // ******** OS_TimeDifference ************
@@ -1021,68 +3412,59 @@ uint32_t OS_Time(void){
 // The time resolution should be less than or equal to 1us, and the precision at least 12 bits
 // It is ok to change the resolution and precision of this function as long as 
 //   this function and OS_Time have the same resolution and precision 
+// Correct across a wrap of OS_Time, as long as stop is less than 53.7 s after start
 uint32_t OS_TimeDifference(uint32_t start, uint32_t stop){
   // put Lab 2 (and beyond) solution here
-	
-	if(stop > start){
-		return stop - start;
-	}
-	
-	uint32_t timerOverflowVal = 4294967295 - start + stop;
-	
-  return timerOverflowVal; // replace this line with solution
+	return stop - start;
 };
 
-void OS_TimerIncrement(void){
-	// following line needs launchpad_init() or else will hardfault!
-	//PF2 ^= 0x04;
-	//currently using  1ms timer
-	if(time.ms == 999){
-		time.ms = 0;
-		if(time.s == 59){
-			time.s = 0;
-			if(time.min == 59){
-				time.s = 59;
-				time.ms = 999;
-			}else{
-				time.min++;
-			}
-		}else{
-			time.s++;
-		}
-	}else{
-		time.ms++;
-	}
-	
-	//	Update sleeping thread timers
-	//  current highest priority interrupt at priority 5
-	
-	long sr = StartCritical();
-	
+// count the ticks that have gone by, the clock itself is WTIMER5
+static void timeAdvance(uint32_t ticks){
+	Ticks += ticks;
+}
+
+// count the head of the sleeping threads down by a number of ticks and wake every thread that is due
+// ticks can't be larger than the head's sleepTime, must be called with interrupts disabled
+// returns the most urgent real-time thread woken, NULL if none
+static struct TCB* sleepQueueAdvance(uint32_t ticks){
 	struct TCB* sleepingThreadsTail = &SleepingThreads;
-	struct TCB* sleepingThreadsPt = SleepingThreads.nextTCB;
+	struct TCB* released = NULL;
+	struct TCB* sleepingThreadsPt = SleepingThreads.nextSleepTCB;
 	/*
 	int currentThreadPriority = RunPt->priority;
 	int highestWokenThreadPriority = 8;
 	*/
 	
-	while(sleepingThreadsPt != sleepingThreadsTail){
-		sleepingThreadsPt->sleepTime--;
-		struct TCB* nextSleepingThread = sleepingThreadsPt->nextTCB;
-		if(sleepingThreadsPt->sleepTime == 0){
-			/*
-			if(sleepingThreadsPt->priority < highestWokenThreadPriority){
-				highestWokenThreadPriority = sleepingThreadsPt->priority;
+	// only the head of the delta queue counts down, everything behind it is relative
+	if(sleepingThreadsPt != sleepingThreadsTail){
+		sleepingThreadsPt->sleepTime -= ticks;
+	}
+	
+	// pop every thread whose delta has reached zero
+	while(sleepingThreadsPt != sleepingThreadsTail && sleepingThreadsPt->sleepTime == 0){
+		struct TCB* nextSleepingThread = sleepingThreadsPt->nextSleepTCB;
+		/*
+		if(sleepingThreadsPt->priority < highestWokenThreadPriority){
+			highestWokenThreadPriority = sleepingThreadsPt->priority;
+		}
+		*/
+		// remove from sleeping list and back into active threads
+		sleepQueueRemove(sleepingThreadsPt);
+		if(sleepingThreadsPt->waitQueue){
+			// the wait timed out, give up the place in the wait queue and in the semaphore count
+			TRACE(TRACE_TIMEOUT, sleepingThreadsPt->id, (uintptr_t)sleepingThreadsPt->waitQueue);
+			waitQueueRemove(sleepingThreadsPt->waitQueue, sleepingThreadsPt);
+			sleepingThreadsPt->waitQueue = NULL;
+			if(sleepingThreadsPt->timedSema4){
+				sleepingThreadsPt->timedSema4->Value++;
+				sleepingThreadsPt->timedSema4 = NULL;
 			}
-			*/
-			// remove from sleeping list and back into active threads
-			sleepingThreadsPt->nextTCB->previousTCB = sleepingThreadsPt->previousTCB;
-			sleepingThreadsPt->previousTCB->nextTCB = sleepingThreadsPt->nextTCB;
-			// place woken up thread back into active threads list
-			sleepingThreadsPt->nextTCB = &(ActiveThreads[sleepingThreadsPt->priority]);
-			sleepingThreadsPt->previousTCB = ActiveThreads[sleepingThreadsPt->priority].previousTCB;
-			ActiveThreads[sleepingThreadsPt->priority].previousTCB->nextTCB = sleepingThreadsPt;
-			ActiveThreads[sleepingThreadsPt->priority].previousTCB = sleepingThreadsPt;
+			sleepingThreadsPt->timedOut = true;
+		}
+		// place woken up thread back into active threads list
+		readyListAppend(sleepingThreadsPt);
+		if(sleepingThreadsPt->realTime && (released == NULL || realTimeBefore(sleepingThreadsPt, released))){
+			released = sleepingThreadsPt;
 		}
 		sleepingThreadsPt = nextSleepingThread;
 	}
@@ -1091,8 +3473,120 @@ void OS_TimerIncrement(void){
 		OS_Suspend();
 	}
 	*/
+	return released;
+}
+
+void OS_TimerIncrement(void){
+	// Timer5A counts down, so elapsed time in this ISR is start - TIMER5_TAV_R
+	uint32_t isrStartTime = TIMER5_TAV_R;
+	int32_t sleeperCount = SleepingThreadCount;
+	
+	// following line needs launchpad_init() or else will hardfault!
+	//PF2 ^= 0x04;
+	//currently using  1ms timer
+	timeAdvance(1);
+	
+	//	Update sleeping thread timers
+	//  current highest priority interrupt at priority 5
+	
+	long sr = StartCritical();
+	struct TCB* released = sleepQueueAdvance(1);
+	timerWheelCheck();
+	// a released real-time job doesn't wait for the end of the time slice
+	if(released){
+		preemptForThread(released);
+	}
 	EndCritical(sr);
 	
+	// record worst case ISR duration for this many sleeping threads
+	uint32_t isrTime = isrStartTime - TIMER5_TAV_R;
+	if(sleeperCount > SLEEPERSIZE){
+		sleeperCount = SLEEPERSIZE;
+	}
+	if(isrTime > SleepISRMaxTime[sleeperCount]){
+		SleepISRMaxTime[sleeperCount] = isrTime;
+	}
+}
+
+// stop the ticks until the first sleeping thread or software timer is due or another interrupt arrives,
+// then catch the system time and the sleeping threads up on the ticks that were skipped
+// must be called with interrupts disabled while RunPt is the only thread that can run
+static void ticklessWait(void){
+	struct TCB* idleThread = RunPt;
+	uint32_t idleTicks = TICKLESS_MAX_TICKS;
+	if(SleepingThreads.nextSleepTCB != &SleepingThreads && SleepingThreads.nextSleepTCB->sleepTime < idleTicks){
+		idleTicks = SleepingThreads.nextSleepTCB->sleepTime;
+	}
+	uint32_t timerTicks = timerWheelNext();
+	if(timerTicks < idleTicks){
+		idleTicks = timerTicks;
+	}
+	// the next tick is due anyways
+	if(idleTicks <= 1){
+		WaitForInterrupt();
+		return;
+	}
+	
+	// stop preemption, there is nothing else to switch to
+	unsigned long sysTickCtrl = NVIC_ST_CTRL_R;
+	NVIC_ST_CTRL_R = 0;
+	
+	// restart Timer5A so that it times out idleTicks after the last counted tick
+	uint32_t periodElapsed = TIMER5_TAILR_R - TIMER5_TAV_R;
+	TickOffset += periodElapsed;
+	TIMER5_TAILR_R = idleTicks*TIMEPERIOD - TickOffset - 1;
+	
+	WaitForInterrupt();
+	
+	// find out how long we slept, a timeout means the stretch ran to the end
+	uint32_t stretchElapsed;
+	if(TIMER5_RIS_R&TIMER_RIS_TATORIS){
+		TIMER5_ICR_R = TIMER_ICR_TATOCINT;
+		NVIC_UNPEND2_R = 1<<28;		// the NVIC latched the timeout too, the ticks are counted here instead
+		stretchElapsed = TIMER5_TAILR_R + 1;
+	}else{
+		stretchElapsed = TIMER5_TAILR_R - TIMER5_TAV_R;
+	}
+	
+	// go back to periodic ticks, keeping the part of a tick that already elapsed in TickOffset
+	TIMER5_TAILR_R = TIMEPERIOD - 1;
+	uint32_t totalElapsed = TickOffset + stretchElapsed;
+	TickOffset = totalElapsed%TIMEPERIOD;
+	uint32_t skippedTicks = totalElapsed/TIMEPERIOD;
+	timeAdvance(skippedTicks);
+	sleepQueueAdvance(skippedTicks);
+	timerWheelCheck();
+	
+	NVIC_ST_CURRENT_R = 0;
+	NVIC_ST_CTRL_R = sysTickCtrl;
+	
+	// switch right away to any thread that woke up, unless waking the timer daemon already did
+	if(RunPt == idleThread && (ReadyPriorities != PRIORITY_BIT(RunPt->priority) || RunPt->nextTCB->nextTCB != RunPt)){
+		OS_Suspend();
+	}
+}
+
+// ******** OS_Idle ************
+// wait in low power mode for the next interrupt
+// called in a loop by the lowest priority idle thread
+// input:  none
+// output: none
+void OS_Idle(void){
+	// nothing else is ready, a good time to free what killed threads and processes left behind
+	if(reap()){
+		return;
+	}
+#if TICKLESS_IDLE
+	long sr = StartCritical();
+	// tickless only when RunPt is the only thread that can run
+	if(ReadyPriorities == PRIORITY_BIT(RunPt->priority) && RunPt->nextTCB->nextTCB == RunPt){
+		ticklessWait();
+		EndCritical(sr);
+		return;
+	}
+	EndCritical(sr);
+#endif
+	WaitForInterrupt();
 }
 
 void (*PeriodicTask5)(void);   // user function
@@ -1115,8 +3609,12 @@ void Timer5A_Init(void(*task)(void), uint32_t period, uint32_t priority){
 }
 
 void Timer5A_Handler(void){
+  // waking a real-time thread switches RunPt, the exit record names the interrupted thread
+  int32_t interruptedId = RunPt ? RunPt->id : TRACE_NOTHREAD;
+  TRACE(TRACE_ISR_ENTER, interruptedId, TRACE_TIMER5A);
   TIMER5_ICR_R = TIMER_ICR_TATOCINT;// acknowledge TIMER5A timeout
   (*PeriodicTask5)();               // execute user task
+  TRACE(TRACE_ISR_EXIT, interruptedId, TRACE_TIMER5A);
 }
 void Timer5_Stop(void){
   NVIC_DIS2_R = 1<<28;          // 9) disable interrupt 92 in NVIC
@@ -1135,9 +3633,8 @@ void OS_ClearMsTime(void){
 		Timer5_Stop();
 	}
 	
-	time.ms = 0;
-	time.s = 0;
-	time.min = 0;
+	MsTimeStart = OS_Time64();
+	TickOffset = 0;
 	
 	//1ms == 1000000 ns
 	//ticks = 1000000 / (12.5ns/tick)
@@ -1156,32 +3653,10 @@ void OS_ClearMsTime(void){
 // Outputs: time in ms units
 // You are free to select the time resolution for this function
 // For Labs 2 and beyond, it is ok to make the resolution to match the first call to OS_AddPeriodicThread
+// Counted from the free-running clock, so it runs for 49.7 days after OS_ClearMsTime
 uint32_t OS_MsTime(void){
   // put Lab 1 solution here
-	uint32_t timeMuliplier = 0;
-	
-	//uint32_t timerTickMs = (TIMER5_TAV_R * 12.5)/1000000;
-	uint32_t timerTickMs = 0;
-	uint32_t timerMs = time.ms;
-	uint32_t timerS = time.s * 1000;
-	uint32_t timerMin = time.min * 60 * 1000;
-	
-	if(TIMEPERIOD > TIME_1MS){
-		timeMuliplier = TIMEPERIOD/TIME_1MS;
-		timerTickMs *= timeMuliplier;
-		timerMs *= timeMuliplier;
-		timerMin *= timeMuliplier;
-		timerMin *= timeMuliplier;
-	}else{
-		timeMuliplier = TIME_1MS/TIMEPERIOD;
-		timerTickMs /= timeMuliplier;
-		timerMs /= timeMuliplier;
-		timerMin /= timeMuliplier;
-		timerMin /= timeMuliplier;
-	}
-	
-	uint32_t total_ms = timerTickMs + timerMs + timerS + timerMin;
-	return total_ms;
+	return (OS_Time64() - MsTimeStart)/TIME_1MS;
 };
 
 
@@ -1190,6 +3665,8 @@ uint32_t OS_MsTime(void){
 // Inputs: number of 12.5ns clock cycles for each time slice
 //         you may select the units of this parameter
 // Outputs: none (does not return)
+//          returns without starting anything if the timer daemon thread can't be added,
+//          because every thread or the stack space is used up
 // In Lab 2, you can ignore the theTimeSlice field
 // In Lab 3, you should implement the user-defined TimeSlice field
 // It is ok to limit the range of theTimeSlice to match the 24-bit SysTick
@@ -1199,25 +3676,30 @@ void OS_Launch(uint32_t theTimeSlice){
 	// set RunPt here to startOS
 	// be careful about removing all threads because OS_Addthread will not save you
 	// add a idle thread to get around this. OS_Addthread should not interact with RunPt
+	// added last so that the IDs of the application threads stay the same,
+	// without it the software timers would never fire, so nothing is started
+	if(!OS_AddThread(&timerDaemon, TIMERDAEMONSTACK, TIMERDAEMON_PRIORITY)){
+		return;
+	}
 	SysTick_Init(theTimeSlice);
+	SwitchStamp = OS_Time64();
+	periodicStart();
 	
 	// pick the first thread with the highest priority
-	int firstActiveThreadIndex = 0;
-	for(int i = 0; i < PRIORITY_NUM; i++){
-		if(ActiveThreads[i].nextTCB != &(ActiveThreads[i])){
-			firstActiveThreadIndex = i;
-			break;
-		}
-	}
+	int firstActiveThreadIndex = HIGHEST_PRIORITY(ReadyPriorities);
 	
 	RunPt = ActiveThreads[firstActiveThreadIndex].nextTCB;
 	StackPt = &(ActiveThreads[firstActiveThreadIndex].nextTCB->stackPt);
+	if(RunPt->currentPCB){
+		mpuLoad(RunPt);
+	}
 	
   //RunPt = ActiveThreads.nextTCB;
 	//StackPt = &(ActiveThreads.nextTCB->stackPt);
 	
 	// interrupt bookkeeping:
 	// Timer5A -> priority 5
+	// WTIMER0A -> highest priority of the periodic tasks
 	// Systick -> priority 7
 	// PendSV  -> priority 7
 	StartOS();
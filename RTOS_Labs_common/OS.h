@@ -17,6 +17,7 @@
 #ifndef __OS_H
 #define __OS_H  1
 #include <stdint.h>
+#include <stdbool.h>
 #include "../RTOS_Labs_common/TCB.h"
 
 
@@ -28,7 +29,41 @@
 #define TIME_500US  (TIME_1MS/2)  
 #define TIME_250US  (TIME_1MS/5)  
 
+// number of foreground priority levels, at most 32 so that each level
+// fits in one bit of a 32-bit ready bitmap
+#ifndef PRIORITY_NUM
 #define PRIORITY_NUM 8
+#endif
+
+// real-time threads all run at this priority, ahead of any other thread there
+#define REALTIME_PRIORITY	0
+
+// the software timer callbacks run in a kernel thread at this priority
+#define TIMERDAEMON_PRIORITY	0
+
+// exit code of a thread that ended on a fault, see OS_Exit and OS_SetRestartPolicy
+#define FAULT_EXITCODE	(-1)
+// exception of the record left when a thread that faulted could not be restarted
+#define FAULT_RESTARTFAILED	0
+#define FAULTRECORD_NUM	4			// newest faults kept for OS_FaultRecord
+
+// how OS_SchedulingMode orders the real-time threads
+#define SCHED_PRIORITY	0		// no real-time threads, fixed priority with round robin at each level
+#define SCHED_DM				1		// deadline monotonic, shorter relative deadline first, utilization bound admission,
+														// the same as rate monotonic when every deadline is the period
+#define SCHED_EDF				2		// earliest absolute deadline first, admitted up to full utilization
+
+/**
+ * \brief Threads blocked on a semaphore, mailbox, fifo or any other blocking primitive.
+ * Each priority is a circular list of TCBs, head[priority] is the next thread to wake
+ * and head[priority]->previousTCB is the last one to wake
+ */
+struct WaitQueue{
+	struct TCB* head[PRIORITY_NUM];
+	// bit (31-priority) is set while head[priority] is not NULL
+	uint32_t waitingPriorities;
+};
+typedef struct WaitQueue WaitQueueType;
 
 /**
  * \brief Semaphore structure. Feel free to change the type of semaphore, there are lots of good solutions
@@ -36,22 +71,153 @@
 
 struct  Sema4{
   int32_t Value;   // >0 means free, otherwise means busy        
-	// add other components here, if necessary to implement blocking
-	/*
-		first way to implement blocking semaphores
-		struct TCB* blockedThreads = NULL;
-		
-		second way to implement blocking semaphores
-			priorities from 0->7 = 8 entries
-		struct TCB* blockThreads[8];
-		
-		third way to implement blocking semaphores
-			uCos II's countLeadingZeros
-	*/
-	struct TCB blockedThreads[PRIORITY_NUM];
+	WaitQueueType blockedThreads;
 };
 typedef struct Sema4 Sema4Type;
 
+/**
+ * \brief Mutex with an owner, the owner inherits the priority of the highest priority waiter
+ */
+struct Mutex{
+	struct TCB* owner;				// NULL when free
+	struct Mutex* nextHeld;		// next mutex held by the same owner
+	WaitQueueType waiters;
+};
+typedef struct Mutex MutexType;
+
+/**
+ * \brief Group of 32 event flags. A thread waits for any or all of the flags in a mask,
+ * setting flags wakes only the threads whose condition is met
+ */
+struct EventGroup{
+	uint32_t flags;
+	WaitQueueType waiters;
+};
+typedef struct EventGroup EventGroupType;
+
+// options of OS_EventGroupWait, the default waits for any flag in the mask and leaves the flags set
+#define EVENT_WAITALL	0x01		// wait until every flag in the mask is set
+#define EVENT_CLEAR		0x02		// clear the flags in the mask once the wait is satisfied
+
+/**
+ * \brief FIFO of fixed size elements, size is a power of 2 so indices wrap with a mask.
+ * putIndex and getIndex run freely, putIndex-getIndex is the number of elements stored
+ */
+struct Fifo{
+	uint8_t* buffer;					// NULL while the FIFO is unused
+	uint32_t mask;						// number of elements - 1
+	uint32_t elemSize;				// bytes per element
+	uint32_t putIndex;
+	uint32_t getIndex;
+	Sema4Type dataAvailable;
+};
+typedef struct Fifo FifoType;
+
+/**
+ * \brief Single producer, single consumer ring of 32-bit samples.
+ * Only the producer writes putIndex and only the consumer writes getIndex, so the data path
+ * needs no critical section. The consumer is woken when the ring fills up to the watermark
+ */
+struct Ring{
+	uint32_t* buffer;
+	uint32_t mask;							// number of elements - 1
+	uint32_t watermark;					// 1 wakes the consumer on the empty to non-empty transition
+	volatile uint32_t putIndex;
+	volatile uint32_t getIndex;
+	Sema4Type dataAvailable;		// binary, a stale signal only costs the consumer a recheck
+};
+typedef struct Ring RingType;
+
+/**
+ * \brief Queue of fixed size messages, each queue is its own producer/consumer channel
+ */
+struct MsgQueue{
+	uint8_t* buffer;
+	uint32_t capacity;					// number of messages
+	uint32_t msgSize;						// bytes per message
+	uint32_t putIndex;
+	uint32_t getIndex;
+	Sema4Type slotsFree;
+	Sema4Type msgsAvailable;
+};
+typedef struct MsgQueue MsgQueueType;
+
+/**
+ * \brief Stack usage of one thread, as reported by OS_StackStats
+ */
+struct StackStats{
+	uint32_t size;							// bytes
+	uint32_t peakUsed;					// most bytes ever in use
+	bool overflowed;						// the thread ran past the bottom of its stack
+};
+typedef struct StackStats StackStatsType;
+
+/**
+ * \brief CPU usage of one thread since OS_Launch, as reported by OS_ThreadStats
+ */
+struct ThreadStats{
+	uint64_t runTime;						// bus cycles
+	uint32_t share;							// of all CPU time, in 0.1%
+	uint32_t switchesIn;
+	uint32_t preemptions;
+	uint32_t voluntarySwitches;
+	int32_t priority;
+	uint32_t jobs;							// jobs a real-time thread has finished, 0 for other threads
+	uint32_t deadlineMisses;		// jobs that finished late or were skipped
+};
+typedef struct ThreadStats ThreadStatsType;
+
+/**
+ * \brief Release timing of one periodic task, as reported by OS_PeriodicStats
+ */
+struct PeriodicStats{
+	uint32_t period;						// bus cycles
+	uint32_t priority;
+	uint32_t releases;					// times the task has run
+	uint32_t overruns;					// releases dropped because the task fell a whole period behind
+	uint32_t maxJitter;					// longest delay from an ideal release to the task starting, bus cycles
+};
+typedef struct PeriodicStats PeriodicStatsType;
+
+/**
+ * \brief A fault taken by a thread or an ISR, as reported by OS_FaultRecord
+ */
+struct FaultRecord{
+	uint32_t time;							// OS_MsTime
+	int32_t id;									// thread that faulted, -1 for a fault in an ISR or before OS_Launch
+	uint32_t exception;					// 3 hard fault, 4 memory management, 5 bus, 6 usage, or FAULT_RESTARTFAILED
+	uint32_t cfsr;							// configurable fault status, NVIC_FAULT_STAT
+	uint32_t hfsr;							// hard fault status, NVIC_HFAULT_STAT
+	uint32_t address;						// data address that faulted if cfsr has one, otherwise 0
+	uint32_t registers[8];			// R0-R3, R12, LR, PC, xPSR stacked on exception entry
+};
+typedef struct FaultRecord FaultRecordType;
+
+/**
+ * \brief Cost of the MPU regions loaded on context switches, as reported by OS_MpuStats
+ */
+struct MpuStats{
+	uint32_t switches;					// switches into a process thread
+	uint32_t updates;						// of those, switches that had to load regions
+	uint64_t cycles;						// bus cycles spent loading regions, without the cost of timing them
+	uint32_t maxCycles;					// longest load
+};
+typedef struct MpuStats MpuStatsType;
+
+/**
+ * \brief Software timer, the callback runs in the timer daemon thread when it expires.
+ * The caller owns the memory, OS_SoftTimerInit sets it up
+ */
+struct SoftTimer{
+	void (*callback)(void*);
+	void* arg;									// handed to the callback
+	uint32_t expiry;						// tick the timer is due at
+	uint32_t period;						// ms between expiries, 0 for a one-shot timer
+	struct SoftTimer* next;			// chain of the timer wheel slot, NULL while stopped
+	struct SoftTimer* previous;
+};
+typedef struct SoftTimer SoftTimerType;
+
 
 /**
  * @details  Initialize operating system, disable interrupts until OS_Launch.
@@ -69,6 +235,19 @@ void OS_Init(void);
 // output: none
 void OS_InitSemaphore(Sema4Type *semaPt, int32_t value); 
 
+// ******** OS_Sema4Create ************
+// initialize a semaphore the kernel keeps, for a process, which can't be trusted with the
+// wait queue links inside one in its own memory
+// input:  initial value
+// output: the semaphore, NULL if none is left
+Sema4Type* OS_Sema4Create(int32_t value);
+
+// ******** OS_Sema4Valid ************
+// check a semaphore handle
+// input:  semaphore
+// output: 1 if OS_Sema4Create handed it out, to the calling process for a process thread, 0 otherwise
+int OS_Sema4Valid(Sema4Type *semaPt);
+
 // ******** OS_Wait ************
 // decrement semaphore 
 // Lab2 spinlock
@@ -77,6 +256,13 @@ void OS_InitSemaphore(Sema4Type *semaPt, int32_t value);
 // output: none
 void OS_Wait(Sema4Type *semaPt); 
 
+// ******** OS_Wait_Timeout ************
+// decrement semaphore, block if less than zero for at most timeout ms
+// input:  pointer to a counting semaphore
+//         timeout in ms, 0 never blocks
+// output: 1 if the semaphore was taken, 0 if the wait timed out
+int OS_Wait_Timeout(Sema4Type *semaPt, uint32_t timeout);
+
 // ******** OS_Signal ************
 // increment semaphore 
 // Lab2 spinlock
@@ -92,6 +278,13 @@ void OS_Signal(Sema4Type *semaPt);
 // output: none
 void OS_bWait(Sema4Type *semaPt); 
 
+// ******** OS_bWait_Timeout ************
+// set binary semaphore to 0, block while it is 0 for at most timeout ms
+// input:  pointer to a binary semaphore
+//         timeout in ms, 0 never blocks
+// output: 1 if the semaphore was taken, 0 if the wait timed out
+int OS_bWait_Timeout(Sema4Type *semaPt, uint32_t timeout);
+
 // ******** OS_bSignal ************
 // Lab2 spinlock, set to 1
 // Lab3 wakeup blocked thread if appropriate 
@@ -99,18 +292,128 @@ void OS_bWait(Sema4Type *semaPt);
 // output: none
 void OS_bSignal(Sema4Type *semaPt); 
 
+// ******** OS_InitMutex ************
+// initialize a mutex as free
+// input:  pointer to a mutex
+// output: none
+void OS_InitMutex(MutexType *mutexPt);
+
+// ******** OS_MutexCreate ************
+// initialize a free mutex the kernel keeps, for a process
+// input:  none
+// output: the mutex, NULL if none is left
+MutexType* OS_MutexCreate(void);
+
+// ******** OS_MutexValid ************
+// check a mutex handle
+// input:  mutex
+// output: 1 if OS_MutexCreate handed it out, to the calling process for a process thread, 0 otherwise
+int OS_MutexValid(MutexType *mutexPt);
+
+// ******** OS_MutexLock ************
+// take ownership of the mutex, block if another thread owns it
+// while blocked, the owner (and any owner it is waiting on in turn)
+//   runs at least at the priority of the calling thread
+// can not be called from the background, a thread can not lock a mutex it already owns
+// input:  pointer to a mutex
+// output: none
+void OS_MutexLock(MutexType *mutexPt);
+
+// ******** OS_MutexUnlock ************
+// release the mutex to the highest priority waiter and drop any inherited priority
+// only the owner can unlock
+// input:  pointer to a mutex
+// output: none
+void OS_MutexUnlock(MutexType *mutexPt);
+
+// held around every call into heap.c, threads allocate and free while OS_Idle frees
+// what finished processes leave behind, and the heap walk is too long to disable interrupts for
+extern MutexType HeapMutex;
+
+// ******** OS_EventGroupInit ************
+// initialize an event group with every flag clear
+// input:  pointer to an event group
+// output: none
+void OS_EventGroupInit(EventGroupType *groupPt);
+
+// ******** OS_EventGroupCreate ************
+// initialize an event group the kernel keeps, for a process, with every flag clear
+// input:  none
+// output: the event group, NULL if none is left
+EventGroupType* OS_EventGroupCreate(void);
+
+// ******** OS_EventGroupValid ************
+// check an event group handle
+// input:  event group
+// output: 1 if OS_EventGroupCreate handed it out, to the calling process for a process thread, 0 otherwise
+int OS_EventGroupValid(EventGroupType *groupPt);
+
+// ******** OS_EventGroupSet ************
+// set flags and wake every waiter whose condition is now met
+// waiters woken by the same call all see the flags as set, the flags they
+// clear with EVENT_CLEAR are cleared after all of them are woken
+// can be called from threads and ISRs
+// input:  pointer to an event group
+//         flags to set
+// output: flags of the group after waking the waiters
+uint32_t OS_EventGroupSet(EventGroupType *groupPt, uint32_t flags);
+
+// ******** OS_EventGroupClear ************
+// clear flags, can be called from threads and ISRs
+// input:  pointer to an event group
+//         flags to clear
+// output: flags of the group before clearing
+uint32_t OS_EventGroupClear(EventGroupType *groupPt, uint32_t flags);
+
+// ******** OS_EventGroupGet ************
+// read the flags without waiting
+// input:  pointer to an event group
+// output: flags of the group
+uint32_t OS_EventGroupGet(EventGroupType *groupPt);
+
+// ******** OS_EventGroupWait ************
+// block until any of the flags in mask are set, or all of them with EVENT_WAITALL
+// input:  pointer to an event group
+//         flags to wait for, not 0
+//         EVENT_WAITALL, EVENT_CLEAR or both, 0 for neither
+// output: flags of the group when the wait was satisfied, 0 for a mask of 0
+uint32_t OS_EventGroupWait(EventGroupType *groupPt, uint32_t mask, uint32_t options);
+
+// ******** OS_EventGroupWait_Timeout ************
+// like OS_EventGroupWait, giving up after timeout ms
+// input:  pointer to an event group
+//         flags to wait for, not 0
+//         EVENT_WAITALL, EVENT_CLEAR or both, 0 for neither
+//         timeout in ms, 0 never blocks
+// output: flags of the group when the wait was satisfied, 0 if the wait timed out
+uint32_t OS_EventGroupWait_Timeout(EventGroupType *groupPt, uint32_t mask, uint32_t options, uint32_t timeout);
+
 //******** OS_AddThread *************** 
 // add a foregound thread to the scheduler
 // Inputs: pointer to a void/void foreground task
 //         number of bytes allocated for its stack
-//         priority, 0 is highest, 5 is the lowest
-// Outputs: 1 if successful, 0 if this thread can not be added
-// stack size must be divisable by 8 (aligned to double word boundary)
-// In Lab 2, you can ignore both the stackSize and priority fields
-// In Lab 3, you can ignore the stackSize fields
+//         priority, 0 is highest, PRIORITY_NUM-1 is the lowest
+// Outputs: 1 if successful, 0 if this thread can not be added or the priority is out of range
+// stack size is rounded up to a multiple of 8 (aligned to double word boundary),
+//   at least 128 bytes, and carved out of the shared stack arena
+// a thread that uses floating point needs 136 more bytes, a switch saves its FP registers too
 int OS_AddThread(void(*task)(void), 
    uint32_t stackSize, uint32_t priority);
 
+//******** OS_StackStats *************** 
+// measure the stack of a thread
+// Inputs: thread ID
+//         pointer to the stats to fill in
+// Outputs: 1 if successful, 0 if there is no thread with this ID
+int OS_StackStats(uint32_t id, StackStatsType* stats);
+
+//******** OS_ThreadStats *************** 
+// report where the CPU time of a thread went
+// Inputs: thread ID
+//         pointer to the stats to fill in
+// Outputs: 1 if successful, 0 if there is no thread with this ID
+int OS_ThreadStats(uint32_t id, ThreadStatsType* stats);
+
 //******** OS_Id *************** 
 // returns the thread ID for the currently running thread
 // Inputs: none
@@ -129,14 +432,82 @@ uint32_t OS_Id(void);
 // This task can not spin, block, loop, sleep, or kill
 // This task can call OS_Signal  OS_bSignal   OS_AddThread
 // This task does not have a Thread ID
-// In lab 2, this command will be called 0 or 1 times
-// In lab 2, the priority field can be ignored
-// In lab 3, this command will be called 0 1 or 2 times
-// In lab 3, there will be up to four background threads, and this priority field 
-//           determines the relative priority of these four threads
+// Up to PERIODIC_NUM tasks share WTIMER0A, which is set to time out at the next release
+// Tasks released at the same time run in priority order, the WTIMER0A interrupt
+// takes the highest priority of all the periodic tasks
+// The period must be less than 2^31 bus cycles, about 26 s
 int OS_AddPeriodicThread(void(*task)(void), 
    uint32_t period, uint32_t priority);
 
+//******** OS_PeriodicStats *************** 
+// report the release timing of a periodic task
+// Inputs: index of the task, 0 for the first one added with OS_AddPeriodicThread
+//         pointer to the stats to fill in
+// Outputs: 1 if successful, 0 if there is no task with this index
+int OS_PeriodicStats(uint32_t index, PeriodicStatsType* stats);
+
+//******** OS_SchedulingMode *************** 
+// select how real-time threads are admitted and ordered
+// Inputs: SCHED_PRIORITY, SCHED_DM or SCHED_EDF
+// Outputs: 1 if successful, 0 if real-time threads have already been added
+// Threads added with OS_AddThread keep their fixed priority in every mode
+int OS_SchedulingMode(uint32_t mode);
+
+//******** OS_AddRealTimeThread *************** 
+// add a foreground thread that runs one job per period at REALTIME_PRIORITY
+// Inputs: pointer to a void/void foreground task
+//         number of bytes allocated for its stack
+//         period in ms
+//         worst case execution time of one job in 12.5ns units, OS_ThreadStats helps measure it
+//         deadline in ms after each release, no longer than the period
+// Outputs: 1 if successful, 0 if the thread can not be added or would fail the admission test
+// The first job is released right away, the task ends each job with OS_NextPeriod
+// SCHED_DM admits while the sum of wcet/deadline stays under n(2^(1/n)-1) for n threads,
+// SCHED_EDF while it stays at or under 1
+int OS_AddRealTimeThread(void(*task)(void), uint32_t stackSize,
+   uint32_t period, uint32_t wcet, uint32_t deadline);
+
+//******** OS_NextPeriod *************** 
+// finish the current job of a real-time thread and sleep until the next release
+// Inputs: none
+// Outputs: none
+// A job finishing at or after its deadline counts as a miss, a job more than a period
+// late skips the releases it missed and counts each of them as a miss too
+// Does nothing in a thread that is not real-time
+void OS_NextPeriod(void);
+
+//******** OS_SoftTimerInit *************** 
+// set up a stopped software timer
+// Inputs: pointer to the timer
+//         function to call when the timer expires
+//         argument handed to the function
+// Outputs: none
+// The callback runs in the timer daemon thread at TIMERDAEMON_PRIORITY, one callback at a time,
+// so it should be short and should not block
+void OS_SoftTimerInit(SoftTimerType* timer, void (*callback)(void*), void* arg);
+
+//******** OS_SoftTimerStart *************** 
+// start a software timer, or restart it if it is already running
+// Inputs: pointer to the timer
+//         ms until it first expires, at least 1
+//         ms between later expiries, 0 for a one-shot timer
+// Outputs: none
+// Can be called from threads, ISRs and timer callbacks
+void OS_SoftTimerStart(SoftTimerType* timer, uint32_t delay, uint32_t period);
+
+//******** OS_SoftTimerStop *************** 
+// stop a software timer, its callback won't be called until it is started again
+// Inputs: pointer to the timer
+// Outputs: none
+// Can be called from threads, ISRs and timer callbacks
+void OS_SoftTimerStop(SoftTimerType* timer);
+
+//******** OS_SoftTimerActive *************** 
+// check whether a software timer is running
+// Inputs: pointer to the timer
+// Outputs: true until a one-shot timer expires or the timer is stopped
+bool OS_SoftTimerActive(SoftTimerType* timer);
+
 //******** OS_AddSW1Task *************** 
 // add a background task to run whenever the SW1 (PF4) button is pushed
 // Inputs: pointer to a void/void background function
@@ -175,12 +546,94 @@ int OS_AddSW2Task(void(*task)(void), uint32_t priority);
 // OS_Sleep(0) implements cooperative multitasking
 void OS_Sleep(uint32_t sleepTime); 
 
+// ******** OS_Idle ************
+// wait in low power mode for the next interrupt
+// called in a loop by the lowest priority idle thread
+// First returns the memory of killed threads and finished processes, one at a time
+// In tickless mode, when no other thread can run, the periodic ticks are stopped
+//   until the first sleeping thread or software timer is due
+// input:  none
+// output: none
+void OS_Idle(void);
+
+// ******** OS_Exit ************
+// end the currently running thread with an exit code, release its TCB and stack
+// mutexes it still holds are handed on, threads in OS_Join for it are woken with the exit code
+// the stack, and the segments of a process whose last thread this is, are freed later by OS_Idle
+// A fault in a thread ends it the same way, with FAULT_EXITCODE
+// input:  exit code, FAULT_EXITCODE restarts the thread if its restart policy allows
+// output: none
+void OS_Exit(int32_t exitCode);
+
 // ******** OS_Kill ************
 // kill the currently running thread, release its TCB and stack
+// same as OS_Exit(0)
 // input:  none
 // output: none
 void OS_Kill(void); 
 
+//******** OS_Join *************** 
+// wait for a thread to end
+// Inputs: thread ID
+//         where to put the exit code of the thread, NULL if it is not needed
+// Outputs: 1 if successful, 0 if there is no thread with this ID or it is the calling thread
+// A thread restarted after a fault has not ended, OS_Join goes on waiting for the restarted thread
+// Once the TCB of an ended thread has been reused, its ID is no longer found
+int OS_Join(uint32_t id, int32_t *exitCode);
+
+//******** OS_SetRestartPolicy *************** 
+// have a thread started over when it ends on a fault
+// Inputs: thread ID
+//         restarts allowed within one window, 0 turns restarting off
+//         window in ms
+// Outputs: 1 if successful, 0 if there is no running thread with this ID
+// The timer daemon restarts the thread on its own stack once it has been switched out, running
+// its task from the top and keeping its ID, priority, real-time parameters and restart policy.
+// Once limit restarts have happened within one window the next fault ends the thread for good,
+// and OS_Join returns FAULT_EXITCODE. So does a real-time thread that no longer passes the
+// admission test, which also leaves a FAULT_RESTARTFAILED record for OS_FaultRecord.
+// The restarts counted so far are kept, so a thread can set its own policy each time it starts
+int OS_SetRestartPolicy(uint32_t id, uint32_t limit, uint32_t window);
+
+//******** OS_FaultRecord *************** 
+// read back one of the last FAULTRECORD_NUM faults
+// A thread that faults is ended with FAULT_EXITCODE, the rest of the system keeps running.
+// Threads of a process run unprivileged and the MPU limits them to flash, their own
+// segments and their own stack, so a wild pointer faults instead of corrupting the kernel
+// Inputs: 0 for the newest fault, 1 for the one before, ...
+//         pointer to the record to fill in
+// Outputs: 1 if successful, 0 if there is no such fault
+int OS_FaultRecord(uint32_t index, FaultRecordType* record);
+
+//******** OS_MpuStats *************** 
+// report what loading the MPU regions of process threads has cost the context switches
+// Inputs: pointer to the stats to fill in
+// Outputs: none
+void OS_MpuStats(MpuStatsType* stats);
+
+// ******** OS_ProcessAccess ************
+// Check that the thread making a system call could reach memory itself
+// The system calls check the pointers a process hands the kernel with it, the kernel runs
+// privileged and would otherwise read or write wherever they point
+// Inputs:  address, size in bytes, true if the memory is written
+// Outputs: 1 if the caller is not a process thread, or all size bytes lie in its stack,
+//          its text or data segment, or in flash for memory that is only read
+//          0 otherwise
+int OS_ProcessAccess(const void* address, uint32_t size, bool write);
+
+// ******** OS_ProcessStringAccess ************
+// OS_ProcessAccess for a string the kernel reads up to its terminating 0
+// Inputs:  string
+// Outputs: 1 if the caller could read all of the string including the 0, 0 otherwise
+int OS_ProcessStringAccess(const char* string);
+
+// ******** OS_ProcessCodeAccess ************
+// Check that code the kernel would start for the thread making a system call is its own
+// Inputs:  function
+// Outputs: 1 if the caller is not a process thread, or the function starts in its text segment,
+//          0 otherwise
+int OS_ProcessCodeAccess(void(*function)(void));
+
 // ******** OS_Suspend ************
 // suspend execution of currently running thread
 // scheduler will choose another thread to execute
@@ -199,11 +652,8 @@ void OS_UnLockScheduler(unsigned long previous);
 // Initialize the Fifo to be empty
 // Inputs: size
 // Outputs: none 
-// In Lab 2, you can ignore the size field
-// In Lab 3, you should implement the user-defined fifo size
-// In Lab 3, you can put whatever restrictions you want on size
-//    e.g., 4 to 64 elements
-//    e.g., must be a power of 2,4,8,16,32,64,128
+// size is rounded down to a power of 2 and limited to 64 elements
+// the Fifo is a ring, so there must be one producer and one consumer
 void OS_Fifo_Init(uint32_t size);
 
 // ******** OS_Fifo_Put ************
@@ -212,8 +662,9 @@ void OS_Fifo_Init(uint32_t size);
 // Inputs:  data
 // Outputs: true if data is properly saved,
 //          false if data not saved, because it was full
-// Since this is called by interrupt handlers 
-//  this function can not disable or enable interrupts
+// Since this is called by interrupt handlers and threads alike,
+//  any number of producers may call it, it only saves and restores the interrupt state
+//  around the put, a single producer stream should use OS_RingPut instead
 int OS_Fifo_Put(uint32_t data);  
 
 // ******** OS_Fifo_Get ************
@@ -223,6 +674,14 @@ int OS_Fifo_Put(uint32_t data);
 // Outputs: data 
 uint32_t OS_Fifo_Get(void);
 
+// ******** OS_Fifo_Get_Timeout ************
+// Remove one data sample from the Fifo, giving up if it stays empty
+// Called in foreground
+// Inputs:  pointer to receive the data
+//          timeout in ms, 0 never blocks
+// Outputs: 1 if data was removed, 0 if the wait timed out
+int OS_Fifo_Get_Timeout(uint32_t* data, uint32_t timeout);
+
 // ******** OS_Fifo_Size ************
 // Check the status of the Fifo
 // Inputs: none
@@ -232,6 +691,106 @@ uint32_t OS_Fifo_Get(void);
 //          zero or less than zero if a call to OS_Fifo_Get will spin or block
 int32_t OS_Fifo_Size(void);
 
+// ******** OS_FifoCreate ************
+// Create a FIFO on top of a caller supplied buffer
+// Inputs:  buffer of size*elemSize bytes, word aligned when elemSize is 4
+//          size, number of elements, must be a power of 2
+//          elemSize, number of bytes in each element
+// Outputs: the new FIFO, NULL if size is not a power of 2 or no FIFO is left
+FifoType* OS_FifoCreate(void* buffer, uint32_t size, uint32_t elemSize);
+
+// ******** OS_FifoValid ************
+// Check a FIFO handle
+// Inputs:  FIFO
+// Outputs: 1 if it is a FIFO OS_FifoCreate handed out, 0 otherwise
+int OS_FifoValid(FifoType* fifo);
+
+// ******** OS_FifoPut ************
+// Enter one element into the FIFO
+// Can be called from the background, so no waiting
+// Inputs:  FIFO, pointer to elemSize bytes of data
+// Outputs: true if data is properly saved,
+//          false if data not saved, because it was full
+int OS_FifoPut(FifoType* fifo, const void* data);
+
+// ******** OS_FifoGet ************
+// Remove one element from the FIFO
+// Called in foreground, will block if empty
+// Inputs:  FIFO, pointer to elemSize bytes to receive the data
+// Outputs: none
+void OS_FifoGet(FifoType* fifo, void* data);
+
+// ******** OS_FifoPutBulk ************
+// Enter up to count elements into the FIFO, waking a consumer once per element
+// Can be called from the background, so no waiting
+// Inputs:  FIFO, pointer to count*elemSize bytes of data, count
+// Outputs: number of elements saved, less than count if the FIFO filled up
+uint32_t OS_FifoPutBulk(FifoType* fifo, const void* data, uint32_t count);
+
+// ******** OS_FifoGetBulk ************
+// Remove between 1 and maxCount elements from the FIFO
+// Called in foreground, will block until at least one element is available
+// Inputs:  FIFO, pointer to maxCount*elemSize bytes to receive the data, maxCount
+// Outputs: number of elements removed
+uint32_t OS_FifoGetBulk(FifoType* fifo, void* data, uint32_t maxCount);
+
+// ******** OS_FifoSize ************
+// Check the status of the FIFO
+// Inputs:  FIFO
+// Outputs: returns the number of elements in the FIFO
+int32_t OS_FifoSize(FifoType* fifo);
+
+// ******** OS_RingInit ************
+// Initialize a single producer, single consumer ring to be empty
+// Inputs:  ring, buffer of size words
+//          size, number of elements, must be a power of 2
+//          watermark, number of buffered elements that wakes a blocked consumer, 1 to size
+// Outputs: 1 if successful, 0 if size or watermark is invalid
+int OS_RingInit(RingType* ring, uint32_t* buffer, uint32_t size, uint32_t watermark);
+
+// ******** OS_RingCreate ************
+// Initialize a ring the kernel keeps over a caller supplied buffer, for a process
+// Inputs:  buffer of size words
+//          size, number of elements, must be a power of 2
+//          watermark, number of buffered elements that wakes a blocked consumer, 1 to size
+// Outputs: the ring, NULL if size or watermark is invalid or no ring is left
+RingType* OS_RingCreate(uint32_t* buffer, uint32_t size, uint32_t watermark);
+
+// ******** OS_RingValid ************
+// Check a ring handle
+// Inputs:  ring
+// Outputs: 1 if OS_RingCreate handed it out, to the calling process for a process thread, 0 otherwise
+int OS_RingValid(RingType* ring);
+
+// ******** OS_RingPut ************
+// Enter one sample into the ring, only ever called by the one producer
+// Can be called from the background, so no waiting, interrupts are only
+//   disabled to wake the consumer when the watermark is reached
+// Inputs:  ring, data
+// Outputs: true if data is properly saved,
+//          false if data not saved, because it was full
+int OS_RingPut(RingType* ring, uint32_t data);
+
+// ******** OS_RingGet ************
+// Remove one sample from the ring, only ever called by the one consumer
+// Called in foreground, blocks while the ring is empty until the watermark is reached
+// Inputs:  ring
+// Outputs: data
+uint32_t OS_RingGet(RingType* ring);
+
+// ******** OS_RingGetBulk ************
+// Remove between 1 and maxCount samples from the ring, only ever called by the one consumer
+// Called in foreground, blocks while the ring is empty until the watermark is reached
+// Inputs:  ring, buffer of maxCount words, maxCount
+// Outputs: number of samples removed
+uint32_t OS_RingGetBulk(RingType* ring, uint32_t* data, uint32_t maxCount);
+
+// ******** OS_RingSize ************
+// Check the status of the ring
+// Inputs:  ring
+// Outputs: returns the number of samples in the ring
+int32_t OS_RingSize(RingType* ring);
+
 // ******** OS_MailBox_Init ************
 // Initialize communication channel
 // Inputs:  none
@@ -254,6 +813,85 @@ void OS_MailBox_Send(uint32_t data);
 // It will spin/block if the MailBox is empty 
 uint32_t OS_MailBox_Recv(void);
 
+// ******** OS_MailBox_Recv_Timeout ************
+// remove mail from the MailBox, giving up if it stays empty
+// Inputs:  pointer to receive the data
+//          timeout in ms, 0 never blocks
+// Outputs: 1 if mail was received, 0 if the wait timed out
+// This function will be called from a foreground thread
+int OS_MailBox_Recv_Timeout(uint32_t* data, uint32_t timeout);
+
+// ******** OS_MsgQueueInit ************
+// Initialize a message queue to be empty
+// Inputs:  queue, buffer of capacity*msgSize bytes
+//          capacity, number of messages the queue holds
+//          msgSize, number of bytes in each message
+// Outputs: none
+void OS_MsgQueueInit(MsgQueueType* queue, void* buffer, uint32_t capacity, uint32_t msgSize);
+
+// ******** OS_MsgQueueCreate ************
+// Initialize a message queue the kernel keeps over a caller supplied buffer, for a process
+// Inputs:  buffer of capacity*msgSize bytes
+//          capacity, number of messages the queue holds, not 0
+//          msgSize, number of bytes in each message, not 0
+// Outputs: the queue, NULL if capacity or msgSize is 0 or no queue is left
+MsgQueueType* OS_MsgQueueCreate(void* buffer, uint32_t capacity, uint32_t msgSize);
+
+// ******** OS_MsgQueueValid ************
+// Check a message queue handle
+// Inputs:  queue
+// Outputs: 1 if OS_MsgQueueCreate handed it out, to the calling process for a process thread, 0 otherwise
+int OS_MsgQueueValid(MsgQueueType* queue);
+
+// ******** OS_MsgQueueSend ************
+// Copy a message into the queue
+// Called in foreground, will block while the queue is full
+// Inputs:  queue, pointer to msgSize bytes
+// Outputs: none
+void OS_MsgQueueSend(MsgQueueType* queue, const void* msg);
+
+// ******** OS_MsgQueueRecv ************
+// Copy the oldest message out of the queue
+// Called in foreground, will block while the queue is empty
+// Inputs:  queue, pointer to msgSize bytes to receive the message
+// Outputs: none
+void OS_MsgQueueRecv(MsgQueueType* queue, void* msg);
+
+// ******** OS_MsgQueueSendTimeout ************
+// Copy a message into the queue, giving up if the queue stays full
+// Called in foreground
+// Inputs:  queue, pointer to msgSize bytes
+//          timeout in ms, 0 never blocks
+// Outputs: 1 if the message was sent, 0 if the wait timed out
+int OS_MsgQueueSendTimeout(MsgQueueType* queue, const void* msg, uint32_t timeout);
+
+// ******** OS_MsgQueueRecvTimeout ************
+// Copy the oldest message out of the queue, giving up if the queue stays empty
+// Called in foreground
+// Inputs:  queue, pointer to msgSize bytes to receive the message
+//          timeout in ms, 0 never blocks
+// Outputs: 1 if a message was received, 0 if the wait timed out
+int OS_MsgQueueRecvTimeout(MsgQueueType* queue, void* msg, uint32_t timeout);
+
+// ******** OS_Time64 ************
+// return the free-running clock
+// Inputs:  none
+// Outputs: time since OS_Init in 12.5ns units
+// Never wraps in practice, 2^64 bus cycles are over 7000 years
+uint64_t OS_Time64(void);
+
+// ******** OS_TimeUs ************
+// return the free-running clock in usec
+// Inputs:  none
+// Outputs: time since OS_Init in usec
+uint64_t OS_TimeUs(void);
+
+// ******** OS_TimeNs ************
+// return the free-running clock in nsec
+// Inputs:  none
+// Outputs: time since OS_Init in nsec, a multiple of 12.5ns rounded down
+uint64_t OS_TimeNs(void);
+
 // ******** OS_Time ************
 // return the system time 
 // Inputs:  none
@@ -261,6 +899,7 @@ uint32_t OS_MailBox_Recv(void);
 // The time resolution should be less than or equal to 1us, and the precision 32 bits
 // It is ok to change the resolution and precision of this function as long as 
 //   this function and OS_TimeDifference have the same resolution and precision 
+// The low word of OS_Time64, it wraps every 53.7 s
 uint32_t OS_Time(void);
 
 // ******** OS_TimeDifference ************
@@ -270,6 +909,7 @@ uint32_t OS_Time(void);
 // The time resolution should be less than or equal to 1us, and the precision at least 12 bits
 // It is ok to change the resolution and precision of this function as long as 
 //   this function and OS_Time have the same resolution and precision 
+// Correct across a wrap of OS_Time, as long as stop is less than 53.7 s after start
 uint32_t OS_TimeDifference(uint32_t start, uint32_t stop);
 
 // ******** OS_ClearMsTime ************
@@ -285,6 +925,7 @@ void OS_ClearMsTime(void);
 // Outputs: time in ms units
 // You are free to select the time resolution for this function
 // It is ok to make the resolution to match the first call to OS_AddPeriodicThread
+// Counted from the free-running clock, so it runs for 49.7 days after OS_ClearMsTime
 uint32_t OS_MsTime(void);
 
 //******** OS_Launch *************** 
@@ -292,6 +933,8 @@ uint32_t OS_MsTime(void);
 // Inputs: number of 12.5ns clock cycles for each time slice
 //         you may select the units of this parameter
 // Outputs: none (does not return)
+//          returns without starting anything if the timer daemon thread can't be added,
+//          because every thread or the stack space is used up
 // In Lab 2, you can ignore the theTimeSlice field
 // In Lab 3, you should implement the user-defined TimeSlice field
 // It is ok to limit the range of theTimeSlice to match the 24-bit SysTick
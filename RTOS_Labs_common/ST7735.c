@@ -532,7 +532,7 @@ static uint8_t Rotation;           // 0 to 3
 static enum initRFlags TabColor;
 static int16_t _width = ST7735_TFTWIDTH;   // this could probably be a constant, except it is used in Adafruit_GFX and depends on image rotation
 static int16_t _height = ST7735_TFTHEIGHT;
-Sema4Type LCDFree;       // used for mutual exclusion
+MutexType LCDFree;       // used for mutual exclusion
 
 
 // The Data/Command pin must be valid when the eighth bit is
@@ -828,7 +828,7 @@ void ST7735_InitB(void) {
   ST7735_SetCursor(0,0);
   StTextColor = ST7735_YELLOW;
   ST7735_FillScreen(0);                 // set screen to black
-  OS_InitSemaphore(&LCDFree,1);  // means LCD free
+  OS_InitMutex(&LCDFree);  // means LCD free
 }
 
 
@@ -857,7 +857,7 @@ void ST7735_InitR(enum initRFlags option) {
   ST7735_SetCursor(0,0);
   StTextColor = ST7735_YELLOW;
   ST7735_FillScreen(0);                 // set screen to black
-  OS_InitSemaphore(&LCDFree,1);  // means LCD free
+  OS_InitMutex(&LCDFree);  // means LCD free
 }
 
 
@@ -1424,7 +1424,7 @@ static void clearMessageLine(uint16_t x, uint16_t y){
 
 void ST7735_Message(uint32_t  d, uint32_t  l, char *pt, int32_t value){
 	
-	OS_bWait(&LCDFree);
+	OS_MutexLock(&LCDFree);
 	char* ptDupMesgLen = pt;
 	uint32_t messageLength = 0;
 	while(*ptDupMesgLen){
@@ -1466,7 +1466,7 @@ void ST7735_Message(uint32_t  d, uint32_t  l, char *pt, int32_t value){
 	}
 	
 	//ST7735_DrawFastHLine(0, _height/2, _width, ST7735_RED);
-	OS_bSignal(&LCDFree);
+	OS_MutexUnlock(&LCDFree);
 }
 
 
@@ -0,0 +1,361 @@
+// *************Syscall.c**************
+// System call table of the OS, indexed by the SVC number, see Syscall.h
+// SVC_Handler in osasm.s bounds checks the number against SyscallTableSize
+// and returns into the entry, a NULL entry makes the call return -1
+// For a process thread it first has SyscallArgsValid check the pointer arguments,
+// with the entry of SyscallArgChecks for the number
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "../RTOS_Labs_common/OS.h"
+#include "../RTOS_Labs_common/ST7735.h"
+#include "../RTOS_Labs_common/Syscall.h"
+
+// eFile is only reachable if it is linked in, a weak reference to a missing
+// function resolves to NULL instead of failing the link
+#ifdef __CC_ARM
+#define WEAK_REFERENCE	__weak
+#else
+#define WEAK_REFERENCE	__attribute__((weak))
+#endif
+WEAK_REFERENCE int eFile_Init(void);
+WEAK_REFERENCE int eFile_Format(void);
+WEAK_REFERENCE int eFile_Mount(void);
+WEAK_REFERENCE int eFile_Create(const char name[]);
+WEAK_REFERENCE int eFile_WOpen(const char name[]);
+WEAK_REFERENCE int eFile_Write(const char data);
+WEAK_REFERENCE int eFile_WClose(void);
+WEAK_REFERENCE int eFile_ROpen(const char name[]);
+WEAK_REFERENCE int eFile_ReadNext(char *pt);
+WEAK_REFERENCE int eFile_RClose(void);
+WEAK_REFERENCE int eFile_Delete(const char name[]);
+WEAK_REFERENCE int eFile_DOpen(const char name[]);
+WEAK_REFERENCE int eFile_DirNext(char *name[], unsigned long *size);
+WEAK_REFERENCE int eFile_DClose(void);
+WEAK_REFERENCE int eFile_Unmount(void);
+WEAK_REFERENCE int eFile_WriteBuffer(const char data[], unsigned long size);
+WEAK_REFERENCE int eFile_ReadBuffer(char data[], unsigned long size, unsigned long *count);
+
+typedef void (*SyscallType)(void);
+
+static uint32_t syscallVersion(void){
+	return SYSCALL_VERSION;
+}
+
+const SyscallType SyscallTable[SYSCALL_NUM] = {
+	[SYS_OS_ID]											= (SyscallType)&OS_Id,
+	[SYS_OS_KILL]										= (SyscallType)&OS_Kill,
+	[SYS_OS_SLEEP]									= (SyscallType)&OS_Sleep,
+	[SYS_OS_TIME]										= (SyscallType)&OS_Time,
+	[SYS_OS_ADDTHREAD]							= (SyscallType)&OS_AddThread,
+	[SYS_OS_SYSCALLVERSION]					= (SyscallType)&syscallVersion,
+
+	[SYS_OS_INITSEMAPHORE]					= (SyscallType)&OS_InitSemaphore,
+	[SYS_OS_WAIT]										= (SyscallType)&OS_Wait,
+	[SYS_OS_SIGNAL]									= (SyscallType)&OS_Signal,
+	[SYS_OS_BWAIT]									= (SyscallType)&OS_bWait,
+	[SYS_OS_BSIGNAL]								= (SyscallType)&OS_bSignal,
+	[SYS_OS_WAIT_TIMEOUT]						= (SyscallType)&OS_Wait_Timeout,
+	[SYS_OS_BWAIT_TIMEOUT]					= (SyscallType)&OS_bWait_Timeout,
+	[SYS_OS_INITMUTEX]							= (SyscallType)&OS_InitMutex,
+	[SYS_OS_MUTEXLOCK]							= (SyscallType)&OS_MutexLock,
+	[SYS_OS_MUTEXUNLOCK]						= (SyscallType)&OS_MutexUnlock,
+	[SYS_OS_EVENTGROUPINIT]					= (SyscallType)&OS_EventGroupInit,
+	[SYS_OS_EVENTGROUPSET]					= (SyscallType)&OS_EventGroupSet,
+	[SYS_OS_EVENTGROUPCLEAR]				= (SyscallType)&OS_EventGroupClear,
+	[SYS_OS_EVENTGROUPGET]					= (SyscallType)&OS_EventGroupGet,
+	[SYS_OS_EVENTGROUPWAIT]					= (SyscallType)&OS_EventGroupWait,
+	[SYS_OS_EVENTGROUPWAIT_TIMEOUT]	= (SyscallType)&OS_EventGroupWait_Timeout,
+
+	[SYS_OS_STACKSTATS]							= (SyscallType)&OS_StackStats,
+	[SYS_OS_THREADSTATS]						= (SyscallType)&OS_ThreadStats,
+	[SYS_OS_NEXTPERIOD]							= (SyscallType)&OS_NextPeriod,
+	[SYS_OS_SUSPEND]								= (SyscallType)&OS_Suspend,
+
+	[SYS_OS_FIFO_INIT]							= (SyscallType)&OS_Fifo_Init,
+	[SYS_OS_FIFO_PUT]								= (SyscallType)&OS_Fifo_Put,
+	[SYS_OS_FIFO_GET]								= (SyscallType)&OS_Fifo_Get,
+	[SYS_OS_FIFO_GET_TIMEOUT]				= (SyscallType)&OS_Fifo_Get_Timeout,
+	[SYS_OS_FIFO_SIZE]							= (SyscallType)&OS_Fifo_Size,
+	[SYS_OS_FIFOCREATE]							= (SyscallType)&OS_FifoCreate,
+	[SYS_OS_FIFOPUT]								= (SyscallType)&OS_FifoPut,
+	[SYS_OS_FIFOGET]								= (SyscallType)&OS_FifoGet,
+	[SYS_OS_FIFOPUTBULK]						= (SyscallType)&OS_FifoPutBulk,
+	[SYS_OS_FIFOGETBULK]						= (SyscallType)&OS_FifoGetBulk,
+	[SYS_OS_FIFOSIZE]								= (SyscallType)&OS_FifoSize,
+	[SYS_OS_RINGINIT]								= (SyscallType)&OS_RingInit,
+	[SYS_OS_RINGPUT]								= (SyscallType)&OS_RingPut,
+	[SYS_OS_RINGGET]								= (SyscallType)&OS_RingGet,
+	[SYS_OS_RINGGETBULK]						= (SyscallType)&OS_RingGetBulk,
+	[SYS_OS_RINGSIZE]								= (SyscallType)&OS_RingSize,
+	[SYS_OS_MAILBOX_INIT]						= (SyscallType)&OS_MailBox_Init,
+	[SYS_OS_MAILBOX_SEND]						= (SyscallType)&OS_MailBox_Send,
+	[SYS_OS_MAILBOX_RECV]						= (SyscallType)&OS_MailBox_Recv,
+	[SYS_OS_MAILBOX_RECV_TIMEOUT]		= (SyscallType)&OS_MailBox_Recv_Timeout,
+	[SYS_OS_MSGQUEUEINIT]						= (SyscallType)&OS_MsgQueueInit,
+	[SYS_OS_MSGQUEUESEND]						= (SyscallType)&OS_MsgQueueSend,
+	[SYS_OS_MSGQUEUERECV]						= (SyscallType)&OS_MsgQueueRecv,
+	[SYS_OS_MSGQUEUESENDTIMEOUT]		= (SyscallType)&OS_MsgQueueSendTimeout,
+	[SYS_OS_MSGQUEUERECVTIMEOUT]		= (SyscallType)&OS_MsgQueueRecvTimeout,
+
+	[SYS_OS_TIME64]									= (SyscallType)&OS_Time64,
+	[SYS_OS_TIMEUS]									= (SyscallType)&OS_TimeUs,
+	[SYS_OS_TIMENS]									= (SyscallType)&OS_TimeNs,
+	[SYS_OS_TIMEDIFFERENCE]					= (SyscallType)&OS_TimeDifference,
+	[SYS_OS_CLEARMSTIME]						= (SyscallType)&OS_ClearMsTime,
+	[SYS_OS_MSTIME]									= (SyscallType)&OS_MsTime,
+	[SYS_OS_PERIODICSTATS]					= (SyscallType)&OS_PeriodicStats,
+
+	[SYS_EFILE_INIT]								= (SyscallType)&eFile_Init,
+	[SYS_EFILE_FORMAT]							= (SyscallType)&eFile_Format,
+	[SYS_EFILE_MOUNT]								= (SyscallType)&eFile_Mount,
+	[SYS_EFILE_CREATE]							= (SyscallType)&eFile_Create,
+	[SYS_EFILE_WOPEN]								= (SyscallType)&eFile_WOpen,
+	[SYS_EFILE_WRITE]								= (SyscallType)&eFile_Write,
+	[SYS_EFILE_WCLOSE]							= (SyscallType)&eFile_WClose,
+	[SYS_EFILE_ROPEN]								= (SyscallType)&eFile_ROpen,
+	[SYS_EFILE_READNEXT]						= (SyscallType)&eFile_ReadNext,
+	[SYS_EFILE_RCLOSE]							= (SyscallType)&eFile_RClose,
+	[SYS_EFILE_DELETE]							= (SyscallType)&eFile_Delete,
+	[SYS_EFILE_DOPEN]								= (SyscallType)&eFile_DOpen,
+	[SYS_EFILE_DIRNEXT]							= (SyscallType)&eFile_DirNext,
+	[SYS_EFILE_DCLOSE]							= (SyscallType)&eFile_DClose,
+	[SYS_EFILE_UNMOUNT]							= (SyscallType)&eFile_Unmount,
+
+	[SYS_ST7735_MESSAGE]						= (SyscallType)&ST7735_Message,
+	
+	[SYS_OS_EXIT]										= (SyscallType)&OS_Exit,
+	[SYS_OS_JOIN]										= (SyscallType)&OS_Join,
+	[SYS_OS_SETRESTARTPOLICY]				= (SyscallType)&OS_SetRestartPolicy,
+	
+	[SYS_EFILE_WRITEBUFFER]					= (SyscallType)&eFile_WriteBuffer,
+	[SYS_EFILE_READBUFFER]					= (SyscallType)&eFile_ReadBuffer,
+
+	[SYS_OS_SEMA4CREATE]						= (SyscallType)&OS_Sema4Create,
+	[SYS_OS_MUTEXCREATE]						= (SyscallType)&OS_MutexCreate,
+	[SYS_OS_EVENTGROUPCREATE]				= (SyscallType)&OS_EventGroupCreate,
+	[SYS_OS_RINGCREATE]							= (SyscallType)&OS_RingCreate,
+	[SYS_OS_MSGQUEUECREATE]					= (SyscallType)&OS_MsgQueueCreate,
+};
+const uint32_t SyscallTableSize = SYSCALL_NUM;
+
+// the pointer arguments of a call, args are the caller's R0-R3
+// returns false if one of them reaches outside the memory of the calling process
+typedef bool (*SyscallArgCheckType)(const uintptr_t args[4]);
+
+// size bytes at address, sizes worked out from counts can't wrap
+static bool reachable(uintptr_t address, uint64_t size, bool write){
+	return size <= 0xFFFFFFFF && OS_ProcessAccess((const void*)address, (uint32_t)size, write);
+}
+
+// the Init calls, a process would hand the kernel an object in its own memory,
+// where it could forge the links and pointers the kernel follows
+static bool processRefused(const uintptr_t args[4]){
+	return false;
+}
+
+// semaphores, mutexes and event groups have to be ones the kernel keeps for the calling process
+static bool sema4Arg(const uintptr_t args[4]){
+	return OS_Sema4Valid((Sema4Type*)args[0]);
+}
+
+static bool mutexArg(const uintptr_t args[4]){
+	return OS_MutexValid((MutexType*)args[0]);
+}
+
+static bool eventGroupArg(const uintptr_t args[4]){
+	return OS_EventGroupValid((EventGroupType*)args[0]);
+}
+
+static bool stackStatsArgs(const uintptr_t args[4]){
+	return reachable(args[1], sizeof(StackStatsType), true);
+}
+
+static bool threadStatsArgs(const uintptr_t args[4]){
+	return reachable(args[1], sizeof(ThreadStatsType), true);
+}
+
+static bool periodicStatsArgs(const uintptr_t args[4]){
+	return reachable(args[1], sizeof(PeriodicStatsType), true);
+}
+
+// the word a Get_Timeout or Recv_Timeout receives into
+static bool dataArg(const uintptr_t args[4]){
+	return reachable(args[0], sizeof(uint32_t), true);
+}
+
+// OS_FifoCreate(buffer, size, elemSize)
+static bool fifoCreateArgs(const uintptr_t args[4]){
+	return reachable(args[0], (uint64_t)args[1]*args[2], true);
+}
+
+// a FIFO is the kernel's, but the buffer it moves the data through has to be the caller's
+static bool fifoArg(const uintptr_t args[4]){
+	FifoType* fifo = (FifoType*)args[0];
+	return OS_FifoValid(fifo) && reachable((uintptr_t)fifo->buffer, (uint64_t)(fifo->mask + 1)*fifo->elemSize, true);
+}
+
+// OS_FifoPut(fifo, data), OS_FifoGet(fifo, data)
+static bool fifoPutArgs(const uintptr_t args[4]){
+	return fifoArg(args) && reachable(args[1], ((FifoType*)args[0])->elemSize, false);
+}
+
+static bool fifoGetArgs(const uintptr_t args[4]){
+	return fifoArg(args) && reachable(args[1], ((FifoType*)args[0])->elemSize, true);
+}
+
+// OS_FifoPutBulk(fifo, data, count), OS_FifoGetBulk(fifo, data, maxCount)
+static bool fifoPutBulkArgs(const uintptr_t args[4]){
+	return fifoArg(args) && reachable(args[1], (uint64_t)args[2]*((FifoType*)args[0])->elemSize, false);
+}
+
+static bool fifoGetBulkArgs(const uintptr_t args[4]){
+	return fifoArg(args) && reachable(args[1], (uint64_t)args[2]*((FifoType*)args[0])->elemSize, true);
+}
+
+// OS_RingCreate(buffer, size, watermark)
+static bool ringCreateArgs(const uintptr_t args[4]){
+	return reachable(args[0], (uint64_t)args[1]*sizeof(uint32_t), true);
+}
+
+// like a FIFO, a ring is the kernel's and its buffer the caller's
+static bool ringArg(const uintptr_t args[4]){
+	RingType* ring = (RingType*)args[0];
+	return OS_RingValid(ring) && reachable((uintptr_t)ring->buffer, (uint64_t)(ring->mask + 1)*sizeof(uint32_t), true);
+}
+
+// OS_RingGetBulk(ring, data, maxCount)
+static bool ringGetBulkArgs(const uintptr_t args[4]){
+	return ringArg(args) && reachable(args[1], (uint64_t)args[2]*sizeof(uint32_t), true);
+}
+
+// OS_MsgQueueCreate(buffer, capacity, msgSize)
+static bool msgQueueCreateArgs(const uintptr_t args[4]){
+	return reachable(args[0], (uint64_t)args[1]*args[2], true);
+}
+
+// so is a message queue
+static bool msgQueueArg(const uintptr_t args[4]){
+	MsgQueueType* queue = (MsgQueueType*)args[0];
+	return OS_MsgQueueValid(queue) && reachable((uintptr_t)queue->buffer, (uint64_t)queue->capacity*queue->msgSize, true);
+}
+
+// OS_MsgQueueSend(queue, msg, ...), OS_MsgQueueRecv(queue, msg, ...)
+static bool msgQueueSendArgs(const uintptr_t args[4]){
+	return msgQueueArg(args) && reachable(args[1], ((MsgQueueType*)args[0])->msgSize, false);
+}
+
+static bool msgQueueRecvArgs(const uintptr_t args[4]){
+	return msgQueueArg(args) && reachable(args[1], ((MsgQueueType*)args[0])->msgSize, true);
+}
+
+// OS_Join(id, exitCode), exitCode may be NULL
+static bool joinArgs(const uintptr_t args[4]){
+	return args[1] == 0 || reachable(args[1], sizeof(int32_t), true);
+}
+
+// a file name
+static bool nameArg(const uintptr_t args[4]){
+	return OS_ProcessStringAccess((const char*)args[0]);
+}
+
+// eFile_ReadNext(pt)
+static bool readNextArg(const uintptr_t args[4]){
+	return reachable(args[0], sizeof(char), true);
+}
+
+// eFile_DirNext(name, size)
+static bool dirNextArgs(const uintptr_t args[4]){
+	return reachable(args[0], sizeof(char*), true) && reachable(args[1], sizeof(unsigned long), true);
+}
+
+// eFile_WriteBuffer(data, size), eFile_ReadBuffer(data, size, count)
+static bool writeBufferArgs(const uintptr_t args[4]){
+	return reachable(args[0], args[1], false);
+}
+
+static bool readBufferArgs(const uintptr_t args[4]){
+	return reachable(args[0], args[1], true) && reachable(args[2], sizeof(unsigned long), true);
+}
+
+// ST7735_Message(d, l, pt, value)
+static bool messageArgs(const uintptr_t args[4]){
+	return OS_ProcessStringAccess((const char*)args[2]);
+}
+
+// OS_AddThread(task, stackSize, priority), the task has to be code of the calling process
+static bool addThreadArgs(const uintptr_t args[4]){
+	return OS_ProcessCodeAccess((void(*)(void))args[0]);
+}
+
+// NULL for calls without pointer arguments
+const SyscallArgCheckType SyscallArgChecks[SYSCALL_NUM] = {
+	[SYS_OS_ADDTHREAD]							= &addThreadArgs,
+
+	[SYS_OS_INITSEMAPHORE]					= &processRefused,
+	[SYS_OS_WAIT]										= &sema4Arg,
+	[SYS_OS_SIGNAL]									= &sema4Arg,
+	[SYS_OS_BWAIT]									= &sema4Arg,
+	[SYS_OS_BSIGNAL]								= &sema4Arg,
+	[SYS_OS_WAIT_TIMEOUT]						= &sema4Arg,
+	[SYS_OS_BWAIT_TIMEOUT]					= &sema4Arg,
+	[SYS_OS_INITMUTEX]							= &processRefused,
+	[SYS_OS_MUTEXLOCK]							= &mutexArg,
+	[SYS_OS_MUTEXUNLOCK]						= &mutexArg,
+	[SYS_OS_EVENTGROUPINIT]					= &processRefused,
+	[SYS_OS_EVENTGROUPSET]					= &eventGroupArg,
+	[SYS_OS_EVENTGROUPCLEAR]				= &eventGroupArg,
+	[SYS_OS_EVENTGROUPGET]					= &eventGroupArg,
+	[SYS_OS_EVENTGROUPWAIT]					= &eventGroupArg,
+	[SYS_OS_EVENTGROUPWAIT_TIMEOUT]	= &eventGroupArg,
+
+	[SYS_OS_STACKSTATS]							= &stackStatsArgs,
+	[SYS_OS_THREADSTATS]						= &threadStatsArgs,
+
+	[SYS_OS_FIFO_GET_TIMEOUT]				= &dataArg,
+	[SYS_OS_FIFOCREATE]							= &fifoCreateArgs,
+	[SYS_OS_FIFOPUT]								= &fifoPutArgs,
+	[SYS_OS_FIFOGET]								= &fifoGetArgs,
+	[SYS_OS_FIFOPUTBULK]						= &fifoPutBulkArgs,
+	[SYS_OS_FIFOGETBULK]						= &fifoGetBulkArgs,
+	[SYS_OS_FIFOSIZE]								= &fifoArg,
+	[SYS_OS_RINGINIT]								= &processRefused,
+	[SYS_OS_RINGPUT]								= &ringArg,
+	[SYS_OS_RINGGET]								= &ringArg,
+	[SYS_OS_RINGGETBULK]						= &ringGetBulkArgs,
+	[SYS_OS_RINGSIZE]								= &ringArg,
+	[SYS_OS_MAILBOX_RECV_TIMEOUT]		= &dataArg,
+	[SYS_OS_MSGQUEUEINIT]						= &processRefused,
+	[SYS_OS_MSGQUEUESEND]						= &msgQueueSendArgs,
+	[SYS_OS_MSGQUEUERECV]						= &msgQueueRecvArgs,
+	[SYS_OS_MSGQUEUESENDTIMEOUT]		= &msgQueueSendArgs,
+	[SYS_OS_MSGQUEUERECVTIMEOUT]		= &msgQueueRecvArgs,
+
+	[SYS_OS_PERIODICSTATS]					= &periodicStatsArgs,
+
+	[SYS_EFILE_CREATE]							= &nameArg,
+	[SYS_EFILE_WOPEN]								= &nameArg,
+	[SYS_EFILE_ROPEN]								= &nameArg,
+	[SYS_EFILE_READNEXT]						= &readNextArg,
+	[SYS_EFILE_DELETE]							= &nameArg,
+	[SYS_EFILE_DOPEN]								= &nameArg,
+	[SYS_EFILE_DIRNEXT]							= &dirNextArgs,
+
+	[SYS_ST7735_MESSAGE]						= &messageArgs,
+
+	[SYS_OS_JOIN]										= &joinArgs,
+
+	[SYS_EFILE_WRITEBUFFER]					= &writeBufferArgs,
+	[SYS_EFILE_READBUFFER]					= &readBufferArgs,
+
+	[SYS_OS_RINGCREATE]							= &ringCreateArgs,
+	[SYS_OS_MSGQUEUECREATE]					= &msgQueueCreateArgs,
+};
+
+// called by SVC_Handler for a caller running unprivileged, before it dispatches the call
+// id has been bounds checked, args are R0-R3 stacked on exception entry
+// returns false if the call must not run, it then returns -1
+bool SyscallArgsValid(uint32_t id, const uintptr_t args[4]){
+	return SyscallArgChecks[id] == NULL || SyscallArgChecks[id](args);
+}
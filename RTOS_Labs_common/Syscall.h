@@ -0,0 +1,229 @@
+// *************Syscall.h**************
+// System call ABI of the OS, for programs loaded with exec_elf
+// A loaded program reaches the kernel with SVC #number instead of linking against it.
+// Arguments go in R0-R3 like a function call, the result comes back in R0, or R0-R1 for 64 bits
+// SVC_Handler looks the number up in SyscallTable and returns into the kernel function
+// in thread mode on the caller's stack, so blocking calls block just like direct calls
+// An unknown number, or a call whose module isn't linked into this kernel, returns -1
+// So does a call from a process whose pointer arguments reach outside the process's own stack
+// and segments, or outside flash for data the call only reads, see OS_ProcessAccess
+// A process only uses the semaphores, mutexes, event groups, rings and message queues the kernel
+// keeps for it, made with the Create calls, its own memory can't hold the links the kernel follows.
+// The Init calls, and a handle of any other object or of another process, return -1 from a process
+//
+// Call numbers are only ever appended. A program built against version major.minor
+// runs on a kernel with the same major version and at least the same minor version,
+// check with SYSCALL_COMPATIBLE(SVC_OS_SyscallVersion())
+//
+// Not in the ABI: OS_Init and OS_Launch, calls with more than four arguments
+// (OS_AddProcess, OS_AddRealTimeThread), and calls whose callbacks would run outside
+// the calling process (OS_AddPeriodicThread, OS_AddSW1Task, OS_AddSW2Task, software timers)
+
+#ifndef __SYSCALL_H
+#define __SYSCALL_H  1
+#include <stdint.h>
+#include "../RTOS_Labs_common/OS.h"
+
+#define SYSCALL_VERSION_MAJOR	2
+#define SYSCALL_VERSION_MINOR	0
+#define SYSCALL_VERSION			((SYSCALL_VERSION_MAJOR << 16)|SYSCALL_VERSION_MINOR)
+// can a program built against this header run on a kernel reporting version
+#define SYSCALL_COMPATIBLE(version)	(((version) >> 16) == SYSCALL_VERSION_MAJOR && ((version)&0xFFFF) >= SYSCALL_VERSION_MINOR)
+
+// threads
+#define SYS_OS_ID											0
+#define SYS_OS_KILL										1
+#define SYS_OS_SLEEP									2
+#define SYS_OS_TIME										3
+#define SYS_OS_ADDTHREAD							4
+#define SYS_OS_SYSCALLVERSION					5
+// semaphores, mutexes and event groups
+#define SYS_OS_INITSEMAPHORE					6
+#define SYS_OS_WAIT										7
+#define SYS_OS_SIGNAL									8
+#define SYS_OS_BWAIT									9
+#define SYS_OS_BSIGNAL								10
+#define SYS_OS_WAIT_TIMEOUT						11
+#define SYS_OS_BWAIT_TIMEOUT					12
+#define SYS_OS_INITMUTEX							13
+#define SYS_OS_MUTEXLOCK							14
+#define SYS_OS_MUTEXUNLOCK						15
+#define SYS_OS_EVENTGROUPINIT					16
+#define SYS_OS_EVENTGROUPSET					17
+#define SYS_OS_EVENTGROUPCLEAR				18
+#define SYS_OS_EVENTGROUPGET					19
+#define SYS_OS_EVENTGROUPWAIT					20
+#define SYS_OS_EVENTGROUPWAIT_TIMEOUT	21
+// thread information and scheduling
+#define SYS_OS_STACKSTATS							22
+#define SYS_OS_THREADSTATS						23
+#define SYS_OS_NEXTPERIOD							24
+#define SYS_OS_SUSPEND								25
+// FIFOs, rings, mailbox and message queues
+#define SYS_OS_FIFO_INIT							26
+#define SYS_OS_FIFO_PUT								27
+#define SYS_OS_FIFO_GET								28
+#define SYS_OS_FIFO_GET_TIMEOUT				29
+#define SYS_OS_FIFO_SIZE							30
+#define SYS_OS_FIFOCREATE							31
+#define SYS_OS_FIFOPUT								32
+#define SYS_OS_FIFOGET								33
+#define SYS_OS_FIFOPUTBULK						34
+#define SYS_OS_FIFOGETBULK						35
+#define SYS_OS_FIFOSIZE								36
+#define SYS_OS_RINGINIT								37
+#define SYS_OS_RINGPUT								38
+#define SYS_OS_RINGGET								39
+#define SYS_OS_RINGGETBULK						40
+#define SYS_OS_RINGSIZE								41
+#define SYS_OS_MAILBOX_INIT						42
+#define SYS_OS_MAILBOX_SEND						43
+#define SYS_OS_MAILBOX_RECV						44
+#define SYS_OS_MAILBOX_RECV_TIMEOUT		45
+#define SYS_OS_MSGQUEUEINIT						46
+#define SYS_OS_MSGQUEUESEND						47
+#define SYS_OS_MSGQUEUERECV						48
+#define SYS_OS_MSGQUEUESENDTIMEOUT		49
+#define SYS_OS_MSGQUEUERECVTIMEOUT		50
+// time
+#define SYS_OS_TIME64									51
+#define SYS_OS_TIMEUS									52
+#define SYS_OS_TIMENS									53
+#define SYS_OS_TIMEDIFFERENCE					54
+#define SYS_OS_CLEARMSTIME						55
+#define SYS_OS_MSTIME									56
+#define SYS_OS_PERIODICSTATS					57
+// eFile
+#define SYS_EFILE_INIT								58
+#define SYS_EFILE_FORMAT							59
+#define SYS_EFILE_MOUNT								60
+#define SYS_EFILE_CREATE							61
+#define SYS_EFILE_WOPEN								62
+#define SYS_EFILE_WRITE								63
+#define SYS_EFILE_WCLOSE							64
+#define SYS_EFILE_ROPEN								65
+#define SYS_EFILE_READNEXT						66
+#define SYS_EFILE_RCLOSE							67
+#define SYS_EFILE_DELETE							68
+#define SYS_EFILE_DOPEN								69
+#define SYS_EFILE_DIRNEXT							70
+#define SYS_EFILE_DCLOSE							71
+#define SYS_EFILE_UNMOUNT							72
+// display
+#define SYS_ST7735_MESSAGE						73
+// added in 1.1
+#define SYS_OS_EXIT										74
+#define SYS_OS_JOIN										75
+#define SYS_OS_SETRESTARTPOLICY				76
+// added in 1.2
+#define SYS_EFILE_WRITEBUFFER					77
+#define SYS_EFILE_READBUFFER					78
+// added in 2.0, the Init calls of these objects are refused from a process
+#define SYS_OS_SEMA4CREATE						79
+#define SYS_OS_MUTEXCREATE						80
+#define SYS_OS_EVENTGROUPCREATE				81
+#define SYS_OS_RINGCREATE							82
+#define SYS_OS_MSGQUEUECREATE					83
+
+#define SYSCALL_NUM										84		// calls in this version
+
+
+// the calls as seen by a loaded program, armcc turns each into an SVC instruction
+// the OS.h function of the same name without the SVC_ prefix documents each one
+#ifdef __CC_ARM
+uint32_t __svc(SYS_OS_ID) SVC_OS_Id(void);
+void __svc(SYS_OS_KILL) SVC_OS_Kill(void);
+void __svc(SYS_OS_SLEEP) SVC_OS_Sleep(uint32_t sleepTime);
+uint32_t __svc(SYS_OS_TIME) SVC_OS_Time(void);
+int __svc(SYS_OS_ADDTHREAD) SVC_OS_AddThread(void(*task)(void), uint32_t stackSize, uint32_t priority);
+uint32_t __svc(SYS_OS_SYSCALLVERSION) SVC_OS_SyscallVersion(void);
+
+void __svc(SYS_OS_INITSEMAPHORE) SVC_OS_InitSemaphore(Sema4Type *semaPt, int32_t value);
+void __svc(SYS_OS_WAIT) SVC_OS_Wait(Sema4Type *semaPt);
+void __svc(SYS_OS_SIGNAL) SVC_OS_Signal(Sema4Type *semaPt);
+void __svc(SYS_OS_BWAIT) SVC_OS_bWait(Sema4Type *semaPt);
+void __svc(SYS_OS_BSIGNAL) SVC_OS_bSignal(Sema4Type *semaPt);
+int __svc(SYS_OS_WAIT_TIMEOUT) SVC_OS_Wait_Timeout(Sema4Type *semaPt, uint32_t timeout);
+int __svc(SYS_OS_BWAIT_TIMEOUT) SVC_OS_bWait_Timeout(Sema4Type *semaPt, uint32_t timeout);
+void __svc(SYS_OS_INITMUTEX) SVC_OS_InitMutex(MutexType *mutexPt);
+void __svc(SYS_OS_MUTEXLOCK) SVC_OS_MutexLock(MutexType *mutexPt);
+void __svc(SYS_OS_MUTEXUNLOCK) SVC_OS_MutexUnlock(MutexType *mutexPt);
+void __svc(SYS_OS_EVENTGROUPINIT) SVC_OS_EventGroupInit(EventGroupType *groupPt);
+uint32_t __svc(SYS_OS_EVENTGROUPSET) SVC_OS_EventGroupSet(EventGroupType *groupPt, uint32_t flags);
+uint32_t __svc(SYS_OS_EVENTGROUPCLEAR) SVC_OS_EventGroupClear(EventGroupType *groupPt, uint32_t flags);
+uint32_t __svc(SYS_OS_EVENTGROUPGET) SVC_OS_EventGroupGet(EventGroupType *groupPt);
+uint32_t __svc(SYS_OS_EVENTGROUPWAIT) SVC_OS_EventGroupWait(EventGroupType *groupPt, uint32_t mask, uint32_t options);
+uint32_t __svc(SYS_OS_EVENTGROUPWAIT_TIMEOUT) SVC_OS_EventGroupWait_Timeout(EventGroupType *groupPt, uint32_t mask, uint32_t options, uint32_t timeout);
+
+int __svc(SYS_OS_STACKSTATS) SVC_OS_StackStats(uint32_t id, StackStatsType* stats);
+int __svc(SYS_OS_THREADSTATS) SVC_OS_ThreadStats(uint32_t id, ThreadStatsType* stats);
+void __svc(SYS_OS_NEXTPERIOD) SVC_OS_NextPeriod(void);
+void __svc(SYS_OS_SUSPEND) SVC_OS_Suspend(void);
+
+void __svc(SYS_OS_FIFO_INIT) SVC_OS_Fifo_Init(uint32_t size);
+int __svc(SYS_OS_FIFO_PUT) SVC_OS_Fifo_Put(uint32_t data);
+uint32_t __svc(SYS_OS_FIFO_GET) SVC_OS_Fifo_Get(void);
+int __svc(SYS_OS_FIFO_GET_TIMEOUT) SVC_OS_Fifo_Get_Timeout(uint32_t* data, uint32_t timeout);
+int32_t __svc(SYS_OS_FIFO_SIZE) SVC_OS_Fifo_Size(void);
+FifoType* __svc(SYS_OS_FIFOCREATE) SVC_OS_FifoCreate(void* buffer, uint32_t size, uint32_t elemSize);
+int __svc(SYS_OS_FIFOPUT) SVC_OS_FifoPut(FifoType* fifo, const void* data);
+void __svc(SYS_OS_FIFOGET) SVC_OS_FifoGet(FifoType* fifo, void* data);
+uint32_t __svc(SYS_OS_FIFOPUTBULK) SVC_OS_FifoPutBulk(FifoType* fifo, const void* data, uint32_t count);
+uint32_t __svc(SYS_OS_FIFOGETBULK) SVC_OS_FifoGetBulk(FifoType* fifo, void* data, uint32_t maxCount);
+int32_t __svc(SYS_OS_FIFOSIZE) SVC_OS_FifoSize(FifoType* fifo);
+int __svc(SYS_OS_RINGINIT) SVC_OS_RingInit(RingType* ring, uint32_t* buffer, uint32_t size, uint32_t watermark);
+int __svc(SYS_OS_RINGPUT) SVC_OS_RingPut(RingType* ring, uint32_t data);
+uint32_t __svc(SYS_OS_RINGGET) SVC_OS_RingGet(RingType* ring);
+uint32_t __svc(SYS_OS_RINGGETBULK) SVC_OS_RingGetBulk(RingType* ring, uint32_t* data, uint32_t maxCount);
+int32_t __svc(SYS_OS_RINGSIZE) SVC_OS_RingSize(RingType* ring);
+void __svc(SYS_OS_MAILBOX_INIT) SVC_OS_MailBox_Init(void);
+void __svc(SYS_OS_MAILBOX_SEND) SVC_OS_MailBox_Send(uint32_t data);
+uint32_t __svc(SYS_OS_MAILBOX_RECV) SVC_OS_MailBox_Recv(void);
+int __svc(SYS_OS_MAILBOX_RECV_TIMEOUT) SVC_OS_MailBox_Recv_Timeout(uint32_t* data, uint32_t timeout);
+void __svc(SYS_OS_MSGQUEUEINIT) SVC_OS_MsgQueueInit(MsgQueueType* queue, void* buffer, uint32_t capacity, uint32_t msgSize);
+void __svc(SYS_OS_MSGQUEUESEND) SVC_OS_MsgQueueSend(MsgQueueType* queue, const void* msg);
+void __svc(SYS_OS_MSGQUEUERECV) SVC_OS_MsgQueueRecv(MsgQueueType* queue, void* msg);
+int __svc(SYS_OS_MSGQUEUESENDTIMEOUT) SVC_OS_MsgQueueSendTimeout(MsgQueueType* queue, const void* msg, uint32_t timeout);
+int __svc(SYS_OS_MSGQUEUERECVTIMEOUT) SVC_OS_MsgQueueRecvTimeout(MsgQueueType* queue, void* msg, uint32_t timeout);
+
+uint64_t __svc(SYS_OS_TIME64) SVC_OS_Time64(void);
+uint64_t __svc(SYS_OS_TIMEUS) SVC_OS_TimeUs(void);
+uint64_t __svc(SYS_OS_TIMENS) SVC_OS_TimeNs(void);
+uint32_t __svc(SYS_OS_TIMEDIFFERENCE) SVC_OS_TimeDifference(uint32_t start, uint32_t stop);
+void __svc(SYS_OS_CLEARMSTIME) SVC_OS_ClearMsTime(void);
+uint32_t __svc(SYS_OS_MSTIME) SVC_OS_MsTime(void);
+int __svc(SYS_OS_PERIODICSTATS) SVC_OS_PeriodicStats(uint32_t index, PeriodicStatsType* stats);
+
+int __svc(SYS_EFILE_INIT) SVC_eFile_Init(void);
+int __svc(SYS_EFILE_FORMAT) SVC_eFile_Format(void);
+int __svc(SYS_EFILE_MOUNT) SVC_eFile_Mount(void);
+int __svc(SYS_EFILE_CREATE) SVC_eFile_Create(const char name[]);
+int __svc(SYS_EFILE_WOPEN) SVC_eFile_WOpen(const char name[]);
+int __svc(SYS_EFILE_WRITE) SVC_eFile_Write(const char data);
+int __svc(SYS_EFILE_WCLOSE) SVC_eFile_WClose(void);
+int __svc(SYS_EFILE_ROPEN) SVC_eFile_ROpen(const char name[]);
+int __svc(SYS_EFILE_READNEXT) SVC_eFile_ReadNext(char *pt);
+int __svc(SYS_EFILE_RCLOSE) SVC_eFile_RClose(void);
+int __svc(SYS_EFILE_DELETE) SVC_eFile_Delete(const char name[]);
+int __svc(SYS_EFILE_DOPEN) SVC_eFile_DOpen(const char name[]);
+int __svc(SYS_EFILE_DIRNEXT) SVC_eFile_DirNext(char *name[], unsigned long *size);
+int __svc(SYS_EFILE_DCLOSE) SVC_eFile_DClose(void);
+int __svc(SYS_EFILE_UNMOUNT) SVC_eFile_Unmount(void);
+
+void __svc(SYS_ST7735_MESSAGE) SVC_ST7735_Message(uint32_t d, uint32_t l, char *pt, int32_t value);
+
+void __svc(SYS_OS_EXIT) SVC_OS_Exit(int32_t exitCode);
+int __svc(SYS_OS_JOIN) SVC_OS_Join(uint32_t id, int32_t *exitCode);
+int __svc(SYS_OS_SETRESTARTPOLICY) SVC_OS_SetRestartPolicy(uint32_t id, uint32_t limit, uint32_t window);
+
+int __svc(SYS_EFILE_WRITEBUFFER) SVC_eFile_WriteBuffer(const char data[], unsigned long size);
+int __svc(SYS_EFILE_READBUFFER) SVC_eFile_ReadBuffer(char data[], unsigned long size, unsigned long *count);
+
+Sema4Type* __svc(SYS_OS_SEMA4CREATE) SVC_OS_Sema4Create(int32_t value);
+MutexType* __svc(SYS_OS_MUTEXCREATE) SVC_OS_MutexCreate(void);
+EventGroupType* __svc(SYS_OS_EVENTGROUPCREATE) SVC_OS_EventGroupCreate(void);
+RingType* __svc(SYS_OS_RINGCREATE) SVC_OS_RingCreate(uint32_t* buffer, uint32_t size, uint32_t watermark);
+MsgQueueType* __svc(SYS_OS_MSGQUEUECREATE) SVC_OS_MsgQueueCreate(void* buffer, uint32_t capacity, uint32_t msgSize);
+#endif
+
+#endif
@@ -2,6 +2,9 @@
 #define __TCB_H  1
 #include <stdint.h>
 #include <stdbool.h>
+#ifdef HOST_SIM
+#include <ucontext.h>
+#endif
 
 
 struct PCB{
@@ -11,10 +14,25 @@ struct PCB{
 	int32_t* data;
 	int32_t* text;
 	int32_t threadCount;
+	// MPU regions of the segments, NVIC_MPU_BASE and NVIC_MPU_ATTR values, see OS_AddProcess
+	uint32_t mpuText[2];
+	uint32_t mpuData[2];
 };
 
+struct WaitQueue;
+struct Mutex;
+struct Sema4;
+
+// osasm.s reaches stackPt, excReturn, svcReturn, control and svcControl by offset, they have to stay the first five fields
 struct TCB{
 	int32_t* stackPt;
+	uint32_t excReturn;			// EXC_RETURN PendSV resumes the thread with, bit 4 clear once it has used the FPU
+	uint32_t svcReturn;			// where the system call in progress returns to
+	uint32_t control;				// CONTROL nPRIV PendSV resumes the thread with, 1 for an unprivileged process thread
+	uint32_t svcControl;		// nPRIV of the caller of the system call in progress, the kernel function runs privileged
+	int32_t* stackBase;			// lowest address of the stack, NULL once the stack is back in the arena
+	uint32_t stackSize;			// bytes
+	bool stackOverflowed;		// the canary at stackBase[0] was found overwritten
 	struct TCB* nextTCB;
 	struct TCB* previousTCB;
 	bool listHead;
@@ -25,6 +43,53 @@ struct TCB{
 	int32_t blocked;
 	// added for lab 5
 	struct PCB* currentPCB;
+	uint32_t mpuStack[2];		// MPU region of the stack, loaded with the PCB regions while a process thread runs
+	struct TCB* nextReap;		// killed threads waiting for OS_Idle to return their stack
+	// priority inheritance, priority is raised above basePriority while a held mutex has higher priority waiters
+	int32_t basePriority;
+	bool sleeping;
+	// sleeping threads are chained separately, so a thread waiting with a timeout can be on a wait queue as well
+	struct TCB* nextSleepTCB;
+	struct TCB* previousSleepTCB;
+	struct WaitQueue* waitQueue;		// queue this thread is blocked in, NULL when ready or sleeping
+	struct Sema4* timedSema4;				// counting semaphore this thread waits on with a timeout
+	bool timedOut;									// set when a wait with a timeout ran out
+	struct Mutex* blockedOnMutex;		// mutex this thread is waiting for
+	struct Mutex* heldMutexes;			// mutexes owned by this thread, chained through nextHeld
+	// event group wait, see OS_EventGroupWait
+	uint32_t eventMask;							// flags waited for
+	uint32_t eventOptions;					// EVENT_WAITALL, EVENT_CLEAR
+	uint32_t eventFlags;						// flags of the group when the wait was satisfied
+	// CPU accounting, in bus cycles
+	uint64_t runTime;
+	uint32_t switchesIn;
+	uint32_t preemptions;						// switched out while it could still run
+	uint32_t voluntarySwitches;			// switched out because it blocked, slept, yielded or died
+	// real-time threads run one job per period at REALTIME_PRIORITY, ordered by the scheduling mode
+	bool realTime;
+	uint32_t period;								// ms
+	uint32_t deadline;							// ms after each release
+	uint32_t density;								// wcet/deadline in parts per million, counted against the admission bound
+	uint32_t release;								// tick the current job was released at
+	uint32_t absoluteDeadline;			// tick the current job has to finish by
+	uint32_t jobs;
+	uint32_t deadlineMisses;
+	// OS_Exit, OS_Join and the restart policy
+	void (*task)(void);							// where a restart starts the thread over
+	int32_t exitCode;
+	int32_t joinId;									// thread waited for in OS_Join
+	int32_t joinCode;								// exit code OS_Exit hands the thread waiting in OS_Join
+	uint32_t restartLimit;					// restarts allowed per restartWindow ms, 0 for none
+	uint32_t restartWindow;
+	uint32_t restartWindowStart;		// tick the current window began
+	uint32_t restarts;							// restarts so far in the current window
+	bool restartRealTime;						// was real-time when it faulted, restarted as one
+#ifdef HOST_SIM
+	// the host port switches threads with ucontext, the stack above only holds the initial frame
+	ucontext_t hostContext;
+	void* hostStack;
+	void (*hostTask)(void);
+#endif
 };
 
 #endif
@@ -0,0 +1,82 @@
+// *************Trace.c**************
+// Kernel event trace for the OS
+// Fixed size records in a RAM ring, timestamped with the free-running WTIMER5
+// Recording one event is a handful of stores inside a short critical section
+
+#include <stdint.h>
+#include <stdbool.h>
+#ifdef HOST_SIM
+#include "../RTOS_Labs_common/host/HostPort.h"
+#else
+#include "../inc/tm4c123gh6pm.h"
+#include "../inc/CortexM.h"
+#endif
+#include "../RTOS_Labs_common/Trace.h"
+
+#define TRACE_CLOCK		80000000	// Hz, WTIMER5 runs at the bus clock
+
+TraceRecordType TraceBuffer[TRACESIZE];
+uint32_t TracePut = 0;				// records ever added, the next one goes to TracePut%TRACESIZE
+bool TraceOn = false;
+
+void Trace_Init(void){
+	long sr = StartCritical();
+	TracePut = 0;
+	TraceOn = true;
+	EndCritical(sr);
+}
+
+void Trace_Start(void){
+	TraceOn = true;
+}
+
+void Trace_Stop(void){
+	TraceOn = false;
+}
+
+void Trace_Record(uint8_t type, uint32_t id, uint32_t arg){
+	if(!TraceOn){
+		return;
+	}
+	long sr = StartCritical();
+	TraceRecordType* record = &TraceBuffer[TracePut&(TRACESIZE-1)];
+	record->time = WTIMER5_TAV_R;
+	record->type = type;
+	record->id = id;
+	record->arg = arg;
+	TracePut++;
+	EndCritical(sr);
+}
+
+// output a little endian field
+static void dumpField(void (*outChar)(char), uint32_t value, uint32_t bytes){
+	for(uint32_t i = 0; i < bytes; i++){
+		outChar((char)(value >> (8*i)));
+	}
+}
+
+uint32_t Trace_Dump(void (*outChar)(char)){
+	bool traceOn = TraceOn;
+	TraceOn = false;
+
+	uint32_t count = TracePut < TRACESIZE ? TracePut : TRACESIZE;
+	outChar('R');
+	outChar('T');
+	outChar('R');
+	outChar('C');
+	dumpField(outChar, TRACE_VERSION, 2);
+	dumpField(outChar, sizeof(TraceRecordType), 2);
+	dumpField(outChar, TRACE_CLOCK, 4);
+	dumpField(outChar, count, 4);
+
+	for(uint32_t i = TracePut - count; i != TracePut; i++){
+		TraceRecordType* record = &TraceBuffer[i&(TRACESIZE-1)];
+		dumpField(outChar, record->time, 4);
+		dumpField(outChar, record->type, 1);
+		dumpField(outChar, record->id, 1);
+		dumpField(outChar, record->arg, 2);
+	}
+
+	TraceOn = traceOn;
+	return count;
+}
@@ -0,0 +1,84 @@
+// *************Trace.h**************
+// Kernel event trace for the OS
+// The OS records context switches, blocking and waking, sleeps, timeouts and
+// ISR entry and exit into a ring of fixed size records in RAM.
+// The newest TRACESIZE records can be dumped in a binary format to the UART or a file,
+// tools/trace2chrome.py turns a dump into Chrome trace JSON (chrome://tracing, Perfetto)
+//
+// dump format, little endian:
+//   header  char magic[4] = "RTRC", uint16_t version, uint16_t record size,
+//           uint32_t clock in Hz, uint32_t record count
+//   records TraceRecordType, oldest first
+
+#ifndef __TRACE_H
+#define __TRACE_H  1
+#include <stdint.h>
+
+#define TRACE_ENABLED	1			// 0 compiles every trace point out of the OS
+#define TRACESIZE			256		// records kept, a power of 2
+#define TRACE_VERSION	1
+
+// event types
+#define TRACE_SWITCH		1		// id switched in, arg is the thread switched out
+#define TRACE_BLOCK			2		// id blocked, arg is the low half word of the wait queue address
+#define TRACE_WAKE			3		// id woken, arg is the low half word of the wait queue address
+#define TRACE_TIMEOUT		4		// id gave up a wait, arg is the low half word of the wait queue address
+#define TRACE_SLEEP			5		// id went to sleep, arg is the sleep time in ms
+#define TRACE_KILL			6		// id was killed
+#define TRACE_ISR_ENTER	7		// arg is the exception number, id is the interrupted thread
+#define TRACE_ISR_EXIT	8		// arg is the exception number, id is the interrupted thread
+
+#define TRACE_NOTHREAD	0xFF	// id before the first thread runs
+
+// exception numbers of the ISRs the OS traces
+#define TRACE_SYSTICK		15
+#define TRACE_GPIOF			46
+#define TRACE_TIMER5A		108
+#define TRACE_WTIMER0A	110
+
+typedef struct{
+	uint32_t time;			// low word of the free-running WTIMER5, 12.5ns units
+	uint8_t type;
+	uint8_t id;
+	uint16_t arg;
+} TraceRecordType;
+
+#if TRACE_ENABLED
+#define TRACE(type, id, arg)	Trace_Record(type, id, arg)
+#else
+#define TRACE(type, id, arg)	((void)(id))		// ids are plain reads, so nothing is left of it
+#endif
+
+// ******** Trace_Init ************
+// empty the trace and start recording
+// input:  none
+// output: none
+void Trace_Init(void);
+
+// ******** Trace_Start ************
+// resume recording
+// input:  none
+// output: none
+void Trace_Start(void);
+
+// ******** Trace_Stop ************
+// stop recording, the records taken so far are kept
+// input:  none
+// output: none
+void Trace_Stop(void);
+
+// ******** Trace_Record ************
+// add one record, overwriting the oldest once the ring is full
+// can be called from threads and ISRs, use the TRACE macro so it can be compiled out
+// input:  event type, thread id, event argument
+// output: none
+void Trace_Record(uint8_t type, uint32_t id, uint32_t arg);
+
+// ******** Trace_Dump ************
+// write the header and the records in the ring, oldest first
+// recording is paused while dumping
+// input:  function that outputs one byte, like UART_OutChar
+// output: number of records written
+uint32_t Trace_Dump(void (*outChar)(char));
+
+#endif
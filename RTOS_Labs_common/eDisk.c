@@ -225,7 +225,7 @@ static volatile UINT Timer1, Timer2;  /* 1kHz decrement timer stopped at zero (d
 
 static BYTE CardType;      /* Card type flags */
 
-extern Sema4Type LCDFree; 
+extern MutexType LCDFree; 
 
 
 /*-----------------------------------------------------------------------*/
@@ -551,9 +551,9 @@ DRESULT eDisk_ReadBlock(
     BYTE *buff,         /* Pointer to the data buffer to store read data */
     DWORD sector){      /* Start sector number (LBA) */
 	
-	//OS_bWait(&LCDFree);
+	//OS_MutexLock(&LCDFree);
 	DRESULT errCode = eDisk_Read(0,buff,sector,1);
-	//OS_bSignal(&LCDFree);
+	//OS_MutexUnlock(&LCDFree);
   return errCode;
 }
 
@@ -609,9 +609,9 @@ DRESULT eDisk_WriteBlock (
     const BYTE *buff,   /* Pointer to the data to be written */
     DWORD sector){      /* Start sector number (LBA) */
 	
-	//OS_bWait(&LCDFree);
+	//OS_MutexLock(&LCDFree);
 	DRESULT errCode = eDisk_Write(0,buff,sector,1);  // 1 block
-  //OS_bSignal(&LCDFree);
+  //OS_MutexUnlock(&LCDFree);
 	return errCode;
 }
 
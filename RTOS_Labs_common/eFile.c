@@ -4,7 +4,11 @@
 // Jonathan W. Valvano 1/12/20
 #include <stdint.h>
 #include <string.h>
+#ifdef HOST_SIM
+#include "../RTOS_Labs_common/host/HostPort.h"
+#else
 #include "../inc/CortexM.h"
+#endif
 #include "../RTOS_Labs_common/OS.h"
 #include "../RTOS_Labs_common/eDisk.h"
 #include "../RTOS_Labs_common/eFile.h"
@@ -19,6 +23,21 @@
 // NOTE: directory is at sector 0 and FAT is at sector 1
 #define FD_SECTOR_NUM					0
 #define FAT_SECTOR_NUM				1
+// sectors moved by one eDisk_Read/eDisk_Write where the chain of a file is contiguous,
+// bounded by the RAM of fileRunBuffer
+#define EFILE_RUNSECTORS			8
+// file bytes in a sector, after the two byte usage count
+#define SECTOR_DATA_SIZE			(BLOCK_SIZE-2)
+// eFile_Throughput overwrites these scratch sectors, past the 512 eFile_Format clears
+#define BENCH_SECTOR					512
+#define BENCH_SECTORS					64
+#ifdef HOST_SIM
+// the host has no flash at address 0, the benchmark writes out a buffer of the same size
+static const BYTE benchFlash[BENCH_SECTORS*BLOCK_SIZE];
+#define BENCH_FLASH						benchFlash
+#else
+#define BENCH_FLASH						((const BYTE*)0x00000000)	// flash the benchmark writes out, its content doesn't matter
+#endif
 
 struct fileEntry{
 	BYTE fileName[8];
@@ -47,6 +66,7 @@ first 2 bytes denote current sector usage
 
 BYTE fileDataBuffer[512];
 BYTE fileAllocationTable[512];
+BYTE fileRunBuffer[EFILE_RUNSECTORS*BLOCK_SIZE];
 struct fileEntry fileDirectory[32];
 
 bool initialized = false;
@@ -55,7 +75,59 @@ int writeFileIndex = 0;
 int readFileDataIndex = 0;
 int readFileIndex = 0;
 
-Sema4Type eFileMutex;
+MutexType eFileMutex;
+// the SD card shares its SSI with the LCD, whoever draws or moves sectors holds this
+extern MutexType LCDFree;
+
+// bytes used in a sector, including the two byte count itself
+static int sectorUsage(const BYTE* sector){
+	return sector[0] + 256*sector[1];
+}
+
+static void sectorSetUsage(BYTE* sector, int usage){
+	sector[0] = usage%256;
+	sector[1] = usage/256;
+}
+
+// take the head of the free sector list and chain it after lastSector
+// returns the new sector, 0 if the disk is full
+static int sectorAllocate(int lastSector){
+	int freeSectorIndex = fileDirectory[31].sectorIndex;
+	if(freeSectorIndex == 0){
+		return 0;
+	}
+	fileAllocationTable[lastSector] = freeSectorIndex;
+	fileDirectory[31].sectorIndex = fileAllocationTable[freeSectorIndex];
+	fileAllocationTable[freeSectorIndex] = 0;
+	return freeSectorIndex;
+}
+
+// number of sectors from sector on that follow each other both in the chain and on the disk,
+// so one multi-sector transfer can move them, at most maxRun
+static int sectorRun(int sector, int maxRun){
+	int run = 1;
+	while(run < maxRun && fileAllocationTable[sector + run - 1] == sector + run){
+		run++;
+	}
+	return run;
+}
+
+// eDisk_Write and eDisk_Read holding the SSI for the one transfer, rather than stopping the scheduler,
+// so the real-time threads keep their deadlines while runs of sectors go out
+// eFileMutex already keeps the FAT, the directory and the buffers to one caller
+static DRESULT diskWrite(const BYTE* buff, int sector, int count){
+	OS_MutexLock(&LCDFree);
+	DRESULT errCode = eDisk_Write(0, buff, sector, count);
+	OS_MutexUnlock(&LCDFree);
+	return errCode;
+}
+
+static DRESULT diskRead(BYTE* buff, int sector, int count){
+	OS_MutexLock(&LCDFree);
+	DRESULT errCode = eDisk_Read(0, buff, sector, count);
+	OS_MutexUnlock(&LCDFree);
+	return errCode;
+}
 
 
 //---------- eFile_Init-----------------
@@ -90,7 +162,7 @@ int eFile_Init(void){ // initialize file system
 			return errCode;
 		}
 		
-		OS_InitSemaphore(&eFileMutex, 1);
+		OS_InitMutex(&eFileMutex);
 		return 0;
 	}
 	
@@ -103,7 +175,7 @@ int eFile_Init(void){ // initialize file system
 // Output: 0 if successful and 1 on failure (e.g., trouble writing to flash)
 int eFile_Format(void){ // erase disk, add format
 	
-	OS_bWait(&eFileMutex);
+	OS_MutexLock(&eFileMutex);
 	
 	int errCode = 0;
 	
@@ -122,16 +194,17 @@ int eFile_Format(void){ // erase disk, add format
 		fileDirectory[i].sectorIndex = 0;
 	}
 	
-	// clear 512 sectors 0-511
-	unsigned long schedulerSuspend = OS_LockScheduler();
+	// clear 512 sectors 0-511, a run of blank sectors at a time
+	for(int i = 0; i < EFILE_RUNSECTORS; i++){
+		memcpy(&fileRunBuffer[i*BLOCK_SIZE], fileDataBuffer, BLOCK_SIZE);
+	}
 	int sectorIndex = 0;
-	for(; sectorIndex < 512 && errCode == 0; sectorIndex++){
-		errCode = eDisk_WriteBlock(fileDataBuffer, sectorIndex);
+	for(; sectorIndex < 512 && errCode == 0; sectorIndex += EFILE_RUNSECTORS){
+		errCode = diskWrite(fileRunBuffer, sectorIndex, EFILE_RUNSECTORS);
 	}
-	OS_UnLockScheduler(schedulerSuspend);
 	
 	if(errCode){
-		OS_bSignal(&eFileMutex);
+		OS_MutexUnlock(&eFileMutex);
 		return errCode;
 	}
 	// set free space entry in directory
@@ -150,12 +223,12 @@ int eFile_Format(void){ // erase disk, add format
 	fileAllocationTable[255] = 0;
 	
 	// store back the formatted FAT and file Directory
-	schedulerSuspend = OS_LockScheduler();
-	errCode = eDisk_WriteBlock((BYTE*)fileDirectory, FD_SECTOR_NUM);
-	errCode = eDisk_WriteBlock((BYTE*)fileAllocationTable, FAT_SECTOR_NUM);
-	OS_UnLockScheduler(schedulerSuspend);
+	errCode = diskWrite((BYTE*)fileDirectory, FD_SECTOR_NUM, 1);
+	if(!errCode){
+		errCode = diskWrite(fileAllocationTable, FAT_SECTOR_NUM, 1);
+	}
 
-	OS_bSignal(&eFileMutex);
+	OS_MutexUnlock(&eFileMutex);
   
 	return errCode;   // replace
 }
@@ -166,7 +239,7 @@ int eFile_Format(void){ // erase disk, add format
 // Output: 0 if successful and 1 on failure
 int eFile_Mount(void){ // initialize file system
 	
-	OS_bWait(&eFileMutex);
+	OS_MutexLock(&eFileMutex);
 	
 	int errCode = 0;
 	/*
@@ -176,13 +249,13 @@ int eFile_Mount(void){ // initialize file system
 	errCode = eDisk_ReadBlock((BYTE*)fileDirectory, FD_SECTOR_NUM);
 	if(errCode){
 		OS_UnLockScheduler(schedulerSuspend);
-		OS_bSignal(&eFileMutex);
+		OS_MutexUnlock(&eFileMutex);
 		return errCode;
 	}
 	errCode = eDisk_ReadBlock(fileAllocationTable, FAT_SECTOR_NUM);
 	OS_UnLockScheduler(schedulerSuspend);
   
-	OS_bSignal(&eFileMutex);
+	OS_MutexUnlock(&eFileMutex);
 	
 	return errCode;   // replace
 }
@@ -194,11 +267,11 @@ int eFile_Mount(void){ // initialize file system
 // Output: 0 if successful and 1 on failure (e.g., trouble writing to flash)
 int eFile_Create( const char name[]){  // create new file, make it empty 
 	
-	OS_bWait(&eFileMutex);
+	OS_MutexLock(&eFileMutex);
 	
 	if(fileDirectory[31].sectorIndex == 0){
 		// no more space available
-		OS_bSignal(&eFileMutex);
+		OS_MutexUnlock(&eFileMutex);
 		return 1;
 	}
 	
@@ -225,7 +298,7 @@ int eFile_Create( const char name[]){  // create new file, make it empty
 	
 	// if no space in directory or no space in FAT or file with matching name is already in use, return
 	if(freeFileEntryIndex == -1 || fileDirectory[31].sectorIndex == 0){
-		OS_bSignal(&eFileMutex);
+		OS_MutexUnlock(&eFileMutex);
 		return errCode;
 	}
 	
@@ -255,7 +328,7 @@ int eFile_Create( const char name[]){  // create new file, make it empty
 	errCode = eDisk_WriteBlock(fileDataBuffer, freeSectorIndex);
 	OS_UnLockScheduler(schedulerSuspend);
   
-	OS_bSignal(&eFileMutex);
+	OS_MutexUnlock(&eFileMutex);
 	
 	return errCode;   // replace
 }
@@ -267,7 +340,7 @@ int eFile_Create( const char name[]){  // create new file, make it empty
 // Output: 0 if successful and 1 on failure (e.g., trouble writing to flash)
 int eFile_WOpen( const char name[]){      // open a file for writing 
 	
-	OS_bWait(&eFileMutex);
+	OS_MutexLock(&eFileMutex);
 	
 	// look for the file
 	int errCode = 1;
@@ -285,7 +358,7 @@ int eFile_WOpen( const char name[]){      // open a file for writing
 	}
 	
 	if(foundFileEntryIndex == -1){
-		OS_bSignal(&eFileMutex);
+		OS_MutexUnlock(&eFileMutex);
 		return errCode;
 	}
 	
@@ -299,7 +372,7 @@ int eFile_WOpen( const char name[]){      // open a file for writing
 	writeFileIndex = currentFileStartingSectorNumber;
 	OS_UnLockScheduler(schedulerSuspend);
   
-	OS_bSignal(&eFileMutex);
+	OS_MutexUnlock(&eFileMutex);
 	
 	return errCode;   // replace  
 }
@@ -310,7 +383,7 @@ int eFile_WOpen( const char name[]){      // open a file for writing
 // Output: 0 if successful and 1 on failure (e.g., trouble writing to flash)
 int eFile_Write( const char data){
 	
-		OS_bWait(&eFileMutex);
+		OS_MutexLock(&eFileMutex);
 	
 		int errCode = 0;
 		unsigned long schedulerSuspend = OS_LockScheduler();
@@ -321,7 +394,7 @@ int eFile_Write( const char data){
 			errCode = eDisk_WriteBlock(fileDataBuffer, writeFileIndex);
 			if(errCode){
 				OS_UnLockScheduler(schedulerSuspend);
-				OS_bSignal(&eFileMutex);
+				OS_MutexUnlock(&eFileMutex);
 				return errCode;
 			}
 			// check if last block of file has space
@@ -336,7 +409,7 @@ int eFile_Write( const char data){
 				// no more space in FAT to allocate
 				if(fileDirectory[31].sectorIndex == 0){
 					OS_UnLockScheduler(schedulerSuspend);
-					OS_bSignal(&eFileMutex);
+					OS_MutexUnlock(&eFileMutex);
 					return 1;
 				}else{
 					// if last block of file has no more space, allocate more storage
@@ -367,18 +440,94 @@ int eFile_Write( const char data){
 			fileDataBuffer[1]++;
 		}
 		
-		OS_bSignal(&eFileMutex);
+		OS_MutexUnlock(&eFileMutex);
 		
     return errCode;   // replace
 }
 
+//---------- eFile_WriteBuffer-----------------
+// save a block of data at end of the open file
+// Whole sectors are written with one multi-sector eDisk_Write for as long as
+// the free list hands out sectors that follow each other on the disk
+// Each sector goes out once, the last one filled stays open until more data or eFile_WClose
+// Input: data to be saved, number of bytes
+// Output: 0 if successful and 1 on failure (e.g., trouble writing to flash, disk full)
+int eFile_WriteBuffer(const char data[], unsigned long size){
+	
+	OS_MutexLock(&eFileMutex);
+	
+	int errCode = 0;
+	while(size && !errCode){
+		int currentFileByteIndex = sectorUsage(fileDataBuffer);
+		if(currentFileByteIndex < BLOCK_SIZE){
+			// fill up the open sector
+			unsigned long count = BLOCK_SIZE - currentFileByteIndex;
+			if(count > size){
+				count = size;
+			}
+			memcpy(&fileDataBuffer[currentFileByteIndex], data, count);
+			sectorSetUsage(fileDataBuffer, currentFileByteIndex + count);
+			data += count;
+			size -= count;
+		}else if(fileAllocationTable[writeFileIndex]){
+			// eFile_WOpen left the first sector open, move on to the last one like eFile_Write does
+			errCode = diskWrite(fileDataBuffer, writeFileIndex, 1);
+			while(fileAllocationTable[writeFileIndex]){
+				writeFileIndex = fileAllocationTable[writeFileIndex];
+			}
+			if(!errCode){
+				errCode = diskRead(fileDataBuffer, writeFileIndex, 1);
+			}
+		}else{
+			// the full open sector starts a run, followed by as many whole sectors of data as line up
+			int runStart = writeFileIndex;
+			int run = 1;
+			memcpy(fileRunBuffer, fileDataBuffer, BLOCK_SIZE);
+			while(run < EFILE_RUNSECTORS && size >= SECTOR_DATA_SIZE && 
+						fileDirectory[31].sectorIndex == runStart + run){
+				BYTE* sector = &fileRunBuffer[run*BLOCK_SIZE];
+				sectorAllocate(runStart + run - 1);
+				sectorSetUsage(sector, BLOCK_SIZE);
+				memcpy(&sector[2], data, SECTOR_DATA_SIZE);
+				data += SECTOR_DATA_SIZE;
+				size -= SECTOR_DATA_SIZE;
+				run++;
+			}
+			if(run > 1){
+				// the last sector of the run stays open, it goes out with the next run or on eFile_WClose
+				errCode = diskWrite(fileRunBuffer, runStart, run - 1);
+				writeFileIndex = runStart + run - 1;
+				memcpy(fileDataBuffer, &fileRunBuffer[(run - 1)*BLOCK_SIZE], BLOCK_SIZE);
+			}else{
+				// nothing lines up behind it, write it alone and open a new one for the rest
+				errCode = diskWrite(fileRunBuffer, runStart, 1);
+				if(!errCode){
+					int freeSectorIndex = sectorAllocate(writeFileIndex);
+					if(freeSectorIndex == 0){
+						// no more space in FAT to allocate
+						errCode = 1;
+					}else{
+						memset(fileDataBuffer, 0, BLOCK_SIZE);
+						sectorSetUsage(fileDataBuffer, 2);
+						writeFileIndex = freeSectorIndex;
+					}
+				}
+			}
+		}
+	}
+	
+	OS_MutexUnlock(&eFileMutex);
+	
+	return errCode;
+}
+
 //---------- eFile_WClose-----------------
 // close the file, left disk in a state power can be removed
 // Input: none
 // Output: 0 if successful and 1 on failure (e.g., trouble writing to flash)
 int eFile_WClose(void){ // close the file for writing
   
-	OS_bWait(&eFileMutex);
+	OS_MutexLock(&eFileMutex);
 	
 	int errCode = 1;
 	
@@ -390,7 +539,7 @@ int eFile_WClose(void){ // close the file for writing
 	// set status as no longer writing 
 	writeFileIndex = 0;
 	
-	OS_bSignal(&eFileMutex);
+	OS_MutexUnlock(&eFileMutex);
   
 	return errCode;   // replace
 }
@@ -402,7 +551,7 @@ int eFile_WClose(void){ // close the file for writing
 // Output: 0 if successful and 1 on failure (e.g., trouble read to flash)
 int eFile_ROpen( const char name[]){      // open a file for reading 
 	
-	OS_bWait(&eFileMutex);
+	OS_MutexLock(&eFileMutex);
 	
 	// look for the file
 	int errCode = 1;
@@ -421,7 +570,7 @@ int eFile_ROpen( const char name[]){      // open a file for reading
 	}
 	
 	if(foundFileEntryIndex == -1){
-		OS_bSignal(&eFileMutex);
+		OS_MutexUnlock(&eFileMutex);
 		return errCode;
 	}
 	
@@ -439,7 +588,7 @@ int eFile_ROpen( const char name[]){      // open a file for reading
 	// first two bytes are write information
 	readFileDataIndex = 2;
 	
-	OS_bSignal(&eFileMutex);
+	OS_MutexUnlock(&eFileMutex);
 	
   return errCode;   // replace   
 }
@@ -451,14 +600,14 @@ int eFile_ROpen( const char name[]){      // open a file for reading
 //         0 if successful and 1 on failure (e.g., end of file)
 int eFile_ReadNext( char *pt){       // get next byte 
   
-	OS_bWait(&eFileMutex);
+	OS_MutexLock(&eFileMutex);
 	
 	int errCode = 0;
 	*pt = fileDataBuffer[readFileDataIndex];
 	readFileDataIndex = (readFileDataIndex+1)%511;
 	if(readFileDataIndex == 0){
 		if(fileAllocationTable[readFileIndex] == 0){
-			OS_bSignal(&eFileMutex);
+			OS_MutexUnlock(&eFileMutex);
 			return 1;
 		}
 		readFileIndex = fileAllocationTable[readFileIndex];
@@ -468,25 +617,86 @@ int eFile_ReadNext( char *pt){       // get next byte
 		readFileDataIndex = 2;
 	}
 	
-	OS_bSignal(&eFileMutex);
+	OS_MutexUnlock(&eFileMutex);
 	
   return errCode;   // replace
 }
     
+//---------- eFile_ReadBuffer-----------------
+// retreive a block of data from the open file
+// Sectors that follow each other in the chain and on the disk are read
+// with one multi-sector eDisk_Read, as far as the data fits
+// Input: where to put the data, most bytes to read
+// Output: return by reference the number of bytes read, less than size at the end of the file
+//         0 if successful and 1 on failure (e.g., trouble reading from flash, end of file)
+int eFile_ReadBuffer(char data[], unsigned long size, unsigned long *count){
+	
+	OS_MutexLock(&eFileMutex);
+	
+	int errCode = 0;
+	*count = 0;
+	while(size && !errCode){
+		int usage = sectorUsage(fileDataBuffer);
+		if(readFileDataIndex < usage){
+			// the rest of the open sector
+			unsigned long bytes = usage - readFileDataIndex;
+			if(bytes > size){
+				bytes = size;
+			}
+			memcpy(data, &fileDataBuffer[readFileDataIndex], bytes);
+			readFileDataIndex += bytes;
+			data += bytes;
+			size -= bytes;
+			*count += bytes;
+			continue;
+		}
+		int nextSector = fileAllocationTable[readFileIndex];
+		if(nextSector == 0){
+			// end of file
+			break;
+		}
+		// every sector of the run but the last is copied out whole, the last one is left open
+		int maxRun = size/SECTOR_DATA_SIZE + 1;
+		int run = sectorRun(nextSector, maxRun < EFILE_RUNSECTORS ? maxRun : EFILE_RUNSECTORS);
+		errCode = diskRead(fileRunBuffer, nextSector, run);
+		if(errCode){
+			break;
+		}
+		for(int i = 0; i < run - 1; i++){
+			BYTE* sector = &fileRunBuffer[i*BLOCK_SIZE];
+			unsigned long bytes = sectorUsage(sector) - 2;
+			memcpy(data, &sector[2], bytes);
+			data += bytes;
+			size -= bytes;
+			*count += bytes;
+		}
+		memcpy(fileDataBuffer, &fileRunBuffer[(run - 1)*BLOCK_SIZE], BLOCK_SIZE);
+		readFileIndex = nextSector + run - 1;
+		readFileDataIndex = 2;
+	}
+	
+	OS_MutexUnlock(&eFileMutex);
+	
+	if(!errCode && *count == 0){
+		return 1;
+	}
+	return errCode;
+}
+    
 //---------- eFile_RClose-----------------
 // close the reading file
 // Input: none
 // Output: 0 if successful and 1 on failure (e.g., wasn't open)
 int eFile_RClose(void){ // close the file for writing
   
-	OS_bWait(&eFileMutex);
+	OS_MutexLock(&eFileMutex);
 	
 	// add check for open/closed file?
 	unsigned long schedulerSuspend = OS_LockScheduler();
 	DRESULT errCode = eDisk_WriteBlock(fileDataBuffer, readFileIndex);
 	OS_UnLockScheduler(schedulerSuspend);
 	
-	OS_bSignal(&eFileMutex);
+	OS_MutexUnlock(&eFileMutex);
 	
   return errCode;   // replace
 }
@@ -498,7 +708,7 @@ int eFile_RClose(void){ // close the file for writing
 // Output: 0 if successful and 1 on failure (e.g., trouble writing to flash)
 int eFile_Delete( const char name[]){  // remove this file 
 	
-	OS_bWait(&eFileMutex);
+	OS_MutexLock(&eFileMutex);
 	
 	int errCode = 0;
 	
@@ -513,7 +723,7 @@ int eFile_Delete( const char name[]){  // remove this file
 	}
 	
 	if(fileDeleteIndex == -1){
-		OS_bSignal(&eFileMutex);
+		OS_MutexUnlock(&eFileMutex);
 		return 1;
 	}
 	
@@ -555,7 +765,7 @@ int eFile_Delete( const char name[]){  // remove this file
 	}
 	OS_UnLockScheduler(schedulerSuspend);
 	
-	OS_bSignal(&eFileMutex);
+	OS_MutexUnlock(&eFileMutex);
 	
   return errCode;   // replace
 }                             
@@ -600,7 +810,7 @@ int eFile_DClose(void){ // close the directory
 // Output: 0 if successful and 1 on failure (not currently mounted)
 int eFile_Unmount(void){ 
   
-	OS_bWait(&eFileMutex);
+	OS_MutexLock(&eFileMutex);
 	
 	int errCode = 0;
 	
@@ -608,7 +818,7 @@ int eFile_Unmount(void){
 	errCode = eDisk_WriteBlock(fileAllocationTable, FAT_SECTOR_NUM);
 	if(errCode){
 		OS_UnLockScheduler(schedulerSuspend);
-		OS_bSignal(&eFileMutex);
+		OS_MutexUnlock(&eFileMutex);
 		return errCode;
 	}
 	
@@ -617,19 +827,19 @@ int eFile_Unmount(void){
 	}
 	if(errCode){
 		OS_UnLockScheduler(schedulerSuspend);
-		OS_bSignal(&eFileMutex);
+		OS_MutexUnlock(&eFileMutex);
 		return errCode;
 	}
 	
 	errCode = eDisk_WriteBlock((BYTE*)fileDirectory, FD_SECTOR_NUM);
 	if(errCode){
 		OS_UnLockScheduler(schedulerSuspend);
-		OS_bSignal(&eFileMutex);
+		OS_MutexUnlock(&eFileMutex);
 		return errCode;
 	}
 	OS_UnLockScheduler(schedulerSuspend);
 	
-	OS_bSignal(&eFileMutex);
+	OS_MutexUnlock(&eFileMutex);
   
 	return errCode;   // replace
 }
@@ -638,9 +848,6 @@ int eFile_Unmount(void){
 // these methods are called only by interpreter
 // be warned that since interpreter is typically low priority, priority inversion can easily happen !
 
-BYTE tempDataBuffer[512];
-
-
 // Output: 0 if successful and 1 on failure (trouble reading from disk)
 static int fileSizeCounter(int directoryEntry, int* numBytes, int* numSectors){
 
@@ -648,14 +855,13 @@ static int fileSizeCounter(int directoryEntry, int* numBytes, int* numSectors){
 	
 	int startingSector = fileDirectory[directoryEntry].sectorIndex;
 	while(startingSector && !errCode){
-		errCode = eDisk_ReadBlock(tempDataBuffer, startingSector);
-		int currentByteUsage = 0;
-		currentByteUsage += tempDataBuffer[0];
-		currentByteUsage += 256 * tempDataBuffer[1];
-		
-		*numBytes = *numBytes + currentByteUsage;
-		*numSectors = *numSectors + 1;
-		startingSector = fileAllocationTable[startingSector];
+		int run = sectorRun(startingSector, EFILE_RUNSECTORS);
+		errCode = eDisk_Read(0, fileRunBuffer, startingSector, run);
+		for(int i = 0; i < run; i++){
+			*numBytes = *numBytes + sectorUsage(&fileRunBuffer[i*BLOCK_SIZE]);
+			*numSectors = *numSectors + 1;
+		}
+		startingSector = fileAllocationTable[startingSector + run - 1];
 	}
 	
 	return errCode;
@@ -667,7 +873,7 @@ static int fileSizeCounter(int directoryEntry, int* numBytes, int* numSectors){
 // Output: none
 void eFile_PrintDirectory(void){
 	
-	OS_bWait(&eFileMutex);
+	OS_MutexLock(&eFileMutex);
 	
 	UART_OutString("\n\r");
 	
@@ -677,7 +883,7 @@ void eFile_PrintDirectory(void){
 			int numSectors = 0;
 			int errCode = fileSizeCounter(i, &numBytes, &numSectors);
 			if(errCode){
-				OS_bSignal(&eFileMutex);
+				OS_MutexUnlock(&eFileMutex);
 				UART_OutString("trouble reading from directory");
 				return;
 			}
@@ -691,7 +897,7 @@ void eFile_PrintDirectory(void){
 		}
 	}
 	
-	OS_bSignal(&eFileMutex);
+	OS_MutexUnlock(&eFileMutex);
 	
 }
 
@@ -701,15 +907,17 @@ static int filePrinter(int directoryEntry){
 	
 	int startingSector = fileDirectory[directoryEntry].sectorIndex;
 	while(startingSector && !errCode){
-		errCode = eDisk_ReadBlock(tempDataBuffer, startingSector);
-		int startingIndex = 2;
-		int endingIndex = 0;
-		endingIndex += tempDataBuffer[0];
-		endingIndex += 256 * tempDataBuffer[1];
-		for(; startingIndex < endingIndex; startingIndex++){
-			UART_OutChar(tempDataBuffer[startingIndex]);
+		int run = sectorRun(startingSector, EFILE_RUNSECTORS);
+		errCode = eDisk_Read(0, fileRunBuffer, startingSector, run);
+		for(int i = 0; i < run; i++){
+			BYTE* sector = &fileRunBuffer[i*BLOCK_SIZE];
+			int startingIndex = 2;
+			int endingIndex = sectorUsage(sector);
+			for(; startingIndex < endingIndex; startingIndex++){
+				UART_OutChar(sector[startingIndex]);
+			}
 		}
-		startingSector = fileAllocationTable[startingSector];
+		startingSector = fileAllocationTable[startingSector + run - 1];
 	}
 	
 	UART_OutString("\n\r");
@@ -722,7 +930,7 @@ static int filePrinter(int directoryEntry){
 // Output: none
 void eFile_PrintFile(char* fileName){
 	
-	OS_bWait(&eFileMutex);
+	OS_MutexLock(&eFileMutex);
 	
 	UART_OutString("\n\r");
 	
@@ -740,7 +948,7 @@ void eFile_PrintFile(char* fileName){
 		UART_OutString("file : ");
 		UART_OutString(fileName);
 		UART_OutString(" can't be printed because it doesn't exist");
-		OS_bSignal(&eFileMutex);
+		OS_MutexUnlock(&eFileMutex);
 		UART_OutString("\n\r");
 		return;
 	}
@@ -748,14 +956,14 @@ void eFile_PrintFile(char* fileName){
 	int errCode = filePrinter(foundFileIndex);
 	if(errCode){
 		UART_OutString("trouble reading file");
-		OS_bSignal(&eFileMutex);
+		OS_MutexUnlock(&eFileMutex);
 		UART_OutString("\n\r");
 		return;
 	}
 	
 	UART_OutString("\n\r");
 	
-	OS_bSignal(&eFileMutex);
+	OS_MutexUnlock(&eFileMutex);
 	
 }
 
@@ -767,7 +975,7 @@ void eFile_DeleteFile(char* fileName){
 
 	int errCode = eFile_Delete(fileName);
 	
-	OS_bWait(&eFileMutex);
+	OS_MutexLock(&eFileMutex);
 	
 	UART_OutString("\n\r");
 	
@@ -780,7 +988,7 @@ void eFile_DeleteFile(char* fileName){
 	
 	UART_OutString("\n\r");
 	
-	OS_bSignal(&eFileMutex);
+	OS_MutexUnlock(&eFileMutex);
 	
 }
 
@@ -792,7 +1000,7 @@ void eFile_FormatDisk(void){
 	
 	int errCode = eFile_Format();
 	
-	OS_bWait(&eFileMutex);
+	OS_MutexLock(&eFileMutex);
 	
 	UART_OutString("\n\r");
 	
@@ -804,7 +1012,7 @@ void eFile_FormatDisk(void){
 	
 	UART_OutString("\n\r");
 	
-	OS_bSignal(&eFileMutex);
+	OS_MutexUnlock(&eFileMutex);
 	
 }
 
@@ -816,7 +1024,7 @@ void eFile_CreateFile(char* fileName){
 	
 	int errCode = eFile_Create(fileName);
 	
-	OS_bWait(&eFileMutex);
+	OS_MutexLock(&eFileMutex);
 	
 	UART_OutString("\n\r");
 	
@@ -829,7 +1037,7 @@ void eFile_CreateFile(char* fileName){
 	
 	UART_OutString("\n\r");
 	
-	OS_bSignal(&eFileMutex);
+	OS_MutexUnlock(&eFileMutex);
 	
 }
 
@@ -859,6 +1067,52 @@ void eFile_UnmountFS(void){
 	UART_OutString("\n\r");
 }
 
-
-
-
+//---------- eFile_Throughput-----------------
+// Used by interpreter to measure raw disk throughput for one run length
+// Moves BENCH_SECTORS scratch sectors past the formatted area, run sectors per eDisk call
+// The data written doesn't matter, so writes of any run come straight out of flash,
+// reads land in fileRunBuffer, a run longer than it is read as eDisk calls of up to EFILE_RUNSECTORS
+// The scheduler keeps running, the times include whatever higher priority threads take meanwhile
+// Input: sectors per transfer, must divide BENCH_SECTORS
+// Output: return by reference write and read throughput in KB/s, 0 if too fast to time
+//         0 if successful and 1 on failure (bad run, trouble with the disk)
+int eFile_Throughput(unsigned long run, unsigned long *writeKBps, unsigned long *readKBps){
+	
+	*writeKBps = 0;
+	*readKBps = 0;
+	if(run == 0 || BENCH_SECTORS % run){
+		return 1;
+	}
+	
+	OS_MutexLock(&eFileMutex);
+	
+	int errCode = 0;
+	const uint64_t benchBytes = (uint64_t)BENCH_SECTORS*BLOCK_SIZE;
+	uint32_t start = OS_Time();
+	for(int sector = 0; sector < BENCH_SECTORS && !errCode; sector += run){
+		errCode = diskWrite(&BENCH_FLASH[sector*BLOCK_SIZE], BENCH_SECTOR + sector, run);
+	}
+	uint32_t elapsed = OS_TimeDifference(start, OS_Time());
+	if(!errCode && elapsed){
+		*writeKBps = benchBytes*1000*TIME_1MS/(1024*(uint64_t)elapsed);
+	}
+	
+	if(!errCode){
+		start = OS_Time();
+		for(int sector = 0; sector < BENCH_SECTORS && !errCode; sector += run){
+			// each piece overwrites the last, only the time counts
+			for(int done = 0; done < run && !errCode; done += EFILE_RUNSECTORS){
+				int count = run - done < EFILE_RUNSECTORS ? run - done : EFILE_RUNSECTORS;
+				errCode = diskRead(fileRunBuffer, BENCH_SECTOR + sector + done, count);
+			}
+		}
+		elapsed = OS_TimeDifference(start, OS_Time());
+		if(!errCode && elapsed){
+			*readKBps = benchBytes*1000*TIME_1MS/(1024*(uint64_t)elapsed);
+		}
+	}
+	
+	OS_MutexUnlock(&eFileMutex);
+	
+	return errCode ? 1 : 0;
+}
@@ -59,6 +59,16 @@ int eFile_WOpen(const char name[]);      // open a file for writing
  */
 int eFile_Write(const char data);  
 
+/**
+ * @details Save a block of data at end of the open file. Sectors that follow each
+ * other on the disk are written with one multi-sector transfer
+ * @param  data bytes to be saved on the disk
+ * @param  size number of bytes
+ * @return 0 if successful and 1 on failure (e.g., trouble writing to flash, disk full)
+ * @brief  Write a block of data
+ */
+int eFile_WriteBuffer(const char data[], unsigned long size);
+
 /**
  * @details Close the file, leave disk in a state power can be removed.
  * This function will flush all RAM buffers to the disk.
@@ -83,6 +93,17 @@ int eFile_ROpen(const char name[]);      // open a file for reading
  * @brief  Retreive data from open file
  */
 int eFile_ReadNext(char *pt);       // get next byte 
+
+/**
+ * @details Read a block of data from the open file. Sectors that follow each
+ * other on the disk are read with one multi-sector transfer
+ * @param  data place to save the data
+ * @param  size most bytes to read
+ * @param  count call by reference number of bytes read, less than size at the end of the file
+ * @return 0 if successful and 1 on failure (e.g., trouble reading from flash, end of file)
+ * @brief  Retreive a block of data from open file
+ */
+int eFile_ReadBuffer(char data[], unsigned long size, unsigned long *count);
                               
 /**
  * @details Close the file, leave disk in a state power can be removed.
@@ -194,6 +215,18 @@ void eFile_WriteToFile(char* fileName, char* stringToWrite);
  */
 void eFile_UnmountFS(void);
 
+/**
+ * @details API for interpreter to measure disk throughput, overwrites scratch
+ * sectors past the area eFile_Format clears
+ * @param  run sectors per eDisk transfer, 1 to 64 dividing 64
+ * @param  writeKBps call by reference write throughput in KB/s
+ * @param  readKBps call by reference read throughput in KB/s, a run longer than eFile
+ *         buffers is read in pieces that fit
+ * @return 0 if successful and 1 on failure (e.g., bad run, trouble with the disk)
+ * @brief  measure disk throughput
+ */
+int eFile_Throughput(unsigned long run, unsigned long *writeKBps, unsigned long *readKBps);
+
 
 
 
@@ -110,6 +110,60 @@ void* Heap_Malloc(int32_t desiredBytes){
 }
 
 
+//******** Heap_MallocAligned *************** 
+// Allocate memory a power of 2 bytes in size and aligned to its size, data not initialized
+// input:
+//   desiredBytes: desired number of bytes to allocate, rounded up to a power of 2, at least 32
+// output: void* pointing to the allocated memory or will return NULL
+//   if there isn't sufficient space to satisfy allocation request
+// notes: one MPU region covers such a block and nothing else, see OS_AddProcess
+void* Heap_MallocAligned(int32_t desiredBytes){
+	
+	uint32_t alignedBytes = 32;
+	while(alignedBytes < (uint32_t)desiredBytes){
+		if(alignedBytes >= HEAP_SIZE*4){
+			return 0;
+		}
+		alignedBytes *= 2;
+	}
+	int32_t desiredBlocks = alignedBytes/4;
+	
+	long heapIdx = 0;
+	while(heapIdx < HEAP_SIZE){
+		int32_t availability = heap[heapIdx];
+		int32_t availabilityAbs = availability;
+		if(availability < 0){
+			availabilityAbs *= -1;
+			// blocks in front of the first aligned address of the free space
+			uintptr_t first = (uintptr_t)&heap[heapIdx + 1];
+			int32_t gap = (((first + alignedBytes - 1) & ~(uintptr_t)(alignedBytes - 1)) - first)/4;
+			// space left over in front or behind has to hold a free block with header and trailer
+			for(; gap + desiredBlocks <= availabilityAbs; gap += desiredBlocks){
+				int32_t rest = availabilityAbs - gap - desiredBlocks;
+				if((gap == 0 || gap >= 3) && (rest == 0 || rest >= 3)){
+					if(gap > 0){
+						heap[heapIdx] = (-1)*(gap - 2);
+						heap[heapIdx + gap - 1] = (-1)*(gap - 2);
+					}
+					int32_t blockIdx = heapIdx + gap;
+					heap[blockIdx] = desiredBlocks;
+					heap[blockIdx + desiredBlocks + 1] = desiredBlocks;
+					if(rest > 0){
+						heap[blockIdx + desiredBlocks + 2] = (-1)*(rest - 2);
+						heap[heapIdx + availabilityAbs + 1] = (-1)*(rest - 2);
+					}
+					return(&heap[blockIdx + 1]);
+				}
+			}
+		}
+		// get next header index, which is availabilityAbs + 2 blocks of overhead away
+		heapIdx += availabilityAbs + 2;
+	}
+	
+  return 0;   // NULL
+}
+
+
 //******** Heap_Calloc *************** 
 // Allocate memory, data are initialized to 0
 // input:
@@ -291,6 +345,30 @@ int32_t Heap_Free(void* pointer){
 }
 
 
+//******** Heap_Size *************** 
+// return the size of an allocated block
+// input: pointer to allocated memory
+// output: size of the block in bytes, which can be more than was asked for,
+//     -1 if the pointer is not an allocated block of the heap
+int32_t Heap_Size(void* pointer){
+	int32_t* allocationLocation = pointer;
+	
+	// same checks as Heap_Free
+	if((allocationLocation - 1) < heap || allocationLocation > &heap[HEAP_SIZE-1]){
+		return -1;
+	}
+	int32_t allocatedSpaceHeader = *(allocationLocation-1);
+	if(allocatedSpaceHeader < 0 || (allocationLocation + allocatedSpaceHeader) > &heap[HEAP_SIZE-1]){
+		return -1;
+	}
+	if(*(allocationLocation + allocatedSpaceHeader) != allocatedSpaceHeader){
+		return -1;
+	}
+	
+	return allocatedSpaceHeader*4;
+}
+
+
 //******** Heap_Stats *************** 
 // return the current status of the heap
 // input: reference to a heap_stats_t that returns the current usage of the heap
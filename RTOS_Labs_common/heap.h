@@ -43,6 +43,18 @@ int32_t Heap_Init(void);
 void* Heap_Malloc(int32_t desiredBytes);
 
 
+/**
+ * @details Allocate memory a power of 2 bytes in size and aligned to its size,
+ *          data not initialized. One MPU region covers exactly such a block
+ * @param  desiredBytes: desired number of bytes to allocate, rounded up
+ *         to a power of 2 of at least 32
+ * @return void* pointing to the allocated memory or will return NULL
+ *         if there isn't sufficient space to satisfy allocation request
+ * @brief  Allocate memory for an MPU region
+ */
+void* Heap_MallocAligned(int32_t desiredBytes);
+
+
 /**
  * @details Allocate memory, allocated memory is initialized to 0 (zeroed out)
  * @param  desiredBytes: desired number of bytes to allocate
@@ -75,6 +87,17 @@ void* Heap_Realloc(void* oldBlock, int32_t desiredBytes);
 int32_t Heap_Free(void* pointer);
 
 
+/**
+ * @details Return the size of an allocated block, which can be larger
+ *          than the number of bytes asked for when it was allocated
+ * @param  pointer to allocated memory
+ * @return size of the block in bytes, -1 if the pointer is not an
+ *         allocated block of the heap
+ * @brief  Get block size
+ */
+int32_t Heap_Size(void* pointer);
+
+
 /**
  * @details Return the current usage status of the heap
  * @param  reference to a heap_stats_t that returns the current usage of the heap
@@ -0,0 +1,272 @@
+// *************HostDevices.c**************
+// Device models for the host port of the OS
+// The real mpu6050.c and digitalServo.c run on top of an I2C0 with a simulated MPU6050
+// behind it and a PWM0A that records the pulse lengths it is given
+// eFile.c runs on an eDisk that keeps the SD card in RAM and counts the writes to each sector
+// UART, interpreter and LCD output goes to stdout, printf can't be redirected into a file
+// Every model charges the bus cycles the polling driver would spend on the TM4C123
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "../../RTOS_Labs_common/host/HostPort.h"
+#include "../../RTOS_Labs_common/OS.h"
+#include "../../RTOS_Labs_common/UART0int.h"
+#include "../../RTOS_Labs_common/ST7735.h"
+#include "../../RTOS_Labs_common/Interpreter.h"
+#include "../../RTOS_Labs_common/eDisk.h"
+#include "../../inc/I2C0.h"
+#include "../../inc/PWM.h"
+
+#define I2CBITCYCLES		800		// 100 kbps at 80 MHz
+#define LCDCHARCYCLES		6000	// one 8x6 character at 16 bits per pixel over a 10 MHz SSI
+#define UARTCHARCYCLES	6944	// 115200 bps, 10 bits per character
+#define DISKSECTORCYCLES	32768	// one 512 byte sector over a 10 MHz SSI
+#define DISKCMDCYCLES			8000	// command, response and the card's access time, 100us
+#define DISKBUSYCYCLES		40000	// the card programming its flash once a write ends, 500us
+
+#define DISK_SECTORS			1024	// 512KB, more than eFile and its benchmark use
+
+#define MPU6050_I2C_ADDR	0x68
+#define WHO_AM_I_REG			0x75
+#define ACCEL_XOUT_H_REG	0x3B
+
+// raw offsets of the simulated sensor, what the calibration has to take out
+#define MPU6050_X_BIAS		180
+#define MPU6050_Y_BIAS		-95
+#define MPU6050_Z_BIAS		-410
+#define MPU6050_TILT			6000	// peak x acceleration of the simulated tilting, 1g is 16384
+#define MPU6050_TILTSTART	2000	// ms, the handle is held still until then
+#define MPU6050_TILTPERIOD	1600	// ms
+
+static uint8_t MPU6050Register = 0;
+static uint32_t MPU6050Noise = 12345;
+static uint32_t AccelReads = 0;
+
+static uint16_t ServoPulse = 0;
+static uint16_t ServoPulseMin = 0xFFFF;
+static uint16_t ServoPulseMax = 0;
+static uint32_t ServoUpdates = 0;
+
+static uint8_t Disk[DISK_SECTORS][512];
+uint32_t HostDiskWrites[DISK_SECTORS];		// times each sector has been written
+static uint32_t DiskTransfers = 0;
+
+// deterministic +-127 noise from a linear congruential generator
+static int32_t mpu6050Noise(void){
+	MPU6050Noise = MPU6050Noise*1103515245 + 12345;
+	return (int32_t)((MPU6050Noise >> 16)&0xFF) - 128;
+}
+
+// acceleration along one axis at the current simulated time, a triangle wave tilt on x
+static int16_t mpu6050Accel(uint8_t reg){
+	uint32_t ms = HostCycles/TIME_1MS;
+	int32_t tilt = 0;
+	if(ms >= MPU6050_TILTSTART){
+		int32_t phase = (ms - MPU6050_TILTSTART)%MPU6050_TILTPERIOD;
+		int32_t quarter = MPU6050_TILTPERIOD/4;
+		if(phase < quarter){
+			tilt = MPU6050_TILT*phase/quarter;
+		}else if(phase < 3*quarter){
+			tilt = MPU6050_TILT*(2*quarter - phase)/quarter;
+		}else{
+			tilt = MPU6050_TILT*(phase - 4*quarter)/quarter;
+		}
+	}
+	switch(reg){
+	 case ACCEL_XOUT_H_REG:
+		return MPU6050_X_BIAS + tilt + mpu6050Noise();
+	 case ACCEL_XOUT_H_REG + 2:
+		return MPU6050_Y_BIAS + mpu6050Noise();
+	 case ACCEL_XOUT_H_REG + 4:
+		return 16384 + MPU6050_Z_BIAS - tilt/8 + mpu6050Noise();
+	 default:
+		return 0;
+	}
+}
+
+
+//*************** I2C0.h ***************
+
+void I2C_Init(void){
+}
+
+uint8_t I2C_Recv(int8_t slave){
+	HostConsume(20*I2CBITCYCLES);
+	if(MPU6050Register == WHO_AM_I_REG){
+		return MPU6050_I2C_ADDR;
+	}
+	return 0;
+}
+
+uint16_t I2C_Recv2(int8_t slave){
+	HostConsume(29*I2CBITCYCLES);
+	if(MPU6050Register == ACCEL_XOUT_H_REG){
+		AccelReads++;
+	}
+	return (uint16_t)mpu6050Accel(MPU6050Register);
+}
+
+uint32_t I2C_Send1(int8_t slave, uint8_t data1){
+	HostConsume(20*I2CBITCYCLES);
+	MPU6050Register = data1;
+	return 0;
+}
+
+uint32_t I2C_Send2(int8_t slave, uint8_t data1, uint8_t data2){
+	HostConsume(29*I2CBITCYCLES);
+	MPU6050Register = data1;
+	return 0;
+}
+
+uint32_t I2C_Send3(int8_t slave, uint8_t data1, uint8_t data2, uint8_t data3){
+	HostConsume(38*I2CBITCYCLES);
+	MPU6050Register = data1;
+	return 0;
+}
+
+
+//*************** PWM.h ***************
+
+void PWM0A_Init(uint16_t period, uint16_t duty){
+	ServoPulse = duty;
+}
+
+void PWM0A_Duty(uint16_t duty){
+	ServoPulse = duty;
+	ServoUpdates++;
+	if(duty < ServoPulseMin){
+		ServoPulseMin = duty;
+	}
+	if(duty > ServoPulseMax){
+		ServoPulseMax = duty;
+	}
+}
+
+
+//*************** UART0int.h ***************
+
+void UART_Init(void){
+}
+
+void UART_OutChar(char data){
+	HostConsume(UARTCHARCYCLES);
+	putchar(data);
+}
+
+void UART_OutString(char *pt){
+	while(*pt){
+		UART_OutChar(*pt);
+		pt++;
+	}
+}
+
+void UART_OutUDec(uint32_t n){
+	char buffer[12];
+	snprintf(buffer, sizeof(buffer), "%u", n);
+	UART_OutString(buffer);
+}
+
+void UART_OutSDec(long n){
+	char buffer[24];
+	snprintf(buffer, sizeof(buffer), "%ld", n);
+	UART_OutString(buffer);
+}
+
+void UART_OutUHex(uint32_t number){
+	char buffer[12];
+	snprintf(buffer, sizeof(buffer), "%X", number);
+	UART_OutString(buffer);
+}
+
+
+//*************** Interpreter.h ***************
+
+// there is no telnet session on the host, the interpreter only talks to the UART
+void Interpreter_OutString(char *s){
+	UART_OutString(s);
+}
+
+
+//*************** eDisk.h ***************
+
+DSTATUS eDisk_Init(BYTE drive){
+	return drive ? STA_NOINIT : 0;
+}
+
+DSTATUS eDisk_Status(BYTE drive){
+	return drive ? STA_NOINIT : 0;
+}
+
+DRESULT eDisk_Read(BYTE drv, BYTE *buff, DWORD sector, UINT count){
+	if(drv || count == 0 || sector + count > DISK_SECTORS){
+		return RES_PARERR;
+	}
+	HostConsume(DISKCMDCYCLES + count*DISKSECTORCYCLES);
+	memcpy(buff, Disk[sector], count*512);
+	DiskTransfers++;
+	return RES_OK;
+}
+
+DRESULT eDisk_ReadBlock(BYTE *buff, DWORD sector){
+	return eDisk_Read(0, buff, sector, 1);
+}
+
+DRESULT eDisk_Write(BYTE drv, const BYTE *buff, DWORD sector, UINT count){
+	if(drv || count == 0 || sector + count > DISK_SECTORS){
+		return RES_PARERR;
+	}
+	HostConsume(DISKCMDCYCLES + count*DISKSECTORCYCLES + DISKBUSYCYCLES);
+	memcpy(Disk[sector], buff, count*512);
+	for(UINT i = 0; i < count; i++){
+		HostDiskWrites[sector + i]++;
+	}
+	DiskTransfers++;
+	return RES_OK;
+}
+
+DRESULT eDisk_WriteBlock(const BYTE *buff, DWORD sector){
+	return eDisk_Write(0, buff, sector, 1);
+}
+
+
+//*************** OS.h stream I/O ***************
+
+int OS_RedirectToFile(const char *name){
+	return 1;
+}
+
+int OS_EndRedirectToFile(void){
+	return 1;
+}
+
+
+//*************** ST7735.h ***************
+
+// the SSI is shared with the SD card, eFile.c holds this for each transfer
+MutexType LCDFree;
+
+void ST7735_InitR(enum initRFlags option){
+}
+
+uint32_t ST7735_DrawString(uint16_t x, uint16_t y, char *pt, int16_t textColor){
+	HostConsume(strlen(pt)*LCDCHARCYCLES);
+	printf("lcd %u,%u: %s\n", x, y, pt);
+	return strlen(pt);
+}
+
+void ST7735_Message(uint32_t d, uint32_t l, char *pt, int32_t value){
+	HostConsume((strlen(pt) + 6)*LCDCHARCYCLES);
+	printf("lcd %u,%u: %s %d\n", d, l, pt, (int)value);
+}
+
+
+void HostDevicesReport(void){
+	printf("  mpu6050: %u accelerometer reads\n", AccelReads);
+	printf("  servo: %u pulse updates, last %u, range %u to %u\n",
+		ServoUpdates, ServoPulse, ServoUpdates ? ServoPulseMin : ServoPulse, ServoUpdates ? ServoPulseMax : ServoPulse);
+	if(DiskTransfers){
+		printf("  disk: %u transfers\n", DiskTransfers);
+	}
+}
@@ -0,0 +1,467 @@
+// *************HostPort.c**************
+// Host (POSIX) port of the OS for simulation and benchmarking
+// Simulates the parts of the TM4C123 the OS depends on: PRIMASK, the NVIC,
+// SysTick, Timer5A, WTIMER5, the WTIMER0A one-shot behind the periodic threads and PendSV
+// Threads run on ucontext stacks, PendSV swaps them where osasm.s swaps stack pointers
+//
+// Time is virtual, it only advances when the running code says it spent cycles:
+// StartCritical, exception entry, PendSV, HostConsume from the device models and
+// WaitForInterrupt, which jumps ahead to the next timer event.
+// Interrupts are taken at those points, never in the middle of other C code,
+// and handlers don't nest, one that comes due inside a handler runs right after it.
+// A thread that spins without calling into the OS or a device never lets time pass.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <ucontext.h>
+#include "../../RTOS_Labs_common/host/HostPort.h"
+#include "../../RTOS_Labs_common/OS.h"
+#include "../../RTOS_Labs_common/Trace.h"
+
+#define HOST_STACKSIZE	(64*1024)	// bytes, host code such as printf needs far more than the target stacks
+#define HOST_NO_EVENT		UINT64_MAX
+
+// exceptions the port can raise, exception numbers break ties between equal priorities
+enum HostIrq{
+	IRQ_TIMER5A,
+	IRQ_WTIMER0A,
+	IRQ_SYSTICK,
+	IRQ_PENDSV,
+	IRQ_NUM
+};
+static const int32_t HostExceptionNumber[IRQ_NUM] = {108, 110, 15, 14};
+
+extern struct TCB* RunPt;
+extern int32_t** StackPt;
+extern int threadId;
+void SysTick_Handler(void);
+void Timer5A_Handler(void);
+void WideTimer0A_Handler(void);
+void OS_ThreadSwitched(void);
+
+struct HostRegisters HostRegs;
+uint64_t HostCycles = 0;
+
+static bool HostPrimask = false;					// I bit, interrupts come out of reset enabled
+static bool HostInHandler = false;
+static bool HostPending[IRQ_NUM];
+static uint32_t Timer5Reload = 0;				// TIMER5_TAILR_R the last time the timer was brought up to date
+static uint64_t WideTimer5Count = 0;
+static uint32_t NvicEnabled2 = 0;					// interrupts 64 to 95 enabled in the NVIC
+static bool WideTimer0Enabled = false;		// WTIMER0_CTL_R enable bit the last time the timer was brought up to date
+static bool HostLaunched = false;
+static uint64_t HostEndCycles = HOST_NO_EVENT;
+static uint32_t HostSwitches = 0;
+static FILE* HostTraceFile = NULL;
+static const char* HostTestName = NULL;		// set while the run is a test
+static uint32_t HostChecks = 0;
+static uint32_t HostCheckFailures = 0;
+
+// apply the side effects of register writes made since the last access
+static void hostSync(void){
+	// INTCTRL PENDSVSET
+	if(HostRegs.NVIC_INT_CTRL&0x10000000){
+		HostPending[IRQ_PENDSV] = true;
+	}
+	HostRegs.NVIC_INT_CTRL = 0;
+
+	// NVIC set enable is write one to set, clear enable and clear pending are write one to clear
+	NvicEnabled2 = (NvicEnabled2|HostRegs.NVIC_EN2)&~HostRegs.NVIC_DIS2;
+	HostRegs.NVIC_EN2 = NvicEnabled2;
+	HostRegs.NVIC_DIS2 = 0;
+	if(HostRegs.NVIC_UNPEND2&(1<<28)){
+		HostPending[IRQ_TIMER5A] = false;
+	}
+	HostRegs.NVIC_UNPEND2 = 0;
+
+	// peripherals are ready as soon as their clock is on
+	HostRegs.SYSCTL_PRGPIO = HostRegs.SYSCTL_RCGCGPIO;
+	HostRegs.SYSCTL_PRWTIMER = HostRegs.SYSCTL_RCGCWTIMER;
+
+	// a new interval load value goes into the counter right away
+	if(HostRegs.TIMER5_TAILR != Timer5Reload){
+		Timer5Reload = HostRegs.TIMER5_TAILR;
+		HostRegs.TIMER5_TAV = Timer5Reload;
+	}
+	HostRegs.TIMER5_RIS &= ~HostRegs.TIMER5_ICR;
+	HostRegs.TIMER5_ICR = 0;
+
+	// a one-shot timer loads its interval when it is enabled
+	if((HostRegs.WTIMER0_CTL&0x01) && !WideTimer0Enabled){
+		HostRegs.WTIMER0_TAV = HostRegs.WTIMER0_TAILR;
+	}
+	WideTimer0Enabled = HostRegs.WTIMER0_CTL&0x01;
+	HostRegs.WTIMER0_RIS &= ~HostRegs.WTIMER0_ICR;
+	HostRegs.WTIMER0_ICR = 0;
+
+	HostRegs.WTIMER5_TAV = (uint32_t)WideTimer5Count;
+	HostRegs.WTIMER5_TBV = (uint32_t)(WideTimer5Count >> 32);
+}
+
+volatile uint32_t* HostRegister(volatile uint32_t* reg){
+	hostSync();
+	return reg;
+}
+
+// cycles until a down counter with this count and reload times out, a count of 0 has just timed out
+static uint64_t countdownRemaining(uint32_t count, uint32_t reload){
+	return count ? count : (uint64_t)reload + 1;
+}
+
+static bool sysTickRunning(void){
+	return HostRegs.NVIC_ST_CTRL&NVIC_ST_CTRL_ENABLE;
+}
+
+static bool timer5Running(void){
+	return HostRegs.TIMER5_CTL&0x01;
+}
+
+static bool wideTimer0Running(void){
+	return HostRegs.WTIMER0_CTL&0x01;
+}
+
+static bool hostEnabled(int irq){
+	switch(irq){
+	 case IRQ_TIMER5A:
+		return HostRegs.NVIC_EN2&(1<<28);
+	 case IRQ_WTIMER0A:
+		return HostRegs.NVIC_EN2&(1<<30);
+	 case IRQ_SYSTICK:
+		return HostRegs.NVIC_ST_CTRL&NVIC_ST_CTRL_INTEN;
+	 default:
+		return true;
+	}
+}
+
+static uint32_t hostPriority(int irq){
+	switch(irq){
+	 case IRQ_TIMER5A:
+		return (HostRegs.NVIC_PRI23 >> 5)&0x07;
+	 case IRQ_WTIMER0A:
+		return (HostRegs.NVIC_PRI23 >> 21)&0x07;
+	 case IRQ_SYSTICK:
+		return (HostRegs.NVIC_SYS_PRI3 >> 29)&0x07;
+	 default:
+		return (HostRegs.NVIC_SYS_PRI3 >> 21)&0x07;
+	}
+}
+
+// the pending, enabled exception the NVIC would take next, -1 if there is none
+static int hostNextPending(void){
+	int next = -1;
+	for(int irq = 0; irq < IRQ_NUM; irq++){
+		if(!HostPending[irq] || !hostEnabled(irq)){
+			continue;
+		}
+		if(next < 0 || hostPriority(irq) < hostPriority(next) ||
+			(hostPriority(irq) == hostPriority(next) && HostExceptionNumber[irq] < HostExceptionNumber[next])){
+			next = irq;
+		}
+	}
+	return next;
+}
+
+// cycles until the next timer times out, HOST_NO_EVENT if no timer is running
+static uint64_t hostNextEvent(void){
+	uint64_t next = HOST_NO_EVENT;
+	if(sysTickRunning()){
+		uint64_t remaining = countdownRemaining(HostRegs.NVIC_ST_CURRENT, HostRegs.NVIC_ST_RELOAD);
+		if(remaining < next){
+			next = remaining;
+		}
+	}
+	if(timer5Running()){
+		uint64_t remaining = countdownRemaining(HostRegs.TIMER5_TAV, HostRegs.TIMER5_TAILR);
+		if(remaining < next){
+			next = remaining;
+		}
+	}
+	if(wideTimer0Running()){
+		uint64_t remaining = countdownRemaining(HostRegs.WTIMER0_TAV, HostRegs.WTIMER0_TAILR);
+		if(remaining < next){
+			next = remaining;
+		}
+	}
+	return next;
+}
+
+// run every timer forward, step can't go past the next event
+static void hostStep(uint64_t step){
+	HostCycles += step;
+	if(HostRegs.WTIMER5_CTL&0x01){
+		WideTimer5Count += step;
+	}
+	if(sysTickRunning()){
+		HostRegs.NVIC_ST_CURRENT = countdownRemaining(HostRegs.NVIC_ST_CURRENT, HostRegs.NVIC_ST_RELOAD) - step;
+		if(HostRegs.NVIC_ST_CURRENT == 0 && (HostRegs.NVIC_ST_CTRL&NVIC_ST_CTRL_INTEN)){
+			HostPending[IRQ_SYSTICK] = true;
+		}
+	}
+	if(timer5Running()){
+		HostRegs.TIMER5_TAV = countdownRemaining(HostRegs.TIMER5_TAV, HostRegs.TIMER5_TAILR) - step;
+		if(HostRegs.TIMER5_TAV == 0){
+			HostRegs.TIMER5_RIS |= TIMER_RIS_TATORIS;
+			// the NVIC latches the timeout, it stays pending after the flag is cleared
+			if(HostRegs.TIMER5_IMR&0x01){
+				HostPending[IRQ_TIMER5A] = true;
+			}
+		}
+	}
+	if(wideTimer0Running()){
+		HostRegs.WTIMER0_TAV = countdownRemaining(HostRegs.WTIMER0_TAV, HostRegs.WTIMER0_TAILR) - step;
+		if(HostRegs.WTIMER0_TAV == 0){
+			// one-shot, the timer stops itself at the timeout
+			HostRegs.WTIMER0_RIS |= TIMER_RIS_TATORIS;
+			HostRegs.WTIMER0_CTL &= ~0x01;
+			WideTimer0Enabled = false;
+			if(HostRegs.WTIMER0_IMR&0x01){
+				HostPending[IRQ_WTIMER0A] = true;
+			}
+		}
+	}
+	hostSync();
+}
+
+static void hostDeliver(void);
+static void hostFinish(void);
+
+// let cycles of virtual time pass, taking interrupts as they come due
+static void hostAdvance(uint64_t cycles){
+	hostSync();
+	while(cycles){
+		uint64_t step = hostNextEvent();
+		if(step > cycles){
+			step = cycles;
+		}
+		hostStep(step);
+		cycles -= step;
+		if(HostLaunched && HostCycles >= HostEndCycles){
+			hostFinish();
+		}
+		hostDeliver();
+	}
+}
+
+// what PendSV_Handler in osasm.s does, with a ucontext in place of the saved registers
+static void hostPendSV(void){
+	HostPrimask = true;
+	hostAdvance(HOST_PENDSV_CYCLES);
+	struct TCB* outgoing = (struct TCB*)StackPt;
+	OS_ThreadSwitched();
+	StackPt = &(RunPt->stackPt);
+	struct TCB* incoming = RunPt;
+	if(incoming != outgoing){
+		HostSwitches++;
+		swapcontext(&(outgoing->hostContext), &(incoming->hostContext));
+	}
+	HostPrimask = false;
+}
+
+// take every pending exception, highest priority first, once the running code can be interrupted
+static void hostDeliver(void){
+	if(HostPrimask || HostInHandler){
+		return;
+	}
+	HostInHandler = true;
+	int irq;
+	while((irq = hostNextPending()) >= 0){
+		HostPending[irq] = false;
+		hostAdvance(HOST_EXCEPTION_CYCLES);
+		switch(irq){
+		 case IRQ_TIMER5A:
+			Timer5A_Handler();
+			// level sensitive, an unacknowledged timeout asks again
+			hostSync();
+			if(HostRegs.TIMER5_RIS&HostRegs.TIMER5_IMR&0x01){
+				HostPending[IRQ_TIMER5A] = true;
+			}
+			break;
+		 case IRQ_WTIMER0A:
+			WideTimer0A_Handler();
+			hostSync();
+			if(HostRegs.WTIMER0_RIS&HostRegs.WTIMER0_IMR&0x01){
+				HostPending[IRQ_WTIMER0A] = true;
+			}
+			break;
+		 case IRQ_SYSTICK:
+			SysTick_Handler();
+			break;
+		 case IRQ_PENDSV:
+			hostPendSV();
+			break;
+		}
+	}
+	HostInHandler = false;
+}
+
+// the first thing a new thread runs, on its own host stack
+static void hostThreadEntry(void){
+	// an exception return into the thread, with interrupts enabled
+	HostInHandler = false;
+	HostPrimask = false;
+	void (*task)(void) = RunPt->hostTask;
+	hostDeliver();
+	// the initial LR is the task, so a task that returns starts over
+	for(;;){
+		task();
+	}
+}
+
+void HostThreadInit(struct TCB* tcb, void(*task)(void)){
+	if(tcb->hostStack == NULL){
+		tcb->hostStack = malloc(HOST_STACKSIZE);
+		if(tcb->hostStack == NULL){
+			fprintf(stderr, "host: out of memory for thread stacks\n");
+			exit(1);
+		}
+	}
+	tcb->hostTask = task;
+	getcontext(&(tcb->hostContext));
+	tcb->hostContext.uc_stack.ss_sp = tcb->hostStack;
+	tcb->hostContext.uc_stack.ss_size = HOST_STACKSIZE;
+	tcb->hostContext.uc_link = NULL;
+	makecontext(&(tcb->hostContext), hostThreadEntry, 0);
+}
+
+void HostConsume(uint32_t cycles){
+	hostAdvance(cycles);
+}
+
+static void hostTraceOutChar(char data){
+	fputc(data, HostTraceFile);
+}
+
+// print the per thread statistics, save the trace if HOST_SIM_TRACE names a file, and end the run
+// a test that gets here never reached HostTestEnd
+static void hostFinish(void){
+	HostPrimask = true;
+	HostLaunched = false;
+	if(HostTestName){
+		printf("%s: FAILED, did not finish, %u checks, %u failed\n", HostTestName, HostChecks, HostCheckFailures);
+		fflush(stdout);
+		exit(1);
+	}
+	printf("host: %llu cycles, %llu ms, %u thread switches\n",
+		(unsigned long long)HostCycles, (unsigned long long)(HostCycles/TIME_1MS), HostSwitches);
+	printf("  id pri   runTime(cycles) share switches preempted voluntary stack\n");
+	for(int id = 0; id < threadId; id++){
+		ThreadStatsType threadStats;
+		StackStatsType stackStats;
+		if(!OS_ThreadStats(id, &threadStats) || !OS_StackStats(id, &stackStats)){
+			continue;
+		}
+		printf("  %2d %3d %17llu %3u.%u %8u %9u %9u %3u/%u%s", id, (int)threadStats.priority,
+			(unsigned long long)threadStats.runTime, threadStats.share/10, threadStats.share%10,
+			threadStats.switchesIn, threadStats.preemptions, threadStats.voluntarySwitches,
+			stackStats.peakUsed, stackStats.size, stackStats.overflowed ? " overflow" : "");
+		if(threadStats.jobs){
+			printf(" %u jobs, %u deadline misses", threadStats.jobs, threadStats.deadlineMisses);
+		}
+		printf("\n");
+	}
+	PeriodicStatsType periodicStats;
+	for(uint32_t i = 0; OS_PeriodicStats(i, &periodicStats); i++){
+		printf("  periodic %u: period %u, priority %u, %u releases, %u overruns, max jitter %u cycles\n",
+			i, periodicStats.period, periodicStats.priority, periodicStats.releases,
+			periodicStats.overruns, periodicStats.maxJitter);
+	}
+	HostDevicesReport();
+	char* traceName = getenv("HOST_SIM_TRACE");
+	if(traceName){
+		HostTraceFile = fopen(traceName, "wb");
+		if(HostTraceFile){
+			printf("  trace: %u records saved to %s\n", Trace_Dump(hostTraceOutChar), traceName);
+			fclose(HostTraceFile);
+		}
+	}
+	fflush(stdout);
+	exit(0);
+}
+
+void HostTestBegin(const char* name){
+	HostTestName = name;
+	HostChecks = 0;
+	HostCheckFailures = 0;
+}
+
+void HostCheck(bool passed, const char* condition, const char* file, int line){
+	HostChecks++;
+	if(!passed){
+		HostCheckFailures++;
+		printf("%s:%d: check failed: %s\n", file, line, condition);
+	}
+}
+
+void HostTestEnd(void){
+	HostPrimask = true;
+	printf("%s: %s, %u checks, %u failed, %llu ms\n", HostTestName ? HostTestName : "host",
+		HostCheckFailures ? "FAILED" : "passed", HostChecks, HostCheckFailures,
+		(unsigned long long)(HostCycles/TIME_1MS));
+	fflush(stdout);
+	exit(HostCheckFailures ? 1 : 0);
+}
+
+
+//*************** CortexM.h ***************
+
+void DisableInterrupts(void){
+	HostPrimask = true;
+}
+
+void EnableInterrupts(void){
+	HostPrimask = false;
+	hostDeliver();
+}
+
+long StartCritical(void){
+	hostAdvance(HOST_CRITICAL_CYCLES);
+	long sr = HostPrimask;
+	HostPrimask = true;
+	return sr;
+}
+
+void EndCritical(long sr){
+	HostPrimask = sr;
+	hostDeliver();
+}
+
+// sleep until an interrupt is pending, even one that PRIMASK keeps from being taken
+void WaitForInterrupt(void){
+	hostSync();
+	while(hostNextPending() < 0){
+		uint64_t next = hostNextEvent();
+		if(next == HOST_NO_EVENT){
+			printf("host: no interrupt left to wait for\n");
+			hostFinish();
+		}
+		// take nothing while advancing, the wait ends with the first pending interrupt
+		bool primask = HostPrimask;
+		HostPrimask = true;
+		hostAdvance(next);
+		HostPrimask = primask;
+	}
+	hostDeliver();
+}
+
+
+//*************** osasm.s ***************
+
+void StartOS(void){
+	HostPrimask = true;
+	HostLaunched = true;
+	uint64_t simMs = HOST_SIM_MS_DEFAULT;
+	char* simMsEnv = getenv("HOST_SIM_MS");
+	if(simMsEnv){
+		simMs = strtoull(simMsEnv, NULL, 10);
+	}
+	HostEndCycles = HostCycles + simMs*TIME_1MS;
+	setcontext(&(((struct TCB*)StackPt)->hostContext));
+}
+
+
+//*************** PLL.h ***************
+
+void PLL_Init(uint32_t freq){
+}
@@ -0,0 +1,264 @@
+// *************HostPort.h**************
+// Host (POSIX) port of the OS for simulation and benchmarking
+// Stands in for tm4c123gh6pm.h and CortexM.h when built with -DHOST_SIM
+// Every register the OS touches is a field of HostRegs, accessed through HostRegister
+// so the simulated SysTick, Timer5A, WTIMER0A and WTIMER5 see the writes before the next access
+// Time is counted in virtual 12.5ns bus cycles, the same units as OS_Time,
+// so every run of the same program produces the same measurements
+//
+// build and run the stabilizer on the host, from the top of the repository:
+//   gcc -std=gnu99 -DHOST_SIM -O1 -Wno-pointer-to-int-cast -o stabilizer_sim stabilizer-handle/main.c
+//       RTOS_Labs_common/OS.c RTOS_Labs_common/Trace.c RTOS_Labs_common/heap.c RTOS_Labs_common/mpu6050.c
+//       RTOS_Labs_common/digitalServo.c inc/LPF.c
+//       RTOS_Labs_common/host/HostPort.c RTOS_Labs_common/host/HostDevices.c
+//   HOST_SIM_MS=3000 ./stabilizer_sim
+// the run stops after HOST_SIM_MS simulated ms and prints the per thread statistics,
+// HOST_SIM_TRACE=trace.bin also saves the kernel trace for tools/trace2chrome.py
+// thread code runs on host stacks, so the stack peaks only reflect the initial register frame
+//
+// the kernel tests in RTOS_Labs_common/host/tests build the same way, with the test in place of main.c
+// and without the stabilizer's drivers, for example:
+//   gcc -std=gnu99 -DHOST_SIM -O1 -Wno-pointer-to-int-cast -o wait_queue_test
+//       RTOS_Labs_common/host/tests/WaitQueueTest.c RTOS_Labs_common/OS.c RTOS_Labs_common/Trace.c
+//       RTOS_Labs_common/heap.c RTOS_Labs_common/host/HostPort.c RTOS_Labs_common/host/HostDevices.c
+//   ./wait_queue_test
+// a test exits with 0 only if every HOST_CHECK passed and it reached HostTestEnd within HOST_SIM_MS
+
+#ifndef __HOSTPORT_H
+#define __HOSTPORT_H  1
+#include <stdint.h>
+#include <stdbool.h>
+
+// virtual cycles charged for work that has no C code on the host
+#define HOST_CRITICAL_CYCLES	8			// StartCritical, the kernel call around it is not counted separately
+#define HOST_EXCEPTION_CYCLES	12		// exception entry, register stacking
+#define HOST_PENDSV_CYCLES		40		// PendSV_Handler in osasm.s
+
+#define HOST_SIM_MS_DEFAULT		3000	// simulated ms when HOST_SIM_MS isn't set
+
+// memory mapped registers used by the OS and main, as plain memory
+struct HostRegisters{
+	volatile uint32_t GPIO_PORTD_AFSEL;
+	volatile uint32_t GPIO_PORTD_AMSEL;
+	volatile uint32_t GPIO_PORTD_DEN;
+	volatile uint32_t GPIO_PORTD_DIR;
+	volatile uint32_t GPIO_PORTD_PCTL;
+	volatile uint32_t GPIO_PORTF_AFSEL;
+	volatile uint32_t GPIO_PORTF_AMSEL;
+	volatile uint32_t GPIO_PORTF_CR;
+	volatile uint32_t GPIO_PORTF_DATA;
+	volatile uint32_t GPIO_PORTF_DEN;
+	volatile uint32_t GPIO_PORTF_DIR;
+	volatile uint32_t GPIO_PORTF_IBE;
+	volatile uint32_t GPIO_PORTF_ICR;
+	volatile uint32_t GPIO_PORTF_IEV;
+	volatile uint32_t GPIO_PORTF_IM;
+	volatile uint32_t GPIO_PORTF_IS;
+	volatile uint32_t GPIO_PORTF_LOCK;
+	volatile uint32_t GPIO_PORTF_PCTL;
+	volatile uint32_t GPIO_PORTF_PUR;
+	volatile uint32_t GPIO_PORTF_RIS;
+	volatile uint32_t NVIC_INT_CTRL;
+	volatile uint32_t NVIC_DIS2;
+	volatile uint32_t NVIC_EN0;
+	volatile uint32_t NVIC_EN2;
+	volatile uint32_t NVIC_FAULT_STAT;
+	volatile uint32_t NVIC_FPCC;
+	volatile uint32_t NVIC_FAULT_ADDR;
+	volatile uint32_t NVIC_HFAULT_STAT;
+	volatile uint32_t NVIC_MM_ADDR;
+	volatile uint32_t NVIC_MPU_ATTR;
+	volatile uint32_t NVIC_MPU_BASE;
+	volatile uint32_t NVIC_MPU_CTRL;
+	volatile uint32_t NVIC_MPU_NUMBER;
+	volatile uint32_t NVIC_PRI7;
+	volatile uint32_t NVIC_PRI23;
+	volatile uint32_t NVIC_SYS_HND_CTRL;
+	volatile uint32_t NVIC_SYS_PRI3;
+	volatile uint32_t NVIC_UNPEND2;
+	volatile uint32_t NVIC_ST_CTRL;
+	volatile uint32_t NVIC_ST_CURRENT;
+	volatile uint32_t NVIC_ST_RELOAD;
+	volatile uint32_t SYSCTL_PRGPIO;
+	volatile uint32_t SYSCTL_PRWTIMER;
+	volatile uint32_t SYSCTL_RCGCGPIO;
+	volatile uint32_t SYSCTL_RCGCTIMER;
+	volatile uint32_t SYSCTL_RCGCWTIMER;
+	volatile uint32_t TIMER5_CFG;
+	volatile uint32_t TIMER5_CTL;
+	volatile uint32_t TIMER5_ICR;
+	volatile uint32_t TIMER5_IMR;
+	volatile uint32_t TIMER5_RIS;
+	volatile uint32_t TIMER5_TAILR;
+	volatile uint32_t TIMER5_TAMR;
+	volatile uint32_t TIMER5_TAPR;
+	volatile uint32_t TIMER5_TAV;
+	volatile uint32_t WTIMER0_CFG;
+	volatile uint32_t WTIMER0_CTL;
+	volatile uint32_t WTIMER0_ICR;
+	volatile uint32_t WTIMER0_IMR;
+	volatile uint32_t WTIMER0_RIS;
+	volatile uint32_t WTIMER0_TAILR;
+	volatile uint32_t WTIMER0_TAMR;
+	volatile uint32_t WTIMER0_TAPR;
+	volatile uint32_t WTIMER0_TAV;
+	volatile uint32_t WTIMER5_CFG;
+	volatile uint32_t WTIMER5_CTL;
+	volatile uint32_t WTIMER5_TAILR;
+	volatile uint32_t WTIMER5_TAMR;
+	volatile uint32_t WTIMER5_TAV;
+	volatile uint32_t WTIMER5_TBILR;
+	volatile uint32_t WTIMER5_TBV;
+};
+extern struct HostRegisters HostRegs;
+
+// brings the simulated peripherals up to date with earlier writes, then returns reg
+volatile uint32_t* HostRegister(volatile uint32_t* reg);
+#define HOST_REGISTER(name)		(*HostRegister(&HostRegs.name))
+
+#define GPIO_PORTD_AFSEL_R		HOST_REGISTER(GPIO_PORTD_AFSEL)
+#define GPIO_PORTD_AMSEL_R		HOST_REGISTER(GPIO_PORTD_AMSEL)
+#define GPIO_PORTD_DEN_R			HOST_REGISTER(GPIO_PORTD_DEN)
+#define GPIO_PORTD_DIR_R			HOST_REGISTER(GPIO_PORTD_DIR)
+#define GPIO_PORTD_PCTL_R			HOST_REGISTER(GPIO_PORTD_PCTL)
+#define GPIO_PORTF_AFSEL_R		HOST_REGISTER(GPIO_PORTF_AFSEL)
+#define GPIO_PORTF_AMSEL_R		HOST_REGISTER(GPIO_PORTF_AMSEL)
+#define GPIO_PORTF_CR_R				HOST_REGISTER(GPIO_PORTF_CR)
+#define GPIO_PORTF_DATA_R			HOST_REGISTER(GPIO_PORTF_DATA)
+#define GPIO_PORTF_DEN_R			HOST_REGISTER(GPIO_PORTF_DEN)
+#define GPIO_PORTF_DIR_R			HOST_REGISTER(GPIO_PORTF_DIR)
+#define GPIO_PORTF_IBE_R			HOST_REGISTER(GPIO_PORTF_IBE)
+#define GPIO_PORTF_ICR_R			HOST_REGISTER(GPIO_PORTF_ICR)
+#define GPIO_PORTF_IEV_R			HOST_REGISTER(GPIO_PORTF_IEV)
+#define GPIO_PORTF_IM_R				HOST_REGISTER(GPIO_PORTF_IM)
+#define GPIO_PORTF_IS_R				HOST_REGISTER(GPIO_PORTF_IS)
+#define GPIO_PORTF_LOCK_R			HOST_REGISTER(GPIO_PORTF_LOCK)
+#define GPIO_PORTF_PCTL_R			HOST_REGISTER(GPIO_PORTF_PCTL)
+#define GPIO_PORTF_PUR_R			HOST_REGISTER(GPIO_PORTF_PUR)
+#define GPIO_PORTF_RIS_R			HOST_REGISTER(GPIO_PORTF_RIS)
+#define INTCTRL								HOST_REGISTER(NVIC_INT_CTRL)
+#define NVIC_DIS2_R						HOST_REGISTER(NVIC_DIS2)
+#define NVIC_EN0_R						HOST_REGISTER(NVIC_EN0)
+#define NVIC_EN2_R						HOST_REGISTER(NVIC_EN2)
+#define NVIC_FAULT_STAT_R			HOST_REGISTER(NVIC_FAULT_STAT)
+#define NVIC_FPCC_R					HOST_REGISTER(NVIC_FPCC)
+#define NVIC_FAULT_ADDR_R			HOST_REGISTER(NVIC_FAULT_ADDR)
+#define NVIC_HFAULT_STAT_R		HOST_REGISTER(NVIC_HFAULT_STAT)
+#define NVIC_MM_ADDR_R				HOST_REGISTER(NVIC_MM_ADDR)
+#define NVIC_MPU_ATTR_R				HOST_REGISTER(NVIC_MPU_ATTR)
+#define NVIC_MPU_BASE_R				HOST_REGISTER(NVIC_MPU_BASE)
+#define NVIC_MPU_CTRL_R				HOST_REGISTER(NVIC_MPU_CTRL)
+#define NVIC_MPU_NUMBER_R			HOST_REGISTER(NVIC_MPU_NUMBER)
+#define NVIC_PRI7_R						HOST_REGISTER(NVIC_PRI7)
+#define NVIC_PRI23_R					HOST_REGISTER(NVIC_PRI23)
+#define NVIC_SYS_HND_CTRL_R		HOST_REGISTER(NVIC_SYS_HND_CTRL)
+#define NVIC_SYS_PRI3_R				HOST_REGISTER(NVIC_SYS_PRI3)
+#define NVIC_UNPEND2_R				HOST_REGISTER(NVIC_UNPEND2)
+#define NVIC_ST_CTRL_R				HOST_REGISTER(NVIC_ST_CTRL)
+#define NVIC_ST_CURRENT_R			HOST_REGISTER(NVIC_ST_CURRENT)
+#define NVIC_ST_RELOAD_R			HOST_REGISTER(NVIC_ST_RELOAD)
+#define SYSCTL_PRGPIO_R				HOST_REGISTER(SYSCTL_PRGPIO)
+#define SYSCTL_PRWTIMER_R			HOST_REGISTER(SYSCTL_PRWTIMER)
+#define SYSCTL_RCGCGPIO_R			HOST_REGISTER(SYSCTL_RCGCGPIO)
+#define SYSCTL_RCGCTIMER_R		HOST_REGISTER(SYSCTL_RCGCTIMER)
+#define SYSCTL_RCGCWTIMER_R		HOST_REGISTER(SYSCTL_RCGCWTIMER)
+#define TIMER5_CFG_R					HOST_REGISTER(TIMER5_CFG)
+#define TIMER5_CTL_R					HOST_REGISTER(TIMER5_CTL)
+#define TIMER5_ICR_R					HOST_REGISTER(TIMER5_ICR)
+#define TIMER5_IMR_R					HOST_REGISTER(TIMER5_IMR)
+#define TIMER5_RIS_R					HOST_REGISTER(TIMER5_RIS)
+#define TIMER5_TAILR_R				HOST_REGISTER(TIMER5_TAILR)
+#define TIMER5_TAMR_R					HOST_REGISTER(TIMER5_TAMR)
+#define TIMER5_TAPR_R					HOST_REGISTER(TIMER5_TAPR)
+#define TIMER5_TAV_R					HOST_REGISTER(TIMER5_TAV)
+#define WTIMER0_CFG_R					HOST_REGISTER(WTIMER0_CFG)
+#define WTIMER0_CTL_R					HOST_REGISTER(WTIMER0_CTL)
+#define WTIMER0_ICR_R					HOST_REGISTER(WTIMER0_ICR)
+#define WTIMER0_IMR_R					HOST_REGISTER(WTIMER0_IMR)
+#define WTIMER0_RIS_R					HOST_REGISTER(WTIMER0_RIS)
+#define WTIMER0_TAILR_R				HOST_REGISTER(WTIMER0_TAILR)
+#define WTIMER0_TAMR_R				HOST_REGISTER(WTIMER0_TAMR)
+#define WTIMER0_TAPR_R				HOST_REGISTER(WTIMER0_TAPR)
+#define WTIMER0_TAV_R					HOST_REGISTER(WTIMER0_TAV)
+#define WTIMER5_CFG_R					HOST_REGISTER(WTIMER5_CFG)
+#define WTIMER5_CTL_R					HOST_REGISTER(WTIMER5_CTL)
+#define WTIMER5_TAILR_R				HOST_REGISTER(WTIMER5_TAILR)
+#define WTIMER5_TAMR_R				HOST_REGISTER(WTIMER5_TAMR)
+#define WTIMER5_TAV_R					HOST_REGISTER(WTIMER5_TAV)
+#define WTIMER5_TBILR_R				HOST_REGISTER(WTIMER5_TBILR)
+#define WTIMER5_TBV_R					HOST_REGISTER(WTIMER5_TBV)
+
+#define TIMER_ICR_TATOCINT		0x00000001	// GPTM Timer A Time-Out Raw Interrupt
+#define TIMER_RIS_TATORIS			0x00000001	// GPTM Timer A Time-Out Raw Interrupt
+#define NVIC_ST_CTRL_CLK_SRC	0x00000004	// Clock Source
+#define NVIC_ST_CTRL_INTEN		0x00000002	// Interrupt Enable
+#define NVIC_ST_CTRL_ENABLE		0x00000001	// Enable
+#define NVIC_FPCC_ASPEN				0x80000000	// Automatic State Preservation
+#define NVIC_FPCC_LSPEN				0x40000000	// Lazy State Preservation Enable
+#define NVIC_FAULT_STAT_BFARV	0x00008000	// Bus Fault Address Register Valid
+#define NVIC_FAULT_STAT_MMARV	0x00000080	// Memory Management Fault Address Register Valid
+#define NVIC_SYS_HND_CTRL_USAGE	0x00040000	// Usage Fault Enable
+#define NVIC_SYS_HND_CTRL_BUS	0x00020000	// Bus Fault Enable
+#define NVIC_SYS_HND_CTRL_MEM	0x00010000	// Memory Management Fault Enable
+#define NVIC_MPU_CTRL_PRIVDEFEN	0x00000004	// MPU Default Region
+#define NVIC_MPU_CTRL_ENABLE	0x00000001	// MPU Enable
+#define NVIC_MPU_BASE_VALID		0x00000010	// Region Number Valid
+#define NVIC_MPU_ATTR_SHAREABLE	0x00040000	// Shareable
+#define NVIC_MPU_ATTR_CACHEABLE	0x00020000	// Cacheable
+#define NVIC_MPU_ATTR_ENABLE	0x00000001	// Region Enable
+
+// CortexM.h
+void DisableInterrupts(void);
+void EnableInterrupts(void);
+long StartCritical(void);
+void EndCritical(long sr);
+void WaitForInterrupt(void);
+
+// osasm.s
+void StartOS(void);
+
+// virtual bus cycles since reset
+extern uint64_t HostCycles;
+
+// ******** HostConsume ************
+// spend cycles of CPU time in the running thread, like a polling driver would
+// interrupts that come due in the meantime are taken unless they are disabled
+// input:  number of 12.5ns bus cycles
+// output: none
+void HostConsume(uint32_t cycles);
+
+// ******** HostThreadInit ************
+// give a new thread a host context that starts running task
+// called by OS_AddThread once the TCB is filled in
+// input:  TCB of the new thread, its task
+// output: none
+struct TCB;
+void HostThreadInit(struct TCB* tcb, void(*task)(void));
+
+// ******** HostDevicesReport ************
+// print what the simulated devices saw, called at the end of a run
+// input:  none
+// output: none
+void HostDevicesReport(void);
+
+// ******** HostTestBegin ************
+// make this run a test, it fails unless HostTestEnd is reached before the run ends
+// input:  name printed with the result
+// output: none
+void HostTestBegin(const char* name);
+
+// ******** HostCheck ************
+// count a test condition, print it with where it was checked if it doesn't hold
+// use HOST_CHECK, which fills in the text and the place
+// input:  whether the condition holds, its text, file and line
+// output: none
+void HostCheck(bool passed, const char* condition, const char* file, int line);
+#define HOST_CHECK(condition)	HostCheck((condition), #condition, __FILE__, __LINE__)
+
+// ******** HostTestEnd ************
+// print the result of the test and end the run, exit status 0 if every check passed
+// input:  none
+// output: none (does not return)
+void HostTestEnd(void);
+
+#endif
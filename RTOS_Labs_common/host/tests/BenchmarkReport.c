@@ -0,0 +1,90 @@
+// *************BenchmarkReport.c**************
+// Runs the interpreter's measurement commands on the host port
+// fif_bch, flt_bch, per_jit, cpu_top, stk_use, slp_isr and fau_log print from Benchmark.c,
+// here after a light load of sleeping threads and periodic tasks has run for REPORTMS
+// Virtual time only moves at kernel entries, so the costs are in the kernel's bus cycles,
+// code that never enters the kernel (the filter arithmetic) costs nothing here
+//
+// build and run from the top of the repository:
+//   gcc -std=gnu99 -DHOST_SIM -O1 -Wno-pointer-to-int-cast -o benchmark_report
+//       RTOS_Labs_common/host/tests/BenchmarkReport.c RTOS_Labs_common/Benchmark.c RTOS_Labs_common/eFile.c
+//       inc/LPF.c RTOS_Labs_common/OS.c RTOS_Labs_common/Trace.c RTOS_Labs_common/heap.c
+//       RTOS_Labs_common/host/HostPort.c RTOS_Labs_common/host/HostDevices.c
+//   ./benchmark_report
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "../../../RTOS_Labs_common/host/HostPort.h"
+#include "../../../RTOS_Labs_common/OS.h"
+#include "../../../RTOS_Labs_common/Benchmark.h"
+
+#define SLEEPERS	4
+#define REPORTMS	200
+
+extern uint32_t const SleeperSize;
+extern uint32_t SleepISRMaxTime[];
+
+uint32_t SleeperLoops[SLEEPERS];
+uint32_t FastReleases;
+uint32_t SlowReleases;
+
+// sleeps i+1 ms at a time, where i is the order it started in
+static void sleeperThread(void){
+	static int32_t started = 0;
+	int32_t index = started++;
+	while(1){
+		OS_Sleep(index + 1);
+		SleeperLoops[index]++;
+	}
+}
+
+static void fastTask(void){
+	FastReleases++;
+}
+
+static void slowTask(void){
+	SlowReleases++;
+}
+
+static void reportThread(void){
+	OS_Sleep(REPORTMS);
+	FifoBenchmark();
+	FilterBenchmark();
+	PeriodicTimes();
+	ThreadTop();
+	StackUsage();
+	SleepISRTime(SleeperSize, SleepISRMaxTime);
+	FaultLog();
+
+	PeriodicStatsType periodicStats;
+	HOST_CHECK(OS_PeriodicStats(0, &periodicStats));
+	HOST_CHECK(periodicStats.releases == FastReleases);
+	HOST_CHECK(FastReleases >= REPORTMS - 1);
+	HOST_CHECK(SlowReleases >= REPORTMS/5 - 1);
+	// a woken sleeper waits up to a time slice to run, 2 ms
+	for(int i = 0; i < SLEEPERS; i++){
+		HOST_CHECK(SleeperLoops[i] >= REPORTMS/(i + 1 + 2) - 1);
+	}
+	HostTestEnd();
+}
+
+static void idleThread(void){
+	while(1){
+		OS_Idle();
+	}
+}
+
+int main(void){
+	OS_Init();
+	OS_ClearMsTime();
+	HostTestBegin("benchmark report");
+	OS_AddThread(&reportThread, 256, 1);
+	for(int i = 0; i < SLEEPERS; i++){
+		OS_AddThread(&sleeperThread, 128, 2);
+	}
+	OS_AddThread(&idleThread, 128, PRIORITY_NUM-1);
+	OS_AddPeriodicThread(&fastTask, TIME_1MS, 2);
+	OS_AddPeriodicThread(&slowTask, 5*TIME_1MS, 3);
+	OS_Launch(TIME_2MS);
+	return 0;
+}
@@ -0,0 +1,113 @@
+// *************DiskTest.c**************
+// Host test of eFile on the eDisk model of HostDevices.c
+// A real-time thread runs a short job every RTPERIODMS under EDF while a low priority thread
+// formats the disk, prints the dsk_bch throughput table and writes a file with
+// eFile_WriteBuffer. eFile only holds the SSI for one transfer at a time, so no job may
+// miss its deadline. The file goes out in pieces that end right on a sector boundary,
+// every sector of it has to be written once, and eFile_ReadBuffer has to give the data back
+//
+// build and run from the top of the repository:
+//   gcc -std=gnu99 -DHOST_SIM -O1 -Wno-pointer-to-int-cast -o disk_test
+//       RTOS_Labs_common/host/tests/DiskTest.c RTOS_Labs_common/eFile.c RTOS_Labs_common/Benchmark.c
+//       inc/LPF.c RTOS_Labs_common/OS.c RTOS_Labs_common/Trace.c RTOS_Labs_common/heap.c
+//       RTOS_Labs_common/host/HostPort.c RTOS_Labs_common/host/HostDevices.c
+//   ./disk_test
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "../../../RTOS_Labs_common/host/HostPort.h"
+#include "../../../RTOS_Labs_common/OS.h"
+#include "../../../RTOS_Labs_common/eFile.h"
+#include "../../../RTOS_Labs_common/Benchmark.h"
+
+#define RTPERIODMS		2
+#define RTWCET				(TIME_1MS/10)
+#define SECTORDATA		510											// file bytes in a sector
+#define DISK_SECTORS	1024										// as in HostDevices.c
+
+extern uint32_t HostDiskWrites[DISK_SECTORS];
+
+// three sectors, two sectors, then a partial one
+const unsigned long Pieces[] = {3*SECTORDATA, 2*SECTORDATA, 100};
+#define FILEBYTES			(5*SECTORDATA + 100)
+#define FILESECTORS		6
+
+char FileData[FILEBYTES];
+char ReadBack[FILEBYTES + SECTORDATA];
+uint32_t WritesBefore[DISK_SECTORS];
+int32_t RealTimeId;
+
+static void realTimeThread(void){
+	RealTimeId = OS_Id();
+	while(1){
+		HostConsume(RTWCET);
+		OS_NextPeriod();
+	}
+}
+
+static void diskThread(void){
+	HOST_CHECK(eFile_Init() == 0);
+	HOST_CHECK(eFile_Format() == 0);
+	DiskBenchmark();
+	// a run longer than the eFile buffers is read in pieces, and still timed
+	unsigned long writeKBps, readKBps;
+	HOST_CHECK(eFile_Throughput(32, &writeKBps, &readKBps) == 0 && readKBps > 0);
+
+	for(int i = 0; i < FILEBYTES; i++){
+		FileData[i] = (char)(i*7 + (i >> 8));
+	}
+	HOST_CHECK(eFile_Create("log") == 0);
+	HOST_CHECK(eFile_WOpen("log") == 0);
+	memcpy(WritesBefore, HostDiskWrites, sizeof(WritesBefore));
+	const char* data = FileData;
+	for(int i = 0; i < sizeof(Pieces)/sizeof(Pieces[0]); i++){
+		HOST_CHECK(eFile_WriteBuffer(data, Pieces[i]) == 0);
+		data += Pieces[i];
+	}
+	HOST_CHECK(eFile_WClose() == 0);
+
+	uint32_t written = 0;
+	bool once = true;
+	for(int i = 0; i < DISK_SECTORS; i++){
+		uint32_t writes = HostDiskWrites[i] - WritesBefore[i];
+		written += writes;
+		once = once && writes <= 1;
+	}
+	printf("file of %d sectors, %u sector writes\n", FILESECTORS, written);
+	HOST_CHECK(once);
+	HOST_CHECK(written == FILESECTORS);
+
+	unsigned long count = 0;
+	HOST_CHECK(eFile_ROpen("log") == 0);
+	HOST_CHECK(eFile_ReadBuffer(ReadBack, sizeof(ReadBack), &count) == 0);
+	HOST_CHECK(eFile_RClose() == 0);
+	HOST_CHECK(count == FILEBYTES);
+	HOST_CHECK(memcmp(ReadBack, FileData, FILEBYTES) == 0);
+
+	ThreadStatsType stats;
+	HOST_CHECK(OS_ThreadStats(RealTimeId, &stats));
+	printf("real-time thread: %u jobs, %u deadline misses\n", stats.jobs, stats.deadlineMisses);
+	HOST_CHECK(stats.jobs >= OS_MsTime()/RTPERIODMS - 1);
+	HOST_CHECK(stats.deadlineMisses == 0);
+	HostTestEnd();
+}
+
+static void idleThread(void){
+	while(1){
+		OS_Idle();
+	}
+}
+
+int main(void){
+	OS_Init();
+	OS_ClearMsTime();
+	HostTestBegin("eFile on the disk model");
+	OS_SchedulingMode(SCHED_EDF);
+	OS_AddRealTimeThread(&realTimeThread, 128, RTPERIODMS, RTWCET, RTPERIODMS);
+	OS_AddThread(&diskThread, 512, 1);
+	OS_AddThread(&idleThread, 128, PRIORITY_NUM-1);
+	OS_Launch(TIME_2MS);
+	return 0;
+}
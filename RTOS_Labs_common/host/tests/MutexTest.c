@@ -0,0 +1,144 @@
+// *************MutexTest.c**************
+// Host test of priority inheritance in OS_MutexLock
+// A low priority LCD writer holds the LCD mutex for WRITECYCLES when a high priority
+// thread wants it and a medium priority thread starts hogging the CPU for HOGCYCLES.
+// The writer has to inherit the high priority, so the high priority thread waits at most
+// for the rest of the write, never for the hog. A second round adds a thread in the middle
+// that holds the mutex the high priority thread wants while it waits for the LCD mutex,
+// so the inheritance has to pass down the chain to the writer.
+//
+// build and run from the top of the repository:
+//   gcc -std=gnu99 -DHOST_SIM -O1 -Wno-pointer-to-int-cast -o mutex_test
+//       RTOS_Labs_common/host/tests/MutexTest.c RTOS_Labs_common/OS.c RTOS_Labs_common/Trace.c
+//       RTOS_Labs_common/heap.c RTOS_Labs_common/host/HostPort.c RTOS_Labs_common/host/HostDevices.c
+//   ./mutex_test
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include "../../../RTOS_Labs_common/host/HostPort.h"
+#include "../../../RTOS_Labs_common/OS.h"
+
+#define HIGH_PRIORITY		1
+#define HOG_PRIORITY		3
+#define MIDDLE_PRIORITY	4
+#define WRITER_PRIORITY	5
+#define WRITECYCLES			(8*TIME_1MS)		// the LCD write done while holding the mutex, a few time slices
+#define HOGCYCLES				(20*TIME_1MS)
+#define ROUNDMS					50						// long enough for every thread of a round to finish
+
+MutexType LCDMutex;
+MutexType LogMutex;									// held by the middle thread in the chained round
+bool Chained;
+
+uint32_t HighBlocked;								// cycles the high priority thread waited for its mutex
+int32_t WriterInherited;						// priority of the writer at the end of its write
+int32_t MiddleInherited;						// priority of the middle thread once it got the LCD mutex
+int32_t WriterAfter;								// priority of the writer once it let go
+bool HighDone;
+bool HogDone;
+bool HogBeforeHigh;									// the hog finished before the high priority thread got its mutex
+
+static int32_t runningPriority(void){
+	ThreadStatsType stats;
+	OS_ThreadStats(OS_Id(), &stats);
+	return stats.priority;
+}
+
+// takes the LCD mutex first, the others wake a few ticks later while it still holds it
+static void writerThread(void){
+	OS_MutexLock(&LCDMutex);
+	HostConsume(WRITECYCLES);
+	WriterInherited = runningPriority();
+	OS_MutexUnlock(&LCDMutex);
+	WriterAfter = runningPriority();
+	OS_Kill();
+}
+
+// chained round only, holds LogMutex while it waits for the writer
+static void middleThread(void){
+	OS_Sleep(1);
+	OS_MutexLock(&LogMutex);
+	OS_MutexLock(&LCDMutex);
+	MiddleInherited = runningPriority();
+	OS_MutexUnlock(&LCDMutex);
+	OS_MutexUnlock(&LogMutex);
+	OS_Kill();
+}
+
+static void highThread(void){
+	OS_Sleep(3);
+	uint32_t start = OS_Time();
+	OS_MutexLock(Chained ? &LogMutex : &LCDMutex);
+	HighBlocked = OS_TimeDifference(start, OS_Time());
+	HogBeforeHigh = HogDone;
+	OS_MutexUnlock(Chained ? &LogMutex : &LCDMutex);
+	HighDone = true;
+	OS_Kill();
+}
+
+// becomes ready with the high priority thread, then runs without blocking
+static void hogThread(void){
+	OS_Sleep(3);
+	HostConsume(HOGCYCLES);
+	HogDone = true;
+	OS_Kill();
+}
+
+static void inheritanceRound(bool chained){
+	Chained = chained;
+	HighDone = false;
+	HogDone = false;
+	HogBeforeHigh = false;
+	WriterInherited = -1;
+	MiddleInherited = -1;
+	OS_InitMutex(&LCDMutex);
+	OS_InitMutex(&LogMutex);
+
+	HOST_CHECK(OS_AddThread(&writerThread, 128, WRITER_PRIORITY));
+	if(chained){
+		HOST_CHECK(OS_AddThread(&middleThread, 128, MIDDLE_PRIORITY));
+	}
+	HOST_CHECK(OS_AddThread(&highThread, 128, HIGH_PRIORITY));
+	HOST_CHECK(OS_AddThread(&hogThread, 128, HOG_PRIORITY));
+	OS_Sleep(ROUNDMS);
+
+	printf("%s: high priority thread blocked %u cycles, write %u, hog %u\n",
+		chained ? "chained" : "direct", HighBlocked, WRITECYCLES, HOGCYCLES);
+	HOST_CHECK(HighDone);
+	HOST_CHECK(HogDone);
+	// bounded by the writer's critical section, not by the hog
+	HOST_CHECK(HighBlocked < WRITECYCLES);
+	HOST_CHECK(!HogBeforeHigh);
+	HOST_CHECK(WriterInherited == HIGH_PRIORITY);
+	HOST_CHECK(WriterAfter == WRITER_PRIORITY);
+	if(chained){
+		HOST_CHECK(MiddleInherited == HIGH_PRIORITY);
+	}
+	HOST_CHECK(LCDMutex.owner == NULL);
+	HOST_CHECK(LogMutex.owner == NULL);
+}
+
+// above every thread of a round, it only wakes to start and check them
+static void controllerThread(void){
+	inheritanceRound(false);
+	inheritanceRound(true);
+	HostTestEnd();
+}
+
+// frees the stacks of the threads that are done
+static void idleThread(void){
+	while(1){
+		OS_Idle();
+	}
+}
+
+int main(void){
+	OS_Init();
+	OS_ClearMsTime();
+	HostTestBegin("mutex priority inheritance");
+	OS_AddThread(&controllerThread, 256, 0);
+	OS_AddThread(&idleThread, 128, PRIORITY_NUM-1);
+	OS_Launch(TIME_2MS);
+	return 0;
+}
@@ -0,0 +1,164 @@
+// *************RestartTest.c**************
+// Host test of restarting a thread that ended on a fault
+// A thread with a restart policy faults while the stack arena is full, so OS_AddThread could
+// not give it a new stack: it has to start over on its own stack with its ID, and OS_Join
+// has to keep waiting until the policy runs out. Then a real-time thread faults and, before
+// the timer daemon gets to restart it, another thread takes the utilization it gave back:
+// the restart is refused, OS_Join returns FAULT_EXITCODE and the fault log records it
+// The threads call OS_Exit(FAULT_EXITCODE) the way the fault handlers do
+//
+// build and run from the top of the repository:
+//   gcc -std=gnu99 -DHOST_SIM -O1 -Wno-pointer-to-int-cast -o restart_test
+//       RTOS_Labs_common/host/tests/RestartTest.c RTOS_Labs_common/OS.c RTOS_Labs_common/Trace.c
+//       RTOS_Labs_common/heap.c RTOS_Labs_common/host/HostPort.c RTOS_Labs_common/host/HostDevices.c
+//   ./restart_test
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "../../../RTOS_Labs_common/host/HostPort.h"
+#include "../../../RTOS_Labs_common/OS.h"
+#include "../../../RTOS_Labs_common/TCB.h"
+
+#define RESTARTS		2				// restart policy of the faulting threads
+#define WINDOWMS		1000
+#define RTPERIODMS	10
+
+extern struct TCB* RunPt;
+
+Sema4Type Go;								// lets the faulting thread fault once the controller waits for it
+Sema4Type Release;					// ends the threads that fill the stack arena
+Sema4Type Thief;						// wakes the thread that takes the real-time utilization
+
+int32_t Starts;
+int32_t FirstId;
+bool SameThread;						// every start had the ID and stack of the first
+int32_t* FirstStack;
+int32_t RealTimeStarts;
+int32_t RealTimeId;
+bool Stolen;
+uint32_t HogJobs;
+
+// holds a piece of the stack arena until Release
+static void parkedThread(void){
+	OS_Wait(&Release);
+	OS_Kill();
+}
+
+static void faultyThread(void){
+	Starts++;
+	if(Starts == 1){
+		FirstId = OS_Id();
+		FirstStack = RunPt->stackBase;
+	}else if(OS_Id() != FirstId || RunPt->stackBase != FirstStack){
+		SameThread = false;
+	}
+	OS_SetRestartPolicy(OS_Id(), RESTARTS, WINDOWMS);
+	if(Starts == 1){
+		OS_Wait(&Go);
+	}
+	OS_Exit(FAULT_EXITCODE);
+}
+
+// real-time, admitted for the whole utilization once the faulted thread gave its share back
+static void hogThread(void){
+	while(1){
+		HogJobs++;
+		OS_NextPeriod();
+	}
+}
+
+// an ordinary thread at REALTIME_PRIORITY, ready ahead of the timer daemon
+static void thiefThread(void){
+	OS_Wait(&Thief);
+	Stolen = OS_AddRealTimeThread(&hogThread, 128, RTPERIODMS, RTPERIODMS*TIME_1MS, RTPERIODMS);
+	OS_Kill();
+}
+
+static void realTimeThread(void){
+	RealTimeStarts++;
+	RealTimeId = OS_Id();
+	OS_SetRestartPolicy(OS_Id(), RESTARTS, WINDOWMS);
+	OS_Wait(&Go);
+	OS_Signal(&Thief);
+	OS_Exit(FAULT_EXITCODE);
+}
+
+// a full stack arena does not keep a thread from restarting
+static void restartInPlace(void){
+	Starts = 0;
+	SameThread = true;
+	HOST_CHECK(OS_AddThread(&faultyThread, 256, 2));
+	OS_Sleep(1);
+	HOST_CHECK(Starts == 1);
+
+	int32_t parked = 0;
+	for(uint32_t size = 512; size >= 128; size /= 2){
+		while(OS_AddThread(&parkedThread, size, 3)){
+			parked++;
+		}
+	}
+	HOST_CHECK(!OS_AddThread(&parkedThread, 128, 3));
+
+	int32_t exitCode = 0;
+	OS_Signal(&Go);
+	HOST_CHECK(OS_Join(FirstId, &exitCode));
+	HOST_CHECK(exitCode == FAULT_EXITCODE);
+	HOST_CHECK(Starts == 1 + RESTARTS);
+	HOST_CHECK(SameThread);
+	// ending on the policy running out is no fault of the restart
+	FaultRecordType record;
+	HOST_CHECK(!OS_FaultRecord(0, &record));
+
+	for(int32_t i = 0; i < parked; i++){
+		OS_Signal(&Release);
+	}
+	OS_Sleep(1);
+}
+
+// a real-time thread whose utilization was taken in the meantime is not restarted
+static void restartRefused(void){
+	HOST_CHECK(OS_SchedulingMode(SCHED_EDF));
+	HOST_CHECK(OS_AddThread(&thiefThread, 128, REALTIME_PRIORITY));
+	HOST_CHECK(OS_AddRealTimeThread(&realTimeThread, 256, 100, TIME_1MS, 100));
+	OS_Sleep(1);
+	HOST_CHECK(RealTimeStarts == 1);
+
+	int32_t exitCode = 0;
+	OS_Signal(&Go);
+	HOST_CHECK(OS_Join(RealTimeId, &exitCode));
+	HOST_CHECK(exitCode == FAULT_EXITCODE);
+	HOST_CHECK(Stolen);
+	HOST_CHECK(RealTimeStarts == 1);
+	FaultRecordType record;
+	HOST_CHECK(OS_FaultRecord(0, &record));
+	HOST_CHECK(record.exception == FAULT_RESTARTFAILED);
+	HOST_CHECK(record.id == RealTimeId);
+	OS_Sleep(2*RTPERIODMS);
+	HOST_CHECK(HogJobs >= 2);
+}
+
+static void controllerThread(void){
+	restartInPlace();
+	restartRefused();
+	HostTestEnd();
+}
+
+// frees the stacks of the threads that are done
+static void idleThread(void){
+	while(1){
+		OS_Idle();
+	}
+}
+
+int main(void){
+	OS_Init();
+	OS_ClearMsTime();
+	HostTestBegin("restart after a fault");
+	OS_InitSemaphore(&Go, 0);
+	OS_InitSemaphore(&Release, 0);
+	OS_InitSemaphore(&Thief, 0);
+	OS_AddThread(&controllerThread, 256, 1);
+	OS_AddThread(&idleThread, 128, PRIORITY_NUM-1);
+	OS_Launch(TIME_2MS);
+	return 0;
+}
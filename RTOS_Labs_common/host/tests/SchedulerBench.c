@@ -0,0 +1,99 @@
+// *************SchedulerBench.c**************
+// Host benchmark of a thread switch through the kernel's own scheduler
+// Two threads at one priority level hand the CPU back and forth with OS_Suspend, every
+// switch goes through scheduler() and PendSV as on the target. The pair runs just below
+// the timer daemon, in the middle and just above the bench thread, every level above it empty
+// Reports the virtual bus cycles HostCycles counts per switch, which the port charges for
+// the critical section, PendSV and any interrupt that comes due, and the host time of the
+// same switches, which is where the C code of scheduler() shows up. Neither may grow with
+// the level, with 8 levels or with 32
+//
+// build and run with 8 and with 32 priority levels, from the top of the repository:
+//   gcc -std=gnu99 -DHOST_SIM -O1 -Wno-pointer-to-int-cast -o scheduler_bench
+//       RTOS_Labs_common/host/tests/SchedulerBench.c RTOS_Labs_common/OS.c RTOS_Labs_common/Trace.c
+//       RTOS_Labs_common/heap.c RTOS_Labs_common/host/HostPort.c RTOS_Labs_common/host/HostDevices.c
+//   ./scheduler_bench
+//   the same with -DPRIORITY_NUM=32 added
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <time.h>
+#include "../../../RTOS_Labs_common/host/HostPort.h"
+#include "../../../RTOS_Labs_common/OS.h"
+
+#define SWITCHES	100000		// switches timed per level
+#define LEVELS		3
+
+uint64_t SwitchStart;				// HostCycles when the last thread gave up the CPU
+uint32_t Switches;
+uint64_t MinCycles;
+uint64_t TotalCycles;
+int32_t PairDone;
+
+static uint64_t hostNs(void){
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec*1000000000 + now.tv_nsec;
+}
+
+// one of the pair, each switch is timed by the thread it switches to
+static void switchThread(void){
+	while(Switches < SWITCHES){
+		SwitchStart = HostCycles;
+		OS_Suspend();
+		uint64_t cycles = HostCycles - SwitchStart;
+		TotalCycles += cycles;
+		if(cycles < MinCycles){
+			MinCycles = cycles;
+		}
+		Switches++;
+	}
+	PairDone++;
+	OS_Kill();
+}
+
+// runs below every level measured, so it only gets back once both of the pair are gone
+static void benchThread(void){
+	const uint32_t levels[LEVELS] = {1, PRIORITY_NUM/2, PRIORITY_NUM-2};
+	uint32_t minCycles[LEVELS];
+	printf("thread switch, PRIORITY_NUM %d, %d switches per level\n", PRIORITY_NUM, SWITCHES);
+	printf("level  min(cycles)  mean(cycles)  host(ns)\n");
+	for(int i = 0; i < LEVELS; i++){
+		Switches = 0;
+		MinCycles = UINT64_MAX;
+		TotalCycles = 0;
+		PairDone = 0;
+		uint64_t start = hostNs();
+		HOST_CHECK(OS_AddThread(&switchThread, 128, levels[i]));
+		HOST_CHECK(OS_AddThread(&switchThread, 128, levels[i]));
+		// both have run to the end once this thread gets to run again
+		OS_Suspend();
+		uint64_t elapsed = hostNs() - start;
+		HOST_CHECK(PairDone == 2);
+		minCycles[i] = MinCycles;
+		printf("%5u  %11u  %12u  %8u\n", levels[i], (uint32_t)MinCycles,
+			(uint32_t)(TotalCycles/Switches), (uint32_t)(elapsed/Switches));
+		OS_Sleep(1);
+	}
+	// the ready bitmap finds the level in the same time wherever it is
+	HOST_CHECK(minCycles[0] == minCycles[1] && minCycles[1] == minCycles[2]);
+	HostTestEnd();
+}
+
+// frees the stacks of the pairs that are done
+static void idleThread(void){
+	while(1){
+		OS_Idle();
+	}
+}
+
+int main(void){
+	OS_Init();
+	OS_ClearMsTime();
+	HostTestBegin("thread switch");
+	OS_AddThread(&benchThread, 256, PRIORITY_NUM-1);
+	OS_AddThread(&idleThread, 128, PRIORITY_NUM-1);
+	OS_Launch(TIME_2MS);
+	return 0;
+}
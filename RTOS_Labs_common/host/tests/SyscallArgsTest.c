@@ -0,0 +1,208 @@
+// *************SyscallArgsTest.c**************
+// Host test of the pointer checks SVC_Handler makes before a process's system call runs
+// A process thread hands SyscallArgsValid the arguments of calls as it would stack them for
+// an SVC: pointers into its data segment and onto its stack, and the semaphores, mutexes,
+// event groups, rings and queues the kernel keeps for it, have to pass. Pointers into the kernel,
+// such objects in its own memory or kept for someone else, objects and strings that run even
+// a byte past the end of the segment or stack, and sizes that wrap around have to fail.
+// Its objects go back to the kernel with the process.
+// The segments come from Heap_MallocAligned and process stacks are aligned the same way, so
+// the regions end exactly where the memory of the process does. A thread the process adds has to
+// start in its text segment. A kernel thread passes anything, but no call takes a priority past the last
+//
+// build and run from the top of the repository:
+//   gcc -std=gnu99 -DHOST_SIM -O1 -Wno-pointer-to-int-cast -o syscall_args_test
+//       RTOS_Labs_common/host/tests/SyscallArgsTest.c RTOS_Labs_common/Syscall.c
+//       RTOS_Labs_common/OS.c RTOS_Labs_common/Trace.c RTOS_Labs_common/heap.c
+//       RTOS_Labs_common/host/HostPort.c RTOS_Labs_common/host/HostDevices.c
+//   ./syscall_args_test
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "../../../RTOS_Labs_common/host/HostPort.h"
+#include "../../../RTOS_Labs_common/OS.h"
+#include "../../../RTOS_Labs_common/heap.h"
+#include "../../../RTOS_Labs_common/Syscall.h"
+#include "../../../RTOS_Labs_common/TCB.h"
+
+#define TEXTSIZE	256
+#define DATASIZE	1024
+
+bool SyscallArgsValid(uint32_t id, const uintptr_t args[4]);
+int OS_AddProcess(void(*entry)(void), void *text, void *data, unsigned long stackSize, unsigned long priority);
+
+// what the process keeps in its data segment, the objects here are forgeries the kernel must refuse
+struct ProcessData{
+	Sema4Type sema4;
+	MutexType mutex;
+	RingType ring;
+	uint32_t ringBuffer[8];
+	MsgQueueType queue;
+	uint8_t queueBuffer[4*8];
+	uint32_t fifoBuffer[8];
+	char name[8];
+};
+
+uint8_t* Text;
+uint8_t* Data;
+int32_t ProcessDone;
+Sema4Type* ProcessSema4;
+
+extern struct TCB* RunPt;
+
+// kernel memory a process must not reach
+Sema4Type KernelSema4;
+uint32_t KernelWord;
+Sema4Type* KernelPoolSema4;		// kept by the kernel, but for a kernel thread
+
+static void kernelThread(void);
+
+static bool call(uint32_t id, uintptr_t r0, uintptr_t r1, uintptr_t r2, uintptr_t r3){
+	const uintptr_t args[4] = {r0, r1, r2, r3};
+	return SyscallArgsValid(id, args);
+}
+
+static void processThread(void){
+	struct ProcessData* data = (struct ProcessData*)Data;
+	// a host thread runs on a stack of the host, words of its own stack in the arena stand in for locals
+	uint32_t* stack = (uint32_t*)RunPt->stackBase;
+	uint32_t* receivedPt = &stack[16];
+	uint8_t* msg = (uint8_t*)&stack[17];
+
+	// calls without pointers and objects the kernel keeps for it
+	Sema4Type* sema4 = OS_Sema4Create(0);
+	MutexType* mutex = OS_MutexCreate();
+	EventGroupType* group = OS_EventGroupCreate();
+	HOST_CHECK(sema4 != NULL && mutex != NULL && group != NULL);
+	ProcessSema4 = sema4;
+	HOST_CHECK(call(SYS_OS_SLEEP, 1, 0, 0, 0));
+	HOST_CHECK(call(SYS_OS_WAIT, (uintptr_t)sema4, 0, 0, 0));
+	HOST_CHECK(call(SYS_OS_MUTEXLOCK, (uintptr_t)mutex, 0, 0, 0));
+	HOST_CHECK(call(SYS_OS_EVENTGROUPSET, (uintptr_t)group, 1, 0, 0));
+	HOST_CHECK(call(SYS_OS_MAILBOX_RECV_TIMEOUT, (uintptr_t)receivedPt, 10, 0, 0));
+	HOST_CHECK(call(SYS_OS_JOIN, 1, 0, 0, 0));
+
+	// objects in its own memory, where it could forge the wait queue links and the owner
+	HOST_CHECK(!call(SYS_OS_SIGNAL, (uintptr_t)&data->sema4, 0, 0, 0));
+	HOST_CHECK(!call(SYS_OS_INITSEMAPHORE, (uintptr_t)&data->sema4, 0, 0, 0));
+	HOST_CHECK(!call(SYS_OS_INITSEMAPHORE, (uintptr_t)sema4, 0, 0, 0));
+	HOST_CHECK(!call(SYS_OS_MUTEXUNLOCK, (uintptr_t)&data->mutex, 0, 0, 0));
+	HOST_CHECK(!call(SYS_OS_INITMUTEX, (uintptr_t)&data->mutex, 0, 0, 0));
+	HOST_CHECK(!call(SYS_OS_EVENTGROUPINIT, (uintptr_t)group, 0, 0, 0));
+	HOST_CHECK(!call(SYS_OS_WAIT, (uintptr_t)((uint8_t*)sema4 + 4), 0, 0, 0));
+
+	// the kernel's objects, one the kernel keeps for a kernel thread, and NULL
+	HOST_CHECK(!call(SYS_OS_WAIT, (uintptr_t)&KernelSema4, 0, 0, 0));
+	HOST_CHECK(!call(SYS_OS_WAIT, (uintptr_t)KernelPoolSema4, 0, 0, 0));
+	HOST_CHECK(!call(SYS_OS_SIGNAL, 0, 0, 0, 0));
+	HOST_CHECK(!call(SYS_OS_MAILBOX_RECV_TIMEOUT, (uintptr_t)&KernelWord, 10, 0, 0));
+	HOST_CHECK(!call(SYS_OS_JOIN, 1, (uintptr_t)&KernelWord, 0, 0));
+
+	// a ring is the kernel's, its buffer has to be the caller's
+	HOST_CHECK(call(SYS_OS_RINGCREATE, (uintptr_t)data->ringBuffer, 8, 1, 0));
+	HOST_CHECK(!call(SYS_OS_RINGCREATE, (uintptr_t)&KernelWord, 8, 1, 0));
+	HOST_CHECK(!call(SYS_OS_RINGINIT, (uintptr_t)&data->ring, (uintptr_t)data->ringBuffer, 8, 1));
+	RingType* ring = OS_RingCreate(data->ringBuffer, 8, 1);
+	HOST_CHECK(ring != NULL);
+	HOST_CHECK(call(SYS_OS_RINGPUT, (uintptr_t)ring, 5, 0, 0));
+	HOST_CHECK(call(SYS_OS_RINGGETBULK, (uintptr_t)ring, (uintptr_t)receivedPt, 1, 0));
+	HOST_CHECK(!call(SYS_OS_RINGGETBULK, (uintptr_t)ring, (uintptr_t)receivedPt, 0x10000, 0));
+	OS_RingInit(&data->ring, data->ringBuffer, 8, 1);
+	HOST_CHECK(!call(SYS_OS_RINGPUT, (uintptr_t)&data->ring, 5, 0, 0));
+
+	// so is a message queue, and the message has to hold msgSize bytes
+	HOST_CHECK(!call(SYS_OS_MSGQUEUECREATE, (uintptr_t)data->queueBuffer, 0x10000, 0x10000, 0));
+	HOST_CHECK(!call(SYS_OS_MSGQUEUEINIT, (uintptr_t)&data->queue, (uintptr_t)data->queueBuffer, 8, sizeof(uint32_t)));
+	MsgQueueType* queue = OS_MsgQueueCreate(data->queueBuffer, 8, sizeof(uint32_t));
+	HOST_CHECK(queue != NULL);
+	HOST_CHECK(call(SYS_OS_MSGQUEUERECV, (uintptr_t)queue, (uintptr_t)msg, 0, 0));
+	HOST_CHECK(!call(SYS_OS_MSGQUEUERECV, (uintptr_t)queue, (uintptr_t)&KernelWord - 1, 0, 0));
+	OS_MsgQueueInit(&data->queue, data->queueBuffer, 8, sizeof(uint32_t));
+	HOST_CHECK(!call(SYS_OS_MSGQUEUESEND, (uintptr_t)&data->queue, (uintptr_t)msg, 0, 0));
+
+	// a FIFO has to be one the kernel handed out, over a buffer of the caller's
+	FifoType* fifo = OS_FifoCreate(data->fifoBuffer, 8, sizeof(uint32_t));
+	HOST_CHECK(fifo != NULL);
+	HOST_CHECK(call(SYS_OS_FIFOPUT, (uintptr_t)fifo, (uintptr_t)receivedPt, 0, 0));
+	HOST_CHECK(!call(SYS_OS_FIFOPUT, (uintptr_t)&data->ring, (uintptr_t)receivedPt, 0, 0));
+	HOST_CHECK(!call(SYS_OS_FIFOGETBULK, (uintptr_t)fifo, (uintptr_t)receivedPt, 0x40000000, 0));
+	HOST_CHECK(!call(SYS_OS_FIFOCREATE, (uintptr_t)data->fifoBuffer, 0x80000000, 2, 0));
+
+	// strings are read up to their 0
+	strcpy(data->name, "log");
+	HOST_CHECK(call(SYS_EFILE_CREATE, (uintptr_t)data->name, 0, 0, 0));
+	HOST_CHECK(!call(SYS_EFILE_CREATE, (uintptr_t)"kernel", 0, 0, 0));
+	HOST_CHECK(call(SYS_ST7735_MESSAGE, 0, 0, (uintptr_t)data->name, 0));
+	HOST_CHECK(call(SYS_EFILE_READBUFFER, (uintptr_t)data->name, sizeof(data->name), (uintptr_t)receivedPt, 0));
+	HOST_CHECK(!call(SYS_EFILE_READBUFFER, (uintptr_t)data->name, 0xFFFFFFFF, (uintptr_t)receivedPt, 0));
+
+	// right up to the end of the segment and the stack, not a byte past it into the heap or the next stack
+	uint8_t* dataEnd = Data + DATASIZE;
+	HOST_CHECK(call(SYS_OS_MAILBOX_RECV_TIMEOUT, (uintptr_t)(dataEnd - 4), 10, 0, 0));
+	HOST_CHECK(!call(SYS_OS_MAILBOX_RECV_TIMEOUT, (uintptr_t)(dataEnd - 2), 10, 0, 0));
+	HOST_CHECK(!call(SYS_OS_MAILBOX_RECV_TIMEOUT, (uintptr_t)dataEnd, 10, 0, 0));
+	HOST_CHECK(!call(SYS_OS_WAIT, (uintptr_t)(dataEnd - sizeof(Sema4Type)/2), 0, 0, 0));
+	HOST_CHECK(((uintptr_t)stack & (RunPt->stackSize - 1)) == 0);
+	uint8_t* stackEnd = (uint8_t*)stack + RunPt->stackSize;
+	HOST_CHECK(call(SYS_OS_MAILBOX_RECV_TIMEOUT, (uintptr_t)(stackEnd - 4), 10, 0, 0));
+	HOST_CHECK(!call(SYS_OS_MAILBOX_RECV_TIMEOUT, (uintptr_t)(stackEnd - 2), 10, 0, 0));
+	HOST_CHECK(!call(SYS_OS_MAILBOX_RECV_TIMEOUT, (uintptr_t)stack - 4, 10, 0, 0));
+	// a string has to end inside the segment
+	memcpy(dataEnd - 4, "end", 4);
+	HOST_CHECK(call(SYS_EFILE_CREATE, (uintptr_t)(dataEnd - 4), 0, 0, 0));
+	memcpy(dataEnd - 4, "ends", 4);
+	HOST_CHECK(!call(SYS_EFILE_CREATE, (uintptr_t)(dataEnd - 4), 0, 0, 0));
+
+	// a thread it adds has to start in its own text segment
+	HOST_CHECK(call(SYS_OS_ADDTHREAD, (uintptr_t)Text + 1, 128, 3, 0));
+	HOST_CHECK(call(SYS_OS_ADDTHREAD, (uintptr_t)Text + TEXTSIZE - 2 + 1, 128, 3, 0));
+	HOST_CHECK(!call(SYS_OS_ADDTHREAD, (uintptr_t)Text + TEXTSIZE + 1, 128, 3, 0));
+	HOST_CHECK(!call(SYS_OS_ADDTHREAD, (uintptr_t)&kernelThread, 128, 3, 0));
+
+	ProcessDone = 1;
+	OS_Kill();
+}
+
+// not part of a process, so it may pass the kernel's own memory
+static void kernelThread(void){
+	while(!ProcessDone){
+		OS_Sleep(1);
+	}
+	HOST_CHECK(call(SYS_OS_WAIT, (uintptr_t)KernelPoolSema4, 0, 0, 0));
+	HOST_CHECK(call(SYS_EFILE_CREATE, (uintptr_t)"kernel", 0, 0, 0));
+	// the objects of the process went back to the pools with it
+	OS_Sleep(1);
+	HOST_CHECK(!OS_Sema4Valid(ProcessSema4));
+	HOST_CHECK(OS_Sema4Valid(KernelPoolSema4));
+	// and OS_Idle gave HeapMutex back after freeing its memory
+	HOST_CHECK(HeapMutex.owner == NULL);
+	HOST_CHECK(call(SYS_OS_ADDTHREAD, (uintptr_t)&kernelThread, 128, 3, 0));
+	// a level past the last is refused
+	HOST_CHECK(!OS_AddThread(&kernelThread, 128, PRIORITY_NUM));
+	HOST_CHECK(!OS_AddThread(&kernelThread, 128, 200));
+	HostTestEnd();
+}
+
+static void idleThread(void){
+	while(1){
+		OS_Idle();
+	}
+}
+
+int main(void){
+	OS_Init();
+	OS_ClearMsTime();
+	HostTestBegin("syscall arguments");
+	Heap_Init();
+	KernelPoolSema4 = OS_Sema4Create(0);
+	HOST_CHECK(sizeof(struct ProcessData) <= DATASIZE);
+	Text = Heap_MallocAligned(TEXTSIZE);
+	Data = Heap_MallocAligned(DATASIZE);
+	HOST_CHECK(((uintptr_t)Data & (DATASIZE - 1)) == 0 && Heap_Size(Data) == DATASIZE);
+	HOST_CHECK(OS_AddProcess(&processThread, Text, Data, 512, 1));
+	OS_AddThread(&kernelThread, 256, 2);
+	OS_AddThread(&idleThread, 128, PRIORITY_NUM-1);
+	OS_Launch(TIME_2MS);
+	return 0;
+}
@@ -0,0 +1,162 @@
+// *************TimeoutRaceTest.c**************
+// Host test of a wait with a timeout that is signalled right around the moment it times out
+// A waiter blocks with OS_Wait_Timeout or OS_bWait_Timeout for TIMEOUTMS while a higher
+// priority thread signals it at a delay swept across the timeout in STEPCYCLES steps.
+// Whichever of the signal and the timeout comes first has to take the waiter off both the
+// sleeping threads and the wait queue, exactly once, and the other must find it gone:
+// the waiter either takes the signal or times out and leaves the signal in the semaphore,
+// and a thread sleeping behind it in the delta queue still wakes on time
+//
+// build and run from the top of the repository:
+//   gcc -std=gnu99 -DHOST_SIM -O1 -Wno-pointer-to-int-cast -o timeout_race_test
+//       RTOS_Labs_common/host/tests/TimeoutRaceTest.c RTOS_Labs_common/OS.c RTOS_Labs_common/Trace.c
+//       RTOS_Labs_common/heap.c RTOS_Labs_common/host/HostPort.c RTOS_Labs_common/host/HostDevices.c
+//   ./timeout_race_test
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include "../../../RTOS_Labs_common/host/HostPort.h"
+#include "../../../RTOS_Labs_common/OS.h"
+#include "../../../RTOS_Labs_common/TCB.h"
+
+#define TIMEOUTMS		10
+#define FIRSTDELAY	((TIMEOUTMS - 2)*TIME_1MS)		// signal delays swept, from the wait starting
+#define LASTDELAY		((TIMEOUTMS + 2)*TIME_1MS)
+#define STEPCYCLES	(TIME_1MS/8)
+#define SPINCYCLES	(TIME_1MS/64)									// how finely the signaller aims
+#define NEIGHBOURMS	(TIMEOUTMS + 3)								// sleeps behind the waiter in the delta queue
+
+extern struct TCB* RunPt;
+extern struct TCB SleepingThreads;
+extern int32_t SleepingThreadCount;
+
+Sema4Type RaceSema4;
+bool RaceBinary;
+uint32_t WaitStart;
+bool WaitBlocked;
+int32_t WaitResult;
+bool WaiterClean;						// the waiter's TCB was off every list once its wait returned
+bool WaiterDone;
+uint32_t NeighbourSlept;		// ms the neighbour actually slept
+bool NeighbourDone;
+
+// the sleeping threads list is intact and holds SleepingThreadCount threads
+static bool sleepQueueConsistent(void){
+	int32_t count = 0;
+	struct TCB* tcb = &SleepingThreads;
+	do{
+		if(tcb->nextSleepTCB->previousSleepTCB != tcb){
+			return false;
+		}
+		tcb = tcb->nextSleepTCB;
+		if(tcb != &SleepingThreads){
+			if(!tcb->sleeping || ++count > SleepingThreadCount){
+				return false;
+			}
+		}
+	}while(tcb != &SleepingThreads);
+	return count == SleepingThreadCount;
+}
+
+static void waiterThread(void){
+	WaitStart = OS_Time();
+	WaitBlocked = true;
+	if(RaceBinary){
+		WaitResult = OS_bWait_Timeout(&RaceSema4, TIMEOUTMS);
+	}else{
+		WaitResult = OS_Wait_Timeout(&RaceSema4, TIMEOUTMS);
+	}
+	WaiterClean = !RunPt->sleeping && RunPt->waitQueue == NULL && RunPt->timedSema4 == NULL && !RunPt->timedOut;
+	WaiterDone = true;
+	OS_Kill();
+}
+
+static void neighbourThread(void){
+	uint32_t start = OS_MsTime();
+	OS_Sleep(NEIGHBOURMS);
+	NeighbourSlept = OS_MsTime() - start;
+	NeighbourDone = true;
+	OS_Kill();
+}
+
+// one race, the signal goes out delay cycles after the waiter blocked
+// returns the waiter's result
+static int32_t raceRound(uint32_t delay){
+	WaitBlocked = false;
+	WaiterDone = false;
+	NeighbourDone = false;
+	int32_t sleepers = SleepingThreadCount;
+	HOST_CHECK(OS_AddThread(&waiterThread, 128, 2));
+	HOST_CHECK(OS_AddThread(&neighbourThread, 128, 2));
+	// let both block, the controller comes back well before the timeout
+	OS_Sleep(1);
+	HOST_CHECK(WaitBlocked);
+
+	while(OS_TimeDifference(WaitStart, OS_Time()) < delay){
+		HostConsume(SPINCYCLES);
+	}
+	if(RaceBinary){
+		OS_bSignal(&RaceSema4);
+	}else{
+		OS_Signal(&RaceSema4);
+	}
+	HOST_CHECK(sleepQueueConsistent());
+	OS_Sleep(NEIGHBOURMS + 2);
+
+	HOST_CHECK(WaiterDone);
+	HOST_CHECK(WaiterClean);
+	HOST_CHECK(NeighbourDone);
+	// the first tick of a sleep is a partial ms, a woken thread can wait a time slice to run
+	HOST_CHECK(NeighbourSlept >= NEIGHBOURMS - 1 && NeighbourSlept <= NEIGHBOURMS + 3);
+	HOST_CHECK(SleepingThreadCount == sleepers);
+	HOST_CHECK(sleepQueueConsistent());
+	HOST_CHECK(RaceSema4.blockedThreads.waitingPriorities == 0);
+	// taken by the waiter, or left in the semaphore by a signal that came too late
+	HOST_CHECK(RaceSema4.Value == (WaitResult ? 0 : 1));
+	if(!WaitResult){
+		HOST_CHECK(OS_Wait_Timeout(&RaceSema4, 0));
+	}
+	return WaitResult;
+}
+
+static void sweep(bool binary){
+	RaceBinary = binary;
+	OS_InitSemaphore(&RaceSema4, 0);
+	int32_t woken = 0;
+	int32_t timedOut = 0;
+	for(uint32_t delay = FIRSTDELAY; delay <= LASTDELAY; delay += STEPCYCLES){
+		if(raceRound(delay)){
+			woken++;
+		}else{
+			timedOut++;
+		}
+	}
+	printf("%s: %d signalled in time, %d timed out\n", binary ? "binary" : "counting", woken, timedOut);
+	// the sweep has to cross the timeout
+	HOST_CHECK(woken > 0);
+	HOST_CHECK(timedOut > 0);
+}
+
+static void controllerThread(void){
+	sweep(false);
+	sweep(true);
+	HostTestEnd();
+}
+
+// frees the stacks of the threads that are done
+static void idleThread(void){
+	while(1){
+		OS_Idle();
+	}
+}
+
+int main(void){
+	OS_Init();
+	OS_ClearMsTime();
+	HostTestBegin("timeout and signal race");
+	OS_AddThread(&controllerThread, 256, 1);
+	OS_AddThread(&idleThread, 128, PRIORITY_NUM-1);
+	OS_Launch(TIME_2MS);
+	return 0;
+}
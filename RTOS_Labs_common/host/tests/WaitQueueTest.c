@@ -0,0 +1,93 @@
+// *************WaitQueueTest.c**************
+// Host test of the order threads blocked on a semaphore wake in
+// Waiters of mixed priorities block one after the other, then each signal has to wake
+// the highest priority waiter, and the one that blocked first among equal priorities,
+// for a counting semaphore with OS_Signal and a binary semaphore with OS_bSignal
+//
+// build and run from the top of the repository:
+//   gcc -std=gnu99 -DHOST_SIM -O1 -Wno-pointer-to-int-cast -o wait_queue_test
+//       RTOS_Labs_common/host/tests/WaitQueueTest.c RTOS_Labs_common/OS.c RTOS_Labs_common/Trace.c
+//       RTOS_Labs_common/heap.c RTOS_Labs_common/host/HostPort.c RTOS_Labs_common/host/HostDevices.c
+//   ./wait_queue_test
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "../../../RTOS_Labs_common/host/HostPort.h"
+#include "../../../RTOS_Labs_common/OS.h"
+
+#define WAITERS		6
+
+// priorities in the order the waiters block, below the controller at 1
+static const uint32_t WaiterPriority[WAITERS] = {3, 2, 3, 4, 2, 3};
+// the order they have to wake in, as indices into WaiterPriority
+static const int32_t ExpectedOrder[WAITERS] = {1, 4, 0, 2, 5, 3};
+
+Sema4Type WaitSema4;
+bool WaitBinary;
+int32_t Arrived;									// waiters that have run up to their wait
+int32_t Woken;
+int32_t WakeOrder[WAITERS];
+
+// takes the next arrival index, blocks, and records that index once woken
+static void waiterThread(void){
+	int32_t arrival = Arrived++;
+	if(WaitBinary){
+		OS_bWait(&WaitSema4);
+	}else{
+		OS_Wait(&WaitSema4);
+	}
+	WakeOrder[Woken++] = arrival;
+	OS_Kill();
+}
+
+// block every waiter on WaitSema4, then wake them one signal at a time
+// the controller sleeps after each step, so the waiter it concerns runs before the next step
+static void wakeOrderRound(bool binary){
+	WaitBinary = binary;
+	Arrived = 0;
+	Woken = 0;
+	OS_InitSemaphore(&WaitSema4, 0);
+
+	for(int i = 0; i < WAITERS; i++){
+		HOST_CHECK(OS_AddThread(&waiterThread, 128, WaiterPriority[i]));
+		OS_Sleep(1);
+		HOST_CHECK(Arrived == i + 1);
+	}
+	HOST_CHECK(Woken == 0);
+
+	for(int i = 0; i < WAITERS; i++){
+		if(binary){
+			OS_bSignal(&WaitSema4);
+		}else{
+			OS_Signal(&WaitSema4);
+		}
+		OS_Sleep(1);
+		HOST_CHECK(Woken == i + 1);
+		HOST_CHECK(WakeOrder[i] == ExpectedOrder[i]);
+	}
+	HOST_CHECK(WaitSema4.Value == 0);
+	HOST_CHECK(WaitSema4.blockedThreads.waitingPriorities == 0);
+}
+
+static void controllerThread(void){
+	wakeOrderRound(false);
+	wakeOrderRound(true);
+	HostTestEnd();
+}
+
+// frees the stacks of the waiters that are done
+static void idleThread(void){
+	while(1){
+		OS_Idle();
+	}
+}
+
+int main(void){
+	OS_Init();
+	OS_ClearMsTime();
+	HostTestBegin("wait queue order");
+	OS_AddThread(&controllerThread, 256, 1);
+	OS_AddThread(&idleThread, 128, PRIORITY_NUM-1);
+	OS_Launch(TIME_2MS);
+	return 0;
+}
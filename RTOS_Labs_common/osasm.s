@@ -12,11 +12,18 @@
 
         EXTERN  RunPt            ; next to run thread
 		EXTERN	StackPt			 ; stack of currently running thread
+		IMPORT	OS_ThreadSwitched	 ; CPU accounting for each switch
+		IMPORT	OS_ThreadFaulted	 ; ends a thread that faulted
+		IMPORT	OS_FaultCapture		 ; records a fault
 
         EXPORT  StartOS
         EXPORT  ContextSwitch
         EXPORT  PendSV_Handler
         EXPORT  SVC_Handler
+        EXPORT  HardFault_Handler
+        EXPORT  MemManage_Handler
+        EXPORT  BusFault_Handler
+        EXPORT  UsageFault_Handler
 
 
 NVIC_INT_CTRL   EQU     0xE000ED04                              ; Interrupt control state register.
@@ -25,20 +32,30 @@ NVIC_SYSPRI15   EQU     0xE000ED23                              ; Systick priori
 NVIC_LEVEL14    EQU           0xEF                              ; Systick priority value (second lowest).
 NVIC_LEVEL15    EQU           0xFF                              ; PendSV priority value (lowest).
 NVIC_PENDSVSET  EQU     0x10000000                              ; Value to trigger PendSV exception.
+TCB_EXCRETURN   EQU     4                                       ; offset of excReturn in struct TCB, after stackPt.
+TCB_SVCRETURN   EQU     8                                       ; offset of svcReturn in struct TCB.
+TCB_CONTROL     EQU     12                                      ; offset of control in struct TCB.
+TCB_SVCCONTROL  EQU     16                                      ; offset of svcControl in struct TCB.
 
 
 StartOS
 ; put your code here
 	CPSID	I
+	MOV		R0, #0
+	MSR		CONTROL, R0					;clear FPCA, the first thread starts without a floating point context
+	ISB
     LDR 	R0, =StackPt				;R0 has the address of the address of StackPt
 	LDR		R0, [R0]
+	LDR		R12, [R0, #TCB_CONTROL]		;privilege of the first thread, R12 isn't restored from its stack
 	LDR 	SP, [R0]					;SP has TCB stackPtr
 	POP		{R4-R11}
 	POP		{R0-R3}
 	ADD		SP, SP, #4					;manually move SP to LR
 	POP		{LR}
 	ADD		SP, SP, #4					;skip over PC and PSR
-	CPSIE	I
+	CPSIE	I							;while still privileged, an unprivileged CPSIE is ignored
+	MSR		CONTROL, R12
+	ISB
     BX      LR                  		; start first thread
 
 OSStartHang
@@ -89,7 +106,16 @@ ContextSwitch
 ;              d) OSTCBCur      points to the OS_TCB of the task to suspend
 ;                 OSTCBHighRdy  points to the OS_TCB of the task to resume
 ;
-;           4) Since PendSV is set to lowest priority in the system (by OSStartHighRdy() above), we
+;           4) EXC_RETURN bit 4 is clear when the thread switched out has a floating point context.
+;              Its hardware frame then has room for S0-S15 and FPSCR, which lazy stacking only fills
+;              in once an FP instruction runs in the handler, and S16-S31 are saved here as well.
+;              Each thread's EXC_RETURN is kept in its TCB, so integer only threads never pay
+;              for the FP registers.
+;
+;           5) CONTROL nPRIV is kept in each TCB as well, threads of a process run unprivileged.
+;              OS_ThreadSwitched loads the MPU regions of an incoming process thread.
+;
+;           6) Since PendSV is set to lowest priority in the system (by OSStartHighRdy() above), we
 ;              know that it will only be run when no other exception or interrupt is active, and
 ;              therefore safe to assume that context being switched out was using the process stack (PSP).
 ;********************************************************************************************************
@@ -97,17 +123,34 @@ ContextSwitch
 PendSV_Handler
 ; put your code here
 	CPSID	I
+	TST		LR, #0x10			; bit 4 clear, the outgoing thread has used the FPU
+	IT		EQ
+	VPUSHEQ	{S16-S31}			; also makes the lazy stacking save S0-S15 and FPSCR into the frame
 	PUSH	{R4-R11}
 	LDR		R0, =StackPt		; R0 has address of StackPt
 	LDR		R0, [R0]
 	STR 	SP, [R0]			; save stack pointer into current TCB's stack pointer
+	STR		LR, [R0, #TCB_EXCRETURN]	; and the EXC_RETURN that resumes it
+	MRS		R1, CONTROL
+	AND		R1, R1, #1			; and the privilege it runs at
+	STR		R1, [R0, #TCB_CONTROL]
+	BL		OS_ThreadSwitched	; charge the outgoing thread, StackPt is still the outgoing one
 	LDR 	R0, =RunPt			; R1 has address of RunPt
 	LDR		R1, [R0]
 	LDR 	SP, [R1]			; SP has RunPt's stack pointer
+	LDR		LR, [R1, #TCB_EXCRETURN]	; LR has RunPt's EXC_RETURN
+	LDR		R2, [R1, #TCB_CONTROL]	; thread mode runs at RunPt's privilege after the return
+	MRS		R3, CONTROL
+	BIC		R3, R3, #1
+	ORR		R3, R3, R2
+	MSR		CONTROL, R3
 	LDR		R1, =StackPt		; R0 has the address of StackPt
 	LDR		R0, [R0]
 	STR		R0,	[R1]			; save RunPt's stack pointer address into StackPt var for next context switch
 	POP		{R4-R11}			 
+	TST		LR, #0x10			; bit 4 clear, the incoming thread has a floating point context
+	IT		EQ
+	VPOPEQ	{S16-S31}
 	CPSIE	I
     BX  	LR              	; Exception return will restore remaining context   
     
@@ -120,53 +163,124 @@ PendSV_Handler
 ;           The function ID to call is encoded in the instruction itself, the location of which can be
 ;           found relative to the return address saved on the stack on exception entry.
 ;           Function-call paramters in R0..R3 are also auto-saved on stack on exception entry.
+;
+;           The ID indexes SyscallTable (Syscall.c), so every call costs the same. Rather than calling
+;           the kernel function from handler mode, where a blocking call could not block, the handler
+;           returns into SVC_Trampoline with the function in R12 and the caller's R0-R3 untouched.
+;           The trampoline runs in thread mode on the caller's stack and goes back to the instruction
+;           after the SVC, which the handler keeps in the svcReturn of the calling TCB. StackPt is
+;           used rather than RunPt, which already points at the next thread while a switch is pending.
+;           The kernel function runs privileged, the caller's nPRIV waits in svcControl until the
+;           trampoline drops back to it. So for an unprivileged caller SyscallArgsValid (Syscall.c) first
+;           checks that the pointer arguments stay inside the caller's own memory, a call that fails
+;           the check returns -1 without running.
 ;********************************************************************************************************
 
-        IMPORT    OS_Id
-        IMPORT    OS_Kill
-        IMPORT    OS_Sleep
-        IMPORT    OS_Time
-        IMPORT    OS_AddThread
+        IMPORT    SyscallTable
+        IMPORT    SyscallTableSize
+        IMPORT    SyscallArgsValid
 
 SVC_Handler
-; put your Lab 5 code here
-	LDR  R12,[SP,#24]			
-	LDRH R12,[R12,#-2]			 
-	BIC  R12,#0xFF00		
-	LDM  SP,{R0-R3}				 
-	
-	PUSH {LR}
-	CMP  R12, #0
-	BEQ  SVC_Handler_OS_Id
-	CMP  R12, #1
-	BEQ  SVC_Handler_OS_Kill
-	CMP  R12, #2
-	BEQ  SVC_Handler_OS_Sleep
-	CMP  R12, #3
-	BEQ  SVC_Handler_OS_Time
-	CMP  R12, #4
-	BEQ  SVC_Handler_OS_AddThread
-
-SVC_Handler_OS_Id			
-	BL	OS_Id
-	B   fin
-SVC_Handler_OS_Kill		
-	BL  OS_Kill
-	B   fin
-SVC_Handler_OS_Sleep		
-	BL  OS_Sleep
-	B   fin
-SVC_Handler_OS_Time	
-	BL  OS_Time
-	B   fin
-SVC_Handler_OS_AddThread
-	BL  OS_AddThread
-	B   fin
-	
-fin
-	POP	{LR}
-	STR R0,[SP]
-    BX	LR                   ; Return from exception
+	LDR		R0, [SP,#24]		; return address stacked on entry
+	LDRB	R1, [R0,#-2]		; ID, the low byte of the SVC instruction
+	LDR		R2, =SyscallTableSize
+	LDR		R2, [R2]
+	CMP		R1, R2
+	BHS		SVC_Unknown
+	LDR		R2, =SyscallTable
+	LDR		R2, [R2, R1, LSL #2]	; kernel function for this ID
+	CBZ		R2, SVC_Unknown		; not linked into this kernel
+	MRS		R3, CONTROL
+	TST		R3, #1				; a privileged caller is trusted with its pointers
+	BEQ		SVC_Dispatch
+	PUSH	{R2, LR}
+	MOV		R0, R1				; ID
+	ADD		R1, SP, #8			; stacked R0-R3, the arguments
+	BL		SyscallArgsValid
+	POP		{R2, LR}
+	CMP		R0, #0
+	BEQ		SVC_Unknown
+	LDR		R0, [SP,#24]
+SVC_Dispatch
+	ORR		R0, R0, #1			; return with BX, in Thumb state
+	LDR		R1, =StackPt
+	LDR		R1, [R1]
+	STR		R0, [R1, #TCB_SVCRETURN]
+	MRS		R0, CONTROL
+	AND		R3, R0, #1			; caller's privilege
+	STR		R3, [R1, #TCB_SVCCONTROL]
+	BIC		R0, R0, #1			; the trampoline and the kernel function run privileged
+	MSR		CONTROL, R0
+	STR		R2, [SP,#16]		; stacked R12, the function the trampoline calls
+	LDR		R0, =SVC_Trampoline
+	BIC		R0, R0, #1
+	STR		R0, [SP,#24]		; return into the trampoline
+	BX		LR
+
+SVC_Unknown
+	MVN		R0, #0				; -1
+	STR		R0, [SP]			; stacked R0, the result
+	BX		LR
+
+; thread mode, R0-R3 hold the arguments, R12 the kernel function, LR is still the caller's
+SVC_Trampoline
+	PUSH	{R4, LR}			; R4 keeps the stack 8 byte aligned
+	BLX		R12
+	LDR		R12, =StackPt		; R0-R1 hold the result, leave them alone
+	LDR		R12, [R12]
+	LDR		R2, [R12, #TCB_SVCCONTROL]
+	LDR		R12, [R12, #TCB_SVCRETURN]
+	MRS		R3, CONTROL			; back to the caller's privilege
+	ORR		R3, R3, R2
+	MSR		CONTROL, R3
+	ISB
+	POP		{R4, LR}
+	BX		R12
+
+
+;********************************************************************************************************
+;                                       FAULT IN A THREAD
+;
+; Note(s) : The hard, memory management, bus and usage faults share this handler. OS_FaultCapture records
+;           the fault with the registers stacked on exception entry. A fault taken in thread mode then ends
+;           the faulting thread instead of the whole system: the handler returns into OS_ThreadFaulted in
+;           place of the faulting instruction, privileged even if the thread belonged to a process, which
+;           exits the thread with FAULT_EXITCODE and lets its restart policy start it over. A fault in an
+;           ISR, or before OS_Launch, still stops at FaultHang for the debugger.
+;********************************************************************************************************
+
+HardFault_Handler
+MemManage_Handler
+BusFault_Handler
+UsageFault_Handler
+	TST		LR, #0x04			; the frame is on the stack the faulting code was using
+	ITE		EQ
+	MRSEQ	R0, MSP
+	MRSNE	R0, PSP
+	MRS		R1, IPSR			; exception number
+	MOV		R2, LR				; EXC_RETURN
+	PUSH	{R0, LR}
+	BL		OS_FaultCapture
+	POP		{R0, LR}
+	TST		LR, #0x08			; EXC_RETURN bit 3 is set for a return to thread mode
+	BEQ		FaultHang
+	LDR		R1, =RunPt
+	LDR		R1, [R1]
+	CBZ		R1, FaultHang		; no threads yet
+	LDR		R1, =OS_ThreadFaulted
+	BIC		R1, R1, #1
+	STR		R1, [R0,#24]		; stacked PC
+	LDR		R1, [R0,#28]
+	AND		R1, R1, #0x200		; keep the stack alignment bit of the stacked xPSR
+	ORR		R1, R1, #0x01000000	; Thumb state, no IT block
+	STR		R1, [R0,#28]
+	MRS		R1, CONTROL
+	BIC		R1, R1, #1			; privileged
+	MSR		CONTROL, R1
+	BX		LR
+
+FaultHang
+	B		FaultHang
 
 
 
@@ -11,7 +11,7 @@
 
 
 // Display semaphore
-extern Sema4Type LCDFree;  // this should really be handled in eDisk.c, not eFile.c
+extern MutexType LCDFree;  // this should really be handled in eDisk.c, not eFile.c
 
 // Static file system objects
 static FATFS g_sFatFs;
@@ -34,12 +34,12 @@ int eFile_Init(void){ // initialize file system
 // Input: none
 // Output: 0 if successful and 1 on failure (e.g., trouble writing to flash)
 int eFile_Format(void){ // erase disk, add format
-	OS_bWait(&LCDFree);
+	OS_MutexLock(&LCDFree);
   if(f_mkfs("", 0, 0)){
-		OS_bSignal(&LCDFree);
+		OS_MutexUnlock(&LCDFree);
     return 1;
   }
-	OS_bSignal(&LCDFree);  
+	OS_MutexUnlock(&LCDFree);  
   return 0;
 }
 
@@ -48,12 +48,12 @@ int eFile_Format(void){ // erase disk, add format
 // Input: none
 // Output: 0 if successful and 1 on failure (already initialized)
 int eFile_Mount(void){ // mount disk
-	OS_bWait(&LCDFree);
+	OS_MutexLock(&LCDFree);
   if(f_mount(&g_sFatFs, "", 0)){
-		OS_bSignal(&LCDFree);
+		OS_MutexUnlock(&LCDFree);
     return 1;
   }
-	OS_bSignal(&LCDFree);  
+	OS_MutexUnlock(&LCDFree);  
   return 0;
 }
 
@@ -62,12 +62,12 @@ int eFile_Mount(void){ // mount disk
 // Input: file name is an ASCII string up to seven characters 
 // Output: 0 if successful and 1 on failure (e.g., trouble writing to flash)
 int eFile_Create( const char name[]){  // create new file, make it empty 
-	OS_bWait(&LCDFree);
+	OS_MutexLock(&LCDFree);
   if(f_open(&f, name, FA_CREATE_NEW)){
-		OS_bSignal(&LCDFree);
+		OS_MutexUnlock(&LCDFree);
     return 1;
   }
-  OS_bSignal(&LCDFree);
+  OS_MutexUnlock(&LCDFree);
   return 0;   
 }
 
@@ -76,12 +76,12 @@ int eFile_Create( const char name[]){  // create new file, make it empty
 // Input: file name is an ASCII string up to seven characters
 // Output: 0 if successful and 1 on failure (e.g., trouble reading from flash)
 int eFile_WOpen( const char name[]){      // open a file for writing 
-	OS_bWait(&LCDFree);
+	OS_MutexLock(&LCDFree);
   if(f_open(&f, name, FA_WRITE)){
-		OS_bSignal(&LCDFree);
+		OS_MutexUnlock(&LCDFree);
     return 1;
   }
-  OS_bSignal(&LCDFree);
+  OS_MutexUnlock(&LCDFree);
   return 0;   
 }
 
@@ -91,12 +91,12 @@ int eFile_WOpen( const char name[]){      // open a file for writing
 // Output: 0 if successful and 1 on failure (e.g., trouble writing to flash)
 int eFile_Write( char data){
   unsigned written;
-  OS_bWait(&LCDFree);
+  OS_MutexLock(&LCDFree);
   if(f_write(&f, &data, 1, &written) || (written != 1)){
-    OS_bSignal(&LCDFree);
+    OS_MutexUnlock(&LCDFree);
     return 1;
   }
-  OS_bSignal(&LCDFree);
+  OS_MutexUnlock(&LCDFree);
   return 0;  
 }
 
@@ -105,12 +105,12 @@ int eFile_Write( char data){
 // Input: none
 // Output: 0 if successful and 1 on failure (e.g., trouble writing to flash)
 int eFile_WClose(void){ // close the file for writing
-	OS_bWait(&LCDFree);
+	OS_MutexLock(&LCDFree);
   if(f_close(&f)){
-		OS_bSignal(&LCDFree);
+		OS_MutexUnlock(&LCDFree);
     return 1;
   }
-  OS_bSignal(&LCDFree);
+  OS_MutexUnlock(&LCDFree);
   return 0;  
 }
 
@@ -119,12 +119,12 @@ int eFile_WClose(void){ // close the file for writing
 // Input: file name is an ASCII string up to seven characters
 // Output: 0 if successful and 1 on failure (e.g., trouble reading from flash)
 int eFile_ROpen( const char name[]){      // open a file for reading 
-	OS_bWait(&LCDFree);
+	OS_MutexLock(&LCDFree);
   if(f_open(&f, name, FA_READ)){
-		OS_bSignal(&LCDFree);
+		OS_MutexUnlock(&LCDFree);
     return 1;
   }
-  OS_bSignal(&LCDFree);
+  OS_MutexUnlock(&LCDFree);
   return 0;   
 }
  
@@ -135,12 +135,12 @@ int eFile_ROpen( const char name[]){      // open a file for reading
 //         0 if successful and 1 on failure (e.g., end of file)
 int eFile_ReadNext( char *pt){       // get next byte 
   unsigned read;
-  OS_bWait(&LCDFree);
+  OS_MutexLock(&LCDFree);
   if(f_read(&f, pt, 1, &read) || (read != 1)){
-    OS_bSignal(&LCDFree);
+    OS_MutexUnlock(&LCDFree);
     return 1;
   }
-  OS_bSignal(&LCDFree);
+  OS_MutexUnlock(&LCDFree);
   return 0; 
 }
 
@@ -149,12 +149,12 @@ int eFile_ReadNext( char *pt){       // get next byte
 // Input: none
 // Output: 0 if successful and 1 on failure (e.g., wasn't open)
 int eFile_RClose(void){ // close the file for writing
-	OS_bWait(&LCDFree);
+	OS_MutexLock(&LCDFree);
   if(f_close(&f)){
-		OS_bSignal(&LCDFree);
+		OS_MutexUnlock(&LCDFree);
     return 1;
   }
-  OS_bSignal(&LCDFree);
+  OS_MutexUnlock(&LCDFree);
   return 0;
 }
 
@@ -163,12 +163,12 @@ int eFile_RClose(void){ // close the file for writing
 // Input: file name is a single ASCII letter
 // Output: 0 if successful and 1 on failure (e.g., trouble writing to flash)
 int eFile_Delete( const char name[]){  // remove this file 
-	OS_bWait(&LCDFree);
+	OS_MutexLock(&LCDFree);
   if(f_unlink(name)){
-    OS_bSignal(&LCDFree);
+    OS_MutexUnlock(&LCDFree);
     return 1;
   }
-  OS_bSignal(&LCDFree);
+  OS_MutexUnlock(&LCDFree);
   return 0;
 }                             
 
@@ -178,12 +178,12 @@ int eFile_Delete( const char name[]){  // remove this file
 //        (empty/NULL for root directory)
 // Output: 0 if successful and 1 on failure (e.g., trouble reading from flash)
 int eFile_DOpen( const char name[]){ // open directory
-	OS_bWait(&LCDFree);
+	OS_MutexLock(&LCDFree);
   if(f_opendir(&d, name)) {
-		OS_bSignal(&LCDFree);
+		OS_MutexUnlock(&LCDFree);
 		return 1;
   }
-	OS_bSignal(&LCDFree);
+	OS_MutexUnlock(&LCDFree);
   return 0;
 }
   
@@ -193,14 +193,14 @@ int eFile_DOpen( const char name[]){ // open directory
 // Output: return file name and size by reference
 //         0 if successful and 1 on failure (e.g., end of file)
 int eFile_DirNext( char *name[], unsigned long *size){  // get next entry 
-	OS_bWait(&LCDFree);
+	OS_MutexLock(&LCDFree);
 	if(f_readdir(&d, &fi) || !fi.fname[0]) {
-		OS_bSignal(&LCDFree);
+		OS_MutexUnlock(&LCDFree);
 		return 1;
   }
   *name = fi.fname;
   *size = fi.fsize;
-	OS_bSignal(&LCDFree);
+	OS_MutexUnlock(&LCDFree);
   return 0;
 }
 
@@ -209,12 +209,12 @@ int eFile_DirNext( char *name[], unsigned long *size){  // get next entry
 // Input: none
 // Output: 0 if successful and 1 on failure (e.g., wasn't open)
 int eFile_DClose(void){ // close the directory
-	OS_bWait(&LCDFree);
+	OS_MutexLock(&LCDFree);
   if(f_closedir(&d)){
-		OS_bSignal(&LCDFree);
+		OS_MutexUnlock(&LCDFree);
     return 1;
   }
-  OS_bSignal(&LCDFree);
+  OS_MutexUnlock(&LCDFree);
   return 0;
 }
 
@@ -223,11 +223,11 @@ int eFile_DClose(void){ // close the directory
 // Input: none
 // Output: 0 if successful and 1 on failure (not currently mounted)
 int eFile_Unmount(void){ 
-	OS_bWait(&LCDFree);
+	OS_MutexLock(&LCDFree);
   if(f_mount(NULL, "", 0)){
-		OS_bSignal(&LCDFree);
+		OS_MutexUnlock(&LCDFree);
     return 1;
   }
-	OS_bSignal(&LCDFree);  
+	OS_MutexUnlock(&LCDFree);  
   return 0;   
 }
@@ -73,14 +73,23 @@ UINT LOADER_WRITE(FIL* fd, void* buffer, size_t size) { UINT w;
 #define LOADER_SEEK_FROM_START(fd, off) f_lseek(fd, off)
 #define LOADER_TELL(fd) (fd->fptr)
 
-#define LOADER_ALIGN_ALLOC(size, align, perm) Heap_Malloc(size)
-#define LOADER_FREE(ptr) Heap_Free(ptr)
+void* LOADER_ALIGN_ALLOC(size_t size, size_t align, int perm) { void* p;
+  OS_MutexLock(&HeapMutex);		// OS_Idle frees the segments of finished processes meanwhile
+  p = Heap_MallocAligned(size);
+  OS_MutexUnlock(&HeapMutex);
+  return p;
+}
+void LOADER_FREE(void* ptr) {
+  OS_MutexLock(&HeapMutex);
+  Heap_Free(ptr);
+  OS_MutexUnlock(&HeapMutex);
+}
 void LOADER_CLEAR(void* ptr, size_t size) { int i; int32_t *p;
   for(p = ptr, i = 0; i < size/sizeof(int32_t); i++, p++) *p = 0;
 }
 #define LOADER_STREQ(s1, s2) (strcmp(s1, s2) == 0)
 
-#define LOADER_JUMP_TO(entry, text, data) OS_AddProcess(entry, text, data, 128, 1)
+#define LOADER_JUMP_TO(entry, text, data) OS_AddProcess(entry, text, data, 512, 1)
 
 #define DBG(msg, par)
 #define ERR(msg) UART_OutString("ELF: " msg "\n\r")
@@ -30,8 +30,12 @@
 #include <stdio.h> 
 #include <string.h>
 #include <stdlib.h>
+#ifdef HOST_SIM
+#include "../RTOS_Labs_common/host/HostPort.h"
+#else
 #include "../inc/tm4c123gh6pm.h"
 #include "../inc/CortexM.h"
+#endif
 #include "../inc/LaunchPad.h"
 #include "../inc/PLL.h"
 #include "../inc/LPF.h"
@@ -89,7 +93,7 @@ void PortF_Init(void){
 
 void Idle(void){     
   while(1) {
-    WaitForInterrupt();
+    OS_Idle();
   }
 }
 
@@ -126,84 +130,101 @@ void digitalServo_test(void){
 	}
 }
 
-Sema4Type commandSync;
+// one accelerometer reading worth acting on, stamped with the OS_TimeUs it was read at
+struct AccelSample{
+	int16_t x;
+	int16_t y;
+	int16_t z;
+	uint64_t time;
+};
+
+#define ACCELSAMPLEQUEUESIZE	4
+// the filter sends every reading, so a quiet queue means the MPU6050 stopped responding
+#define ACCELSAMPLETIMEOUT		100		// ms
+
+// the control loop runs as two EDF real-time threads released together every period,
+// a sample is read by the filter deadline and acted on by the servo deadline,
+// however busy the LCD and the lower priority threads are
+#define CONTROLPERIOD					5									// ms
+#define FILTERWCET						(2*TIME_1MS)			// three accelerometer reads over 100 kbps I2C
+#define FILTERDEADLINE				3									// ms
+#define SERVOWCET							(TIME_1MS/4)
+#define SERVODEADLINE					CONTROLPERIOD			// ms, the bound on sample to actuation latency
+// a control thread that faults is started over right away, up to CONTROLRESTARTS times
+// in CONTROLRESTARTWINDOW, more often than that the fault is not going away
+#define CONTROLRESTARTS				3
+#define CONTROLRESTARTWINDOW	1000							// ms
+struct AccelSample accelSampleBuffer[ACCELSAMPLEQUEUESIZE];
+MsgQueueType accelSampleQueue;
 
 void servoMovementTask(void){
 	
+	struct AccelSample sample;
+	int32_t movementDecision = 0;
+	uint16_t mpu6050Scale = mpu6050GetAFS_SELScaleValue();
+	
+	// 16384 is max G value
+	// 16384 corresponds to 3000
+	// -16384 corresponds to 1000
+	// 0 -> 16384 corresponds to 2000 -> 3000
+	// divisor of 16, but realistically, it's closer to 4
+	
+	uint16_t digitalServoPulseLengthRange = digitalServogGetPWM_PULSE_UPPER_BOUND() - digitalServogGetPWM_PULSE_LOWER_BOUND();
+	uint16_t movementScale = mpu6050Scale/digitalServoPulseLengthRange;
+	
+	OS_SetRestartPolicy(OS_Id(), CONTROLRESTARTS, CONTROLRESTARTWINDOW);
+	
 	while(1){	
 		
-		// send servo position to user
-		OS_MailBox_Send(digitalServogGetCurrentPulseLength());
-		
-		OS_bWait(&commandSync);
-		
-		// wait for new servo command value
-		uint32_t servoCommandPulse = OS_MailBox_Recv();
-		
-		digitalServoMove(servoCommandPulse);
+		// wait for the next acceleration, park the servo if the sensor went quiet
+		if(!OS_MsgQueueRecvTimeout(&accelSampleQueue, &sample, ACCELSAMPLETIMEOUT)){
+			digitalServoMove(digitalServogGetPWM_PULSE_MIDDLE());
+		}else if(sample.x > 400 || sample.x < -400){
+			// ignore white noise instances
+			
+			//movementDecision = digitalServogGetCurrentPulseLength() + (sample.x/movementScale);
+			movementDecision = digitalServogGetCurrentPulseLength() + (sample.x/8);
+			
+			if(movementDecision > 3000){
+				movementDecision = 3000;
+			}
+			
+			if(movementDecision < 1000){
+				movementDecision = 1000;
+			}
+			
+			digitalServoMove(movementDecision);
+		}
 		
 		// wait for the servo to move to desired spot
 		// seems like this isn't needed
 		//OS_Sleep(1);
+		
+		OS_NextPeriod();
 	}
 }
 
 void accelerationFilterTask(void){
 	
-	int16_t currentXAccelValue = 0;
-	int16_t currentYAccelValue = 0;
-	int16_t currentZAccelValue = 0;
-	
-	int16_t XAccelDifference = 0;
-	int16_t YAccelDifference = 0;
-	int16_t ZAccelDifference = 0;
-	
-	uint16_t movementDecision = 0;
-	uint16_t mpu6050Scale = mpu6050GetAFS_SELScaleValue();
-	
-	// 16384 is max G value
-	// 16384 corresponds to 3000
-	// -16384 corresponds to 1000
-	// 0 -> 16384 corresponds to 2000 -> 3000
-	// divisor of 16, but realistically, it's closer to 4
+	struct AccelSample sample;
 	
-	uint16_t digitalServoPulseLengthRange = digitalServogGetPWM_PULSE_UPPER_BOUND() - digitalServogGetPWM_PULSE_LOWER_BOUND();
-	uint16_t movementScale = mpu6050Scale/digitalServoPulseLengthRange;
-	//uint16_t digitalServoBasePulseLength = digitalServogGetPWM_PULSE_MIDDLE();
-	uint16_t digitalServoBasePulseLength = 0;
+	OS_SetRestartPolicy(OS_Id(), CONTROLRESTARTS, CONTROLRESTARTWINDOW);
 	
 	while(1){
 		
-		mpu6050ReadAccel(&currentXAccelValue,
-										 &currentYAccelValue,
-										 &currentZAccelValue);
+		mpu6050ReadAccel(&sample.x,
+										 &sample.y,
+										 &sample.z);
+		sample.time = OS_TimeUs();
 		
 		/*
 		UART_OutString("currentXAccelValue: ");
-		UART_OutSDec(currentXAccelValue);
+		UART_OutSDec(sample.x);
 		UART_OutChar('\n');
 		*/
 		
-		// ignore white noise instances
-		if(currentXAccelValue <= 400 && currentXAccelValue >= -400){
-			continue;
-		}
-		
-		digitalServoBasePulseLength = OS_MailBox_Recv();
-		
-		//movementDecision = digitalServoBasePulseLength + (currentXAccelValue/movementScale);
-		movementDecision = digitalServoBasePulseLength + (currentXAccelValue/8);
-		
-		if(movementDecision > 3000){
-			movementDecision = 3000;
-		}
-		
-		if(movementDecision < 1000){
-			movementDecision = 1000;
-		}
-		
-		OS_MailBox_Send(movementDecision);
-		OS_bSignal(&commandSync);
+		OS_MsgQueueSend(&accelSampleQueue, &sample);
+		OS_NextPeriod();
 	}
 }
 
@@ -218,8 +239,8 @@ void mpu6050CalibrationTask(void){
 	ST7735_Message(1, 1, "y_accel_offset:", mpu6050GetYAccelOffset());
 	ST7735_Message(1, 2, "z_accel_offset:", mpu6050GetZAccelOffset());
 	
-	NumCreated += OS_AddThread(&servoMovementTask, 128, 1);
-	NumCreated += OS_AddThread(&accelerationFilterTask, 128, 2);
+	NumCreated += OS_AddRealTimeThread(&servoMovementTask, 256, CONTROLPERIOD, SERVOWCET, SERVODEADLINE);
+	NumCreated += OS_AddRealTimeThread(&accelerationFilterTask, 256, CONTROLPERIOD, FILTERWCET, FILTERDEADLINE);
 	
 	OS_Kill();
 }
@@ -235,18 +256,18 @@ int main(void){ // realmain
 	digitalServoInit();					// digitalServo initialization
 	ST7735_InitR(INITR_REDTAB); // LCD initialization
 	OS_ClearMsTime();						// for waking up sleeping threads	
+	OS_SchedulingMode(SCHED_EDF);	// control loop deadlines
 	
 	// software construct init
-	OS_MailBox_Init();
-	OS_InitSemaphore(&commandSync, 0);
+	OS_MsgQueueInit(&accelSampleQueue, accelSampleBuffer, ACCELSAMPLEQUEUESIZE, sizeof(struct AccelSample));
 
   // create initial foreground threads
   NumCreated = 0;
-  NumCreated += OS_AddThread(&mpu6050CalibrationTask, 128, 1);
-  NumCreated += OS_AddThread(&Idle,128,5);  // at lowest priority 
+  NumCreated += OS_AddThread(&mpu6050CalibrationTask, 512, 1);
+  NumCreated += OS_AddThread(&Idle,256,5);  // at lowest priority 
 
  
   OS_Launch(TIME_2MS); // doesn't return, interrupts enabled in here
-  return 0;            // this never executes
+  return 0;            // only if there was no room left for the timer daemon
 }
 
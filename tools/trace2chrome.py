@@ -0,0 +1,131 @@
+#!/usr/bin/env python3
+"""Convert an OS kernel trace dump to Chrome trace JSON.
+
+The dump comes from Trace_Dump (RTOS_Labs_common/Trace.h): the interpreter's
+trc_uar command, a file saved with trc_fil, or HOST_SIM_TRACE in the host port.
+A UART capture may hold terminal text around the dump, which is skipped.
+Open the JSON in chrome://tracing or https://ui.perfetto.dev.
+
+usage: trace2chrome.py trace.bin [-o trace.json]
+"""
+
+import argparse
+import json
+import struct
+import sys
+
+MAGIC = b"RTRC"
+HEADER = struct.Struct("<4sHHII")
+RECORD = struct.Struct("<IBBH")
+
+TRACE_SWITCH = 1
+TRACE_BLOCK = 2
+TRACE_WAKE = 3
+TRACE_TIMEOUT = 4
+TRACE_SLEEP = 5
+TRACE_KILL = 6
+TRACE_ISR_ENTER = 7
+TRACE_ISR_EXIT = 8
+
+INSTANT_NAMES = {
+    TRACE_BLOCK: "block",
+    TRACE_WAKE: "wake",
+    TRACE_TIMEOUT: "timeout",
+    TRACE_SLEEP: "sleep",
+    TRACE_KILL: "kill",
+}
+ISR_NAMES = {15: "SysTick", 46: "GPIOPortF", 108: "Timer5A", 110: "WideTimer0A"}
+ISR_TID_BASE = 1000     # ISRs get their own rows after the threads
+PID = 1
+
+
+def read_records(data):
+    start = data.find(MAGIC)
+    if start < 0:
+        sys.exit("no trace dump found")
+    magic, version, record_size, clock, count = HEADER.unpack_from(data, start)
+    if version != 1 or record_size != RECORD.size:
+        sys.exit("unsupported trace version %d, record size %d" % (version, record_size))
+    offset = start + HEADER.size
+    if len(data) < offset + count*RECORD.size:
+        sys.exit("trace dump is cut short")
+
+    # the timestamps are the low word of a cycle counter, unwrap them into one timeline
+    records = []
+    now = 0
+    previous = None
+    for i in range(count):
+        time, kind, thread, arg = RECORD.unpack_from(data, offset + i*RECORD.size)
+        if previous is not None:
+            now += (time - previous) & 0xFFFFFFFF
+        previous = time
+        records.append((now*1e6/clock, kind, thread, arg))
+    return records
+
+
+def convert(records):
+    events = []
+    threads = set()
+    running = None          # (thread, start) of the slice in progress
+    isr_start = {}
+
+    for ts, kind, thread, arg in records:
+        if kind == TRACE_SWITCH:
+            if running is None:
+                # the thread switched out has been running since before the trace starts
+                running = (arg, records[0][0])
+            events.append({"name": "thread %d" % running[0], "ph": "X", "pid": PID,
+                           "tid": running[0], "ts": running[1], "dur": ts - running[1]})
+            threads.add(running[0])
+            running = (thread, ts)
+        elif kind in INSTANT_NAMES:
+            event = {"name": INSTANT_NAMES[kind], "ph": "i", "s": "t", "pid": PID,
+                     "tid": thread, "ts": ts}
+            if kind == TRACE_SLEEP:
+                event["args"] = {"ms": arg}
+            elif kind != TRACE_KILL:
+                event["args"] = {"queue": "0x%04x" % arg}
+            events.append(event)
+            threads.add(thread)
+        elif kind == TRACE_ISR_ENTER:
+            isr_start[arg] = (ts, thread)
+        elif kind == TRACE_ISR_EXIT and arg in isr_start:
+            start, interrupted = isr_start.pop(arg)
+            events.append({"name": ISR_NAMES.get(arg, "exception %d" % arg), "ph": "X",
+                           "pid": PID, "tid": ISR_TID_BASE + arg, "ts": start,
+                           "dur": ts - start, "args": {"interrupted": interrupted}})
+
+    if running is not None:
+        events.append({"name": "thread %d" % running[0], "ph": "X", "pid": PID,
+                       "tid": running[0], "ts": running[1], "dur": records[-1][0] - running[1]})
+        threads.add(running[0])
+
+    for thread in sorted(threads):
+        events.append({"name": "thread_name", "ph": "M", "pid": PID, "tid": thread,
+                       "args": {"name": "thread %d" % thread}})
+    for exception in sorted({e["tid"] - ISR_TID_BASE for e in events if e["tid"] >= ISR_TID_BASE}):
+        events.append({"name": "thread_name", "ph": "M", "pid": PID, "tid": ISR_TID_BASE + exception,
+                       "args": {"name": ISR_NAMES.get(exception, "exception %d" % exception)}})
+    return events
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Convert an OS kernel trace dump to Chrome trace JSON")
+    parser.add_argument("dump", help="binary dump from Trace_Dump, or a UART capture holding one")
+    parser.add_argument("-o", "--output", help="JSON file to write, stdout if omitted")
+    args = parser.parse_args()
+
+    with open(args.dump, "rb") as dump:
+        records = read_records(dump.read())
+    trace = {"traceEvents": convert(records) if records else [], "displayTimeUnit": "ns"}
+
+    if args.output:
+        with open(args.output, "w") as output:
+            json.dump(trace, output)
+    else:
+        json.dump(trace, sys.stdout)
+        sys.stdout.write("\n")
+
+
+if __name__ == "__main__":
+    main()